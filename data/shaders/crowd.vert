@@ -0,0 +1,38 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in float aIndex;
+layout(location = 2) in float aNormal;
+layout(location = 3) in mat4 aInstance;
+
+out vec3 color;
+out vec3 Normal;
+out vec3 crntPos;
+
+uniform mat4 camMatrix;
+uniform mat4 model;
+// The entity's selected palette variant, one texel per palette index
+uniform sampler1D palette;
+
+void main() {
+    // Same normal encoding as entity.vert so a crowd member is lit like the single preview
+    vec3 normal = vec3(0.0, 0.0, 0.0);
+    if (aNormal == 1.0f) {
+        normal = vec3(0.0, 1.0, 0.0);
+    } else if (aNormal == 2.0) {
+        normal = vec3(0.0, -1.0, 0.0);
+    } else if (aNormal == 3.0) {
+        normal = vec3(1.0, 0.0, 1.0);
+    } else if (aNormal == 4.0) {
+        normal = vec3(-1.0, 0.0, 0.0);
+    } else if (aNormal == 5.0) {
+        normal = vec3(0.0, 0.0, 1.0);
+    } else if (aNormal == 6.0) {
+        normal = vec3(0.0, 0.0, -1.0);
+    }
+
+    mat4 instanceModel = aInstance * model;
+    color = texelFetch(palette, int(aIndex), 0).rgb;
+    crntPos = vec3(instanceModel * vec4(aPos, 1.0f));
+    gl_Position = camMatrix * vec4(crntPos, 1.0);
+    Normal = mat3(aInstance) * normal;
+}
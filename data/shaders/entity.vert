@@ -1,6 +1,6 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aColor;
+layout(location = 1) in float aIndex;
 layout(location = 2) in float aNormal;
 
 out vec3 color;
@@ -9,6 +9,8 @@ out vec3 crntPos;
 
 uniform mat4 camMatrix;
 uniform mat4 model;
+// The entity's selected palette variant, one texel per palette index
+uniform sampler1D palette;
 
 void main() {
     vec3 normal = vec3(0.0, 0.0, 0.0);
@@ -33,7 +35,7 @@ void main() {
         normalColor = vec3(0.0, 1.0, 1.0);
     }
 
-    color = aColor;
+    color = texelFetch(palette, int(aIndex), 0).rgb;
     crntPos = vec3(model * vec4(aPos, 1.0f));
     gl_Position = camMatrix * vec4(crntPos, 1.0);
     Normal = normal;
@@ -0,0 +1,98 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec3 localPos;
+
+uniform usampler3D volume;
+uniform usampler3D occupancy;
+uniform sampler1D palette;
+
+uniform mat4 camMatrix;
+uniform mat4 model;
+uniform mat4 invModel;
+uniform vec3 size;
+uniform int maxSteps;
+
+uniform vec4 lightColor;
+uniform vec3 lightPos;
+uniform vec3 camPos;
+
+const float BRICK_SIZE = 4.0;
+const float EPSILON = 1e-4;
+
+void main() {
+    // Only back faces march, so the box still works with the camera inside it
+    if (gl_FrontFacing) discard;
+
+    // Voxel space: voxel (x, y, z) spans [x, x + 1] x [y, y + 1] x [z, z + 1]
+    vec3 toVoxel = vec3(0.0, 0.0, 1.0);
+    vec3 origin = (invModel * vec4(camPos, 1.0)).xyz + toVoxel;
+    vec3 dir = normalize(localPos + toVoxel - origin);
+    dir = mix(dir, vec3(EPSILON), lessThan(abs(dir), vec3(EPSILON)));
+    vec3 invDir = 1.0 / dir;
+
+    // Entry into the box, the entry face is the normal of a voxel hit right away
+    vec3 t0 = -origin * invDir;
+    vec3 t1 = (size - origin) * invDir;
+    vec3 tMin = min(t0, t1);
+    vec3 tMax = max(t0, t1);
+    float tNear = max(max(tMin.x, tMin.y), max(tMin.z, 0.0));
+    float tFar = min(min(tMax.x, tMax.y), tMax.z);
+    if (tNear >= tFar) discard;
+    vec3 normal = -sign(dir) * vec3(equal(vec3(tNear), tMin));
+
+    // Two level DDA: walk bricks of the occupancy texture and descend into voxels only inside occupied ones
+    vec3 p = origin + dir * (tNear + EPSILON);
+    vec3 stepUp = step(0.0, dir);
+    bool fine = false;
+    ivec3 brick = ivec3(-1);
+    uint index = 0u;
+    for (int i = 0; i < maxSteps; i++) {
+        if (any(lessThan(p, vec3(0.0))) || any(greaterThanEqual(p, size))) break;
+
+        float cellSize = BRICK_SIZE;
+        ivec3 currentBrick = ivec3(floor(p / BRICK_SIZE));
+        if (fine && currentBrick != brick) fine = false;
+        if (!fine) {
+            if (texelFetch(occupancy, currentBrick, 0).r != 0u) {
+                fine = true;
+                brick = currentBrick;
+            }
+        }
+        if (fine) {
+            cellSize = 1.0;
+            index = texelFetch(volume, ivec3(floor(p)), 0).r;
+            if (index != 0u) break;
+        }
+
+        // Advance to the nearest cell boundary at the current level
+        vec3 next = (floor(p / cellSize) + stepUp) * cellSize;
+        vec3 tNext = (next - p) * invDir;
+        float dt = min(min(tNext.x, tNext.y), tNext.z);
+        normal = -sign(dir) * vec3(equal(vec3(dt), tNext));
+        p += dir * (dt + EPSILON);
+    }
+    if (index == 0u) discard;
+
+    vec3 color = texelFetch(palette, int(index), 0).rgb;
+    vec3 crntPos = vec3(model * vec4(p - toVoxel, 1.0));
+    vec4 clip = camMatrix * vec4(crntPos, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    // Same lighting as entity.frag
+    float ambient = 0.1f;
+
+    vec3 worldNormal = normalize(mat3(model) * normal);
+    vec3 lightDirection = normalize(lightPos - crntPos);
+
+    float diffuse = max(dot(worldNormal, lightDirection), 0.0);
+
+    float specularLight = 0.25f;
+    vec3 viewDirection = normalize(camPos - crntPos);
+    vec3 reflectionDirection = reflect(-lightDirection, worldNormal);
+    float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 8);
+    float specular = specAmount * specularLight;
+
+    FragColor = vec4(color, 1.0) * lightColor * (diffuse + ambient + specular);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+out vec3 localPos;
+
+uniform mat4 camMatrix;
+uniform mat4 model;
+uniform vec3 size;
+
+void main() {
+    // Same model space as the mesh: voxel (x, y, z) spans [x, x + 1] x [y, y + 1] x [z - 1, z]
+    localPos = aPos * size + vec3(0.0, 0.0, -1.0);
+    gl_Position = camMatrix * model * vec4(localPos, 1.0);
+}
@@ -2,3 +2,6 @@
 
 #define PROJECT_NAME "${PROJECT_NAME}"
 #define PROJECT_VERSION "${PROJECT_VERSION}"
+
+// Count allocations per pipeline phase, see utils/alloc_tracker.hh
+#cmakedefine VOX_ALLOC_TRACKING
@@ -9,7 +9,18 @@ namespace Engine {
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_DYNAMIC_DRAW);
     }
 
-    EBO::~EBO() {}
+    EBO::~EBO() { Delete(); }
+
+    EBO::EBO(EBO&& other) noexcept : id(other.id) { other.id = 0; }
+
+    EBO& EBO::operator=(EBO&& other) noexcept {
+        if (this != &other) {
+            Delete();
+            this->id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
 
     void EBO::Bind() { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id); }
 
@@ -21,5 +32,8 @@ namespace Engine {
         glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, size, indices);
     }
 
-    void EBO::Delete() { glDeleteBuffers(1, &id); }
+    void EBO::Delete() {
+        if (this->id != 0) glDeleteBuffers(1, &this->id);
+        this->id = 0;
+    }
 };  // namespace Engine
@@ -9,10 +9,15 @@ namespace Engine {
         EBO();
         EBO(GLuint* indices, GLsizeiptr size);
         ~EBO();
+        EBO(const EBO&) = delete;
+        EBO& operator=(const EBO&) = delete;
+        EBO(EBO&& other) noexcept;
+        EBO& operator=(EBO&& other) noexcept;
 
         void Bind();
         void Unbind();
         void Update(GLuint* indices, GLsizeiptr size);
+        // Frees the GL object early, the destructor does it otherwise
         void Delete();
     };
 }  // namespace Engine
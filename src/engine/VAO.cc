@@ -3,18 +3,34 @@
 namespace Engine {
     VAO::VAO() { glGenVertexArrays(1, &id); }
 
-    VAO::~VAO() {}
+    VAO::~VAO() { Delete(); }
+
+    VAO::VAO(VAO&& other) noexcept : id(other.id) { other.id = 0; }
+
+    VAO& VAO::operator=(VAO&& other) noexcept {
+        if (this != &other) {
+            Delete();
+            this->id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
 
     void VAO::Bind() { glBindVertexArray(id); }
 
     void VAO::Unbind() { glBindVertexArray(0); }
 
-    void VAO::LinkAttrib(Engine::VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset) {
+    void VAO::LinkAttrib(Engine::VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset, GLuint divisor) {
         VBO.Bind();
         glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
         glEnableVertexAttribArray(layout);
+        // Per-instance attributes advance once every `divisor` instances instead of once per vertex
+        if (divisor != 0) glVertexAttribDivisor(layout, divisor);
         VBO.Unbind();
     }
 
-    void VAO::Delete() { glDeleteVertexArrays(1, &id); }
+    void VAO::Delete() {
+        if (this->id != 0) glDeleteVertexArrays(1, &this->id);
+        this->id = 0;
+    }
 }  // namespace Engine
@@ -10,10 +10,15 @@ namespace Engine {
         GLuint id;
         VAO();
         ~VAO();
+        VAO(const VAO&) = delete;
+        VAO& operator=(const VAO&) = delete;
+        VAO(VAO&& other) noexcept;
+        VAO& operator=(VAO&& other) noexcept;
 
-        void LinkAttrib(Engine::VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset);
+        void LinkAttrib(Engine::VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset, GLuint divisor = 0);
         void Bind();
         void Unbind();
+        // Frees the GL object early, the destructor does it otherwise
         void Delete();
     };
 }  // namespace Engine
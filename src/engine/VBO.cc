@@ -9,7 +9,18 @@ namespace Engine {
         glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_DYNAMIC_DRAW);
     }
 
-    VBO::~VBO() {}
+    VBO::~VBO() { Delete(); }
+
+    VBO::VBO(VBO&& other) noexcept : id(other.id) { other.id = 0; }
+
+    VBO& VBO::operator=(VBO&& other) noexcept {
+        if (this != &other) {
+            Delete();
+            this->id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
 
     void VBO::Bind() { glBindBuffer(GL_ARRAY_BUFFER, id); }
 
@@ -21,5 +32,13 @@ namespace Engine {
         glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices);
     }
 
-    void VBO::Delete() { glDeleteBuffers(1, &id); }
+    void VBO::UpdateRange(GLintptr offset, const GLfloat* vertices, GLsizeiptr size) {
+        Bind();
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertices);
+    }
+
+    void VBO::Delete() {
+        if (this->id != 0) glDeleteBuffers(1, &this->id);
+        this->id = 0;
+    }
 }  // namespace Engine
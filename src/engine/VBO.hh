@@ -9,10 +9,17 @@ namespace Engine {
         VBO();
         VBO(GLfloat* vertices, GLsizeiptr size);
         ~VBO();
+        VBO(const VBO&) = delete;
+        VBO& operator=(const VBO&) = delete;
+        VBO(VBO&& other) noexcept;
+        VBO& operator=(VBO&& other) noexcept;
 
         void Bind();
         void Unbind();
         void Update(GLfloat* vertices, GLsizeiptr size);
+        // Overwrites part of the buffer in place, it keeps its size
+        void UpdateRange(GLintptr offset, const GLfloat* vertices, GLsizeiptr size);
+        // Frees the GL object early, the destructor does it otherwise
         void Delete();
     };
 }  // namespace Engine
@@ -0,0 +1,426 @@
+#include "asset_index.hh"
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../utils/atomic_file.hh"
+#include "../utils/trace.hh"
+#include "vox_metadata.hh"
+
+namespace Engine {
+    namespace {
+        char lower(char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; }
+
+        // One bit per letter and digit, everything else shares the remaining bits
+        uint64_t characterBit(char c) {
+            if (c >= 'a' && c <= 'z') return 1ull << (c - 'a');
+            if (c >= '0' && c <= '9') return 1ull << (26 + c - '0');
+            return 1ull << (36 + (unsigned char)c % 28);
+        }
+
+        bool isBoundary(char c) { return c == '/' || c == '\\' || c == '_' || c == '-' || c == '.' || c == ' ' || c == '\n'; }
+
+        constexpr int NO_MATCH = std::numeric_limits<int>::min();
+
+        // Greedy subsequence match, NO_MATCH if `query` is not a subsequence of `key`. Consecutive
+        // characters and characters at word starts score higher, matches ending inside the
+        // name (the first `name_length` characters of the key) beat matches that need the path.
+        int fuzzyScore(std::string_view query, std::string_view key, size_t name_length) {
+            int score = 0;
+            size_t from = 0;
+            size_t previous = std::string_view::npos;
+            for (char c : query) {
+                size_t found = key.find(c, from);
+                if (found == std::string_view::npos) return NO_MATCH;
+                score += 1;
+                if (previous != std::string_view::npos && found == previous + 1) score += 5;
+                if (found == 0 || isBoundary(key[found - 1])) score += 8;
+                if (found > from) score -= 1;
+                previous = found;
+                from = found + 1;
+            }
+            if (previous < name_length) score += 10;
+            return score - (int)(key.size() / 16);
+        }
+
+        uint64_t hashFile(const std::filesystem::path& path) {
+            uint64_t hash = 14695981039346656037ull;
+            std::ifstream file(path, std::ios::binary);
+            char buffer[65536];
+            while (file) {
+                file.read(buffer, sizeof(buffer));
+                for (std::streamsize i = 0; i < file.gcount(); i++) {
+                    hash ^= (unsigned char)buffer[i];
+                    hash *= 1099511628211ull;
+                }
+            }
+            return hash;
+        }
+    }  // namespace
+
+    void AssetSnapshot::Add(AssetRecord record, std::string_view path, std::string_view name, size_t root_length) {
+        path = path.substr(0, UINT16_MAX);
+        name = name.substr(0, UINT16_MAX);
+        record.path_offset = this->strings.size();
+        record.path_length = path.size();
+        this->strings.append(path);
+        record.name_offset = this->strings.size();
+        record.name_length = name.size();
+        this->strings.append(name);
+        this->records.push_back(record);
+
+        if (this->key_offsets.empty()) this->key_offsets.push_back(0);
+        uint64_t mask = 0;
+        auto appendKey = [&](std::string_view text) {
+            for (char c : text) {
+                c = lower(c);
+                this->keys.push_back(c);
+                mask |= characterBit(c);
+            }
+        };
+        appendKey(name);
+        this->keys.push_back('\n');
+        appendKey(path.substr(std::min(root_length, path.size())));
+        this->masks.push_back(mask);
+        this->key_offsets.push_back(this->keys.size());
+    }
+
+    AssetIndex::AssetIndex(Utils::Logger& logger, const std::string& index_path) {
+        this->logger = &logger;
+        this->index_path = index_path;
+        this->snapshot = std::make_shared<AssetSnapshot>();
+        load();
+        this->crawler = std::thread(&AssetIndex::crawlerLoop, this);
+    }
+
+    AssetIndex::~AssetIndex() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake_crawler.notify_all();
+        this->crawler.join();
+    }
+
+    std::shared_ptr<const AssetSnapshot> AssetIndex::Snapshot() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->snapshot;
+    }
+
+    std::vector<std::string> AssetIndex::Roots() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->roots;
+    }
+
+    bool AssetIndex::Crawling() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->crawling || this->rescan_requested;
+    }
+
+    void AssetIndex::AddRoot(const std::string& root) {
+        std::string normalized = std::filesystem::absolute(root).lexically_normal().string();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (std::find(this->roots.begin(), this->roots.end(), normalized) != this->roots.end()) return;
+            this->roots.push_back(normalized);
+            this->rescan_requested = true;
+        }
+        this->wake_crawler.notify_all();
+    }
+
+    bool AssetIndex::RemoveRoot(const std::string& root) {
+        std::string normalized = std::filesystem::absolute(root).lexically_normal().string();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = std::find(this->roots.begin(), this->roots.end(), normalized);
+            if (it == this->roots.end()) return false;
+            this->roots.erase(it);
+            this->rescan_requested = true;
+        }
+        this->wake_crawler.notify_all();
+        return true;
+    }
+
+    void AssetIndex::Rescan() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->rescan_requested = true;
+        }
+        this->wake_crawler.notify_all();
+    }
+
+    void AssetIndex::crawlerLoop() {
+        Utils::TraceThreadName("Asset indexer");
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (!this->stopping) {
+            this->wake_crawler.wait_for(lock, POLL_INTERVAL, [this] { return this->stopping || this->rescan_requested; });
+            if (this->stopping) break;
+            this->rescan_requested = false;
+            this->crawling = true;
+            std::vector<std::string> roots = this->roots;
+            lock.unlock();
+            bool finished = crawl(roots);
+            lock.lock();
+            this->crawling = false;
+            if (!finished) break;
+
+            this->generation.fetch_add(1);
+            void (*wake)() = this->on_update.load();
+            if (wake) wake();
+        }
+    }
+
+    bool AssetIndex::crawl(const std::vector<std::string>& roots) {
+        TRACE_SCOPE("Crawl assets");
+        std::shared_ptr<const AssetSnapshot> previous = Snapshot();
+        std::unordered_map<std::string_view, uint32_t> known;
+        for (uint32_t i = 0; i < previous->records.size(); i++) known[previous->Path(previous->records[i])] = i;
+
+        auto next = std::make_shared<AssetSnapshot>();
+        next->records.reserve(previous->records.size());
+        std::unordered_set<std::string> seen;  // Roots may overlap
+        size_t reused = 0, visited = 0;
+        for (auto& root : roots) {
+            std::error_code error;
+            std::filesystem::recursive_directory_iterator it(root, std::filesystem::directory_options::skip_permission_denied, error), end;
+            if (error) {
+                this->logger->Warn("Asset root `{}` cannot be read: {}", root, error.message());
+                continue;
+            }
+            for (; it != end; it.increment(error)) {
+                if (error) {
+                    this->logger->Warn("Stopped crawling `{}`: {}", root, error.message());
+                    break;
+                }
+                if (++visited % 256 == 0) {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    if (this->stopping) return false;
+                }
+
+                const std::filesystem::directory_entry& entry = *it;
+                if (!entry.is_regular_file(error) || entry.path().extension() != ".vox") continue;
+                std::string path = entry.path().string();
+                if (!seen.insert(path).second) continue;
+
+                AssetRecord record{};
+                std::error_code time_error, size_error, yml_error;
+                auto vox_time = entry.last_write_time(time_error);
+                record.vox_size = entry.file_size(size_error);
+                if (time_error || size_error) continue;
+                record.vox_modified = vox_time.time_since_epoch().count();
+                std::filesystem::path yml = entry.path();
+                yml.replace_extension(".yml");
+                auto yml_time = std::filesystem::last_write_time(yml, yml_error);
+                record.yml_modified = yml_error ? 0 : yml_time.time_since_epoch().count();
+
+                auto found = known.find(path);
+                if (found != known.end()) {
+                    const AssetRecord& old = previous->records[found->second];
+                    if (old.vox_modified == record.vox_modified && old.vox_size == record.vox_size && old.yml_modified == record.yml_modified) {
+                        next->Add(old, path, previous->Name(old), root.size());
+                        reused++;
+                        continue;
+                    }
+                }
+
+                VoxMetadata metadata;
+                if (PeekVoxHeader(path, metadata)) {
+                    for (int axis = 0; axis < 3; axis++) record.size[axis] = std::min(metadata.size[axis], (int)UINT16_MAX);
+                    record.voxel_count = metadata.voxel_count;
+                } else {
+                    record.flags |= AssetRecord::UNREADABLE;
+                }
+                record.hash = hashFile(entry.path());
+
+                std::string name = entry.path().stem().string();
+                if (record.yml_modified != 0) {
+                    record.flags |= AssetRecord::HAS_YAML;
+                    try {
+                        YAML::Node data = YAML::LoadFile(yml.string());
+                        if (data["name"].IsDefined()) name = data["name"].as<std::string>();
+                    } catch (const YAML::Exception& exception) {
+                        this->logger->Warn("`{}`: {}", yml.string(), exception.what());
+                    }
+                }
+                next->Add(record, path, name, root.size());
+            }
+        }
+
+        // A root without assets of its own changes no record, it still has to be saved
+        bool records_changed = reused != next->records.size() || next->records.size() != previous->records.size();
+        if (!records_changed && roots == this->saved_roots) return true;
+        if (records_changed) {
+            this->logger->Info("Indexed {} assets, {} new or changed, {} removed", next->records.size(), next->records.size() - reused,
+                previous->records.size() - reused);
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->snapshot = next;
+        }
+        if (save(*next, roots)) this->saved_roots = roots;
+        return true;
+    }
+
+    AssetIndex::SearchResult AssetIndex::Search(const std::string& query, size_t limit) {
+        TRACE_SCOPE("Asset search");
+        auto start = std::chrono::steady_clock::now();
+        SearchResult result;
+        result.snapshot = Snapshot();
+        const AssetSnapshot& snapshot = *result.snapshot;
+
+        std::string normalized;
+        uint64_t mask = 0;
+        for (char c : query) {
+            if (c == ' ') continue;
+            normalized.push_back(lower(c));
+            mask |= characterBit(normalized.back());
+        }
+
+        if (normalized.empty()) {
+            result.total = snapshot.records.size();
+            for (uint32_t index = 0; index < std::min(limit, snapshot.records.size()); index++) result.matches.push_back(Match{index, 0});
+            this->last_snapshot = nullptr;
+            result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return result;
+        }
+
+        // The character mask rejects most records with one AND, before any key is read
+        const uint64_t* masks = snapshot.masks.data();
+        std::vector<uint32_t> candidates;
+        if (this->last_snapshot == result.snapshot && normalized.starts_with(this->last_query)) {
+            // Every match of a longer query also matches the query it extends
+            for (uint32_t index : this->last_candidates) {
+                if ((masks[index] & mask) == mask) candidates.push_back(index);
+            }
+        } else {
+            for (uint32_t index = 0; index < snapshot.records.size(); index++) {
+                if ((masks[index] & mask) == mask) candidates.push_back(index);
+            }
+        }
+
+        size_t matched = 0;
+        result.matches.reserve(candidates.size());
+        for (uint32_t index : candidates) {
+            int score = fuzzyScore(normalized, snapshot.Key(index), snapshot.records[index].name_length);
+            if (score == NO_MATCH) continue;
+            candidates[matched++] = index;
+            result.matches.push_back(Match{index, score});
+        }
+        candidates.resize(matched);
+        this->last_query = normalized;
+        this->last_snapshot = result.snapshot;
+        this->last_candidates = std::move(candidates);
+
+        result.total = result.matches.size();
+        size_t kept = std::min(limit, result.matches.size());
+        auto better = [](const Match& a, const Match& b) { return a.score != b.score ? a.score > b.score : a.record < b.record; };
+        std::nth_element(result.matches.begin(), result.matches.begin() + kept, result.matches.end(), better);
+        result.matches.resize(kept);
+        std::sort(result.matches.begin(), result.matches.end(), better);
+
+        result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    // Index layout, host byte order since it never leaves the machine: magic,
+    // version, root count and roots (length and bytes), record count and the
+    // records as they are in memory, then the string pool size and bytes.
+    bool AssetIndex::save(const AssetSnapshot& snapshot, const std::vector<std::string>& roots) {
+        std::ostringstream out;
+        auto write = [&](const auto& value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        write(INDEX_MAGIC);
+        write(INDEX_VERSION);
+        write((uint32_t)roots.size());
+        for (auto& root : roots) {
+            write((uint32_t)root.size());
+            out.write(root.data(), root.size());
+        }
+        write((uint32_t)snapshot.records.size());
+        out.write(reinterpret_cast<const char*>(snapshot.records.data()), snapshot.records.size() * sizeof(AssetRecord));
+        write((uint64_t)snapshot.strings.size());
+        out.write(snapshot.strings.data(), snapshot.strings.size());
+        std::string error = Utils::WriteFileAtomic(this->index_path, out.str());
+        if (!error.empty()) {
+            this->logger->Warn("Failed to save the asset index: {}", error);
+            return false;
+        }
+        return true;
+    }
+
+    void AssetIndex::load() {
+        std::ifstream file(this->index_path, std::ios::binary | std::ios::ate);
+        if (!file) return;
+        const int64_t file_size = file.tellg();
+        file.seekg(0);
+        auto read = [&](auto& value) { file.read(reinterpret_cast<char*>(&value), sizeof(value)); };
+        // Counts are checked against what is left of the file before anything is sized by them
+        auto fits = [&](uint64_t bytes) { return file && bytes <= (uint64_t)(file_size - file.tellg()); };
+        uint32_t magic = 0, version = 0, root_count = 0, record_count = 0;
+        uint64_t strings_size = 0;
+        read(magic);
+        read(version);
+        if (!file || magic != INDEX_MAGIC || version != INDEX_VERSION) {
+            this->logger->Warn("Ignoring asset index `{}` with an unknown format", this->index_path);
+            return;
+        }
+
+        std::vector<std::string> roots;
+        read(root_count);
+        for (uint32_t i = 0; i < root_count && file; i++) {
+            uint32_t length = 0;
+            read(length);
+            if (length > 4096) break;
+            roots.emplace_back(length, '\0');
+            file.read(roots.back().data(), length);
+        }
+        std::vector<AssetRecord> records;
+        read(record_count);
+        if (file && !fits((uint64_t)record_count * sizeof(AssetRecord))) {
+            this->logger->Warn("Ignoring asset index `{}` with {} records, more than the file holds", this->index_path, record_count);
+            return;
+        }
+        if (file) {
+            records.resize(record_count);
+            file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(AssetRecord));
+        }
+        read(strings_size);
+        if (file && !fits(strings_size)) {
+            this->logger->Warn("Ignoring asset index `{}` with {} bytes of names, more than the file holds", this->index_path, strings_size);
+            return;
+        }
+        std::string strings;
+        if (file) {
+            strings.resize(strings_size);
+            file.read(strings.data(), strings.size());
+        }
+        if (!file) {
+            this->logger->Warn("Asset index `{}` is truncated, it will be rebuilt", this->index_path);
+            this->roots = roots;
+            return;
+        }
+
+        // Re-adding builds the search data and drops records whose strings point outside the pool
+        auto snapshot = std::make_shared<AssetSnapshot>();
+        snapshot->records.reserve(records.size());
+        for (auto& record : records) {
+            if ((size_t)record.path_offset + record.path_length > strings.size() || (size_t)record.name_offset + record.name_length > strings.size()) continue;
+            std::string_view path = std::string_view(strings).substr(record.path_offset, record.path_length);
+            size_t root_length = 0;
+            for (auto& root : roots) {
+                if (path.starts_with(root)) root_length = std::max(root_length, root.size());
+            }
+            snapshot->Add(record, path, std::string_view(strings).substr(record.name_offset, record.name_length), root_length);
+        }
+        this->roots = roots;
+        this->saved_roots = roots;
+        this->snapshot = snapshot;
+        this->logger->Info("Loaded {} assets under {} roots from `{}`", snapshot->records.size(), roots.size(), this->index_path);
+    }
+}  // namespace Engine
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../utils/logger.hh"
+
+namespace Engine {
+    // One .vox file under an asset root, with the .yml next to it if there is one
+    struct AssetRecord {
+        static constexpr uint16_t HAS_YAML = 1;
+        static constexpr uint16_t UNREADABLE = 2;  // Not a valid VOX file, only the path is known
+
+        uint32_t path_offset;  // Into AssetSnapshot::strings
+        uint32_t name_offset;
+        uint16_t path_length;
+        uint16_t name_length;
+        uint16_t size[3];
+        uint16_t flags;
+        uint32_t voxel_count;
+        uint64_t hash;  // FNV-1a of the .vox contents
+        uint64_t vox_modified;
+        uint64_t vox_size;
+        uint64_t yml_modified;  // 0 without a .yml
+    };
+
+    // Immutable result of one crawl. The UI keeps a reference to the snapshot it
+    // searched, so the crawler can publish a new one at any time.
+    struct AssetSnapshot {
+        std::vector<AssetRecord> records;
+        std::string strings;
+        // Search data, rebuilt on load instead of stored: a bitmask of the characters in each
+        // record's key, and the lowercase keys themselves, the name, '\n' and the path below its root
+        std::vector<uint64_t> masks;
+        std::vector<uint32_t> key_offsets;
+        std::string keys;
+
+        std::string_view Path(const AssetRecord& record) const { return std::string_view(this->strings).substr(record.path_offset, record.path_length); };
+        std::string_view Name(const AssetRecord& record) const { return std::string_view(this->strings).substr(record.name_offset, record.name_length); };
+        std::string_view Key(size_t index) const {
+            return std::string_view(this->keys).substr(this->key_offsets[index], this->key_offsets[index + 1] - this->key_offsets[index]);
+        };
+
+        // Appends a record and its strings, `record`'s offsets and lengths are filled in.
+        // The first `root_length` characters of `path` are left out of the search key.
+        void Add(AssetRecord record, std::string_view path, std::string_view name, size_t root_length);
+    };
+
+    // Indexes every .vox (and its .yml) under a set of root directories on a
+    // background thread, and keeps the result in a compact index file so the
+    // next start has it immediately. Roots are re-crawled every POLL_INTERVAL;
+    // files whose mtime and size did not change are taken over from the
+    // previous snapshot without being opened.
+    class AssetIndex {
+       public:
+        static constexpr std::chrono::seconds POLL_INTERVAL = std::chrono::seconds(30);
+
+        struct Match {
+            uint32_t record;
+            int score;
+        };
+
+        struct SearchResult {
+            std::shared_ptr<const AssetSnapshot> snapshot;
+            std::vector<Match> matches;  // Best first
+            size_t total = 0;            // Matches before the limit was applied
+            double milliseconds = 0.0;
+        };
+
+       private:
+        static constexpr uint32_t INDEX_MAGIC = 0x49415856;  // "VXAI"
+        static constexpr uint32_t INDEX_VERSION = 1;
+
+        Utils::Logger* logger;
+        std::string index_path;
+
+        std::mutex mutex;
+        std::condition_variable wake_crawler;
+        std::shared_ptr<const AssetSnapshot> snapshot;
+        std::vector<std::string> roots;
+        std::vector<std::string> saved_roots;  // As in the index file, crawler thread only once it runs
+        bool rescan_requested = true;
+        bool stopping = false;
+        bool crawling = false;
+        std::atomic<size_t> generation = 0;
+        std::atomic<void (*)()> on_update = nullptr;
+        std::thread crawler;
+
+        // Previous query and the records it matched, a query that extends it only looks at those. Main thread only.
+        std::string last_query;
+        std::shared_ptr<const AssetSnapshot> last_snapshot;
+        std::vector<uint32_t> last_candidates;
+
+        void crawlerLoop();
+        // Returns false if the crawl was interrupted by shutdown
+        bool crawl(const std::vector<std::string>& roots);
+        bool save(const AssetSnapshot& snapshot, const std::vector<std::string>& roots);
+        void load();
+
+       public:
+        AssetIndex(Utils::Logger& logger, const std::string& index_path);
+        ~AssetIndex();
+
+        std::shared_ptr<const AssetSnapshot> Snapshot();
+        std::vector<std::string> Roots();
+        bool Crawling();
+
+        // Adding or removing a root triggers a crawl, roots are stored in the index file
+        void AddRoot(const std::string& root);
+        bool RemoveRoot(const std::string& root);
+        void Rescan();
+
+        // Fuzzy subsequence match of `query` against names and paths, at most `limit` matches
+        SearchResult Search(const std::string& query, size_t limit);
+
+        // Incremented after every crawl
+        size_t Generation() { return this->generation.load(); };
+        // Called on the crawler thread after every crawl, e.g. to wake an idle main loop
+        void SetWakeCallback(void (*callback)()) { this->on_update.store(callback); };
+    };
+}  // namespace Engine
@@ -0,0 +1,117 @@
+#include "autosave.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "../utils/atomic_file.hh"
+#include "../utils/trace.hh"
+
+namespace Engine {
+    Autosave::Autosave(Utils::Logger& logger) {
+        this->logger = &logger;
+        this->writer = std::thread(&Autosave::writerLoop, this);
+    }
+
+    Autosave::~Autosave() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake_writer.notify_all();
+        this->writer.join();
+    }
+
+    uint64_t Autosave::Schedule(const std::string& path, std::string bytes, bool immediately) {
+        uint64_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto due = std::chrono::steady_clock::now() + (immediately ? std::chrono::milliseconds(0) : DEBOUNCE);
+            ticket = ++this->last_ticket;
+            this->pending[path] = Write{std::move(bytes), due, ticket};
+            this->status.pending = true;
+        }
+        this->wake_writer.notify_all();
+        return ticket;
+    }
+
+    Autosave::Status Autosave::GetStatus() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->status;
+    }
+
+    void Autosave::writerLoop() {
+        Utils::TraceThreadName("Autosave");
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (true) {
+            // Sleep until the earliest write is due, or forever if there is none
+            auto now = std::chrono::steady_clock::now();
+            auto due = std::chrono::steady_clock::time_point::max();
+            for (auto& [path, write] : this->pending) due = std::min(due, write.due);
+            if (this->stopping && this->pending.empty()) return;
+            if (!this->stopping && due > now) {
+                if (due == std::chrono::steady_clock::time_point::max()) {
+                    this->wake_writer.wait(lock);
+                } else {
+                    this->wake_writer.wait_until(lock, due);
+                }
+                continue;
+            }
+
+            // Shutting down flushes everything regardless of the debounce
+            std::vector<std::pair<std::string, Write>> ready;
+            for (auto it = this->pending.begin(); it != this->pending.end();) {
+                if (this->stopping || it->second.due <= now) {
+                    ready.emplace_back(it->first, std::move(it->second));
+                    it = this->pending.erase(it);
+                } else {
+                    it++;
+                }
+            }
+            lock.unlock();
+            std::vector<uint64_t> written;
+            for (auto& [path, ready_write] : ready) {
+                if (write(path, ready_write.bytes)) written.push_back(ready_write.ticket);
+            }
+            lock.lock();
+            for (uint64_t ticket : written) this->status.written = std::max(this->status.written, ticket);
+            this->status.pending = !this->pending.empty();
+
+            this->generation.fetch_add(1);
+            void (*wake)() = this->on_update.load();
+            if (wake) wake();
+        }
+    }
+
+    bool Autosave::write(const std::string& path, const std::string& bytes) {
+        TRACE_SCOPE("Autosave write");
+        auto known = this->on_disk.find(path);
+        if (known == this->on_disk.end()) {
+            std::ifstream file(path, std::ios::binary);
+            std::ostringstream contents;
+            if (file) contents << file.rdbuf();
+            known = this->on_disk.emplace(path, contents.str()).first;
+        }
+
+        std::string error;
+        bool unchanged = known->second == bytes;
+        if (!unchanged) {
+            error = Utils::WriteFileAtomic(path, bytes);
+            if (error.empty()) {
+                known->second = bytes;
+                this->logger->Info("Saved `{}`", path);
+            } else {
+                this->logger->Error("Autosave failed: {}", error);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (error.empty()) {
+            this->status.saved = std::time(nullptr);
+            this->status.path = path;
+        }
+        this->status.error = error;
+        return error.empty();
+    }
+}  // namespace Engine
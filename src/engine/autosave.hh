@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../utils/logger.hh"
+
+namespace Engine {
+    // Writes files on an I/O thread so a slow disk or network share never
+    // stalls a frame. Each scheduled write waits DEBOUNCE for newer contents
+    // of the same file, so a slider drag ends in one write. Writes go through
+    // Utils::WriteFileAtomic, and are skipped when the bytes are already on disk.
+    class Autosave {
+       public:
+        static constexpr std::chrono::milliseconds DEBOUNCE = std::chrono::milliseconds(1000);
+
+        struct Status {
+            bool pending = false;   // Scheduled or being written
+            std::time_t saved = 0;  // Wall clock time of the last write or skipped unchanged write, 0 if none yet
+            std::string path;       // Of that write
+            std::string error;      // Of the last failed write, cleared by the next successful one
+            uint64_t written = 0;   // Latest Schedule ticket whose contents are on disk
+        };
+
+       private:
+        struct Write {
+            std::string bytes;
+            std::chrono::steady_clock::time_point due;
+            uint64_t ticket;
+        };
+
+        Utils::Logger* logger;
+        std::mutex mutex;
+        std::condition_variable wake_writer;
+        std::map<std::string, Write> pending;  // By path, newer contents replace older ones
+        bool stopping = false;
+        uint64_t last_ticket = 0;
+        Status status;
+        // Contents last written or found on disk per path, to skip writes that change nothing. I/O thread only.
+        std::unordered_map<std::string, std::string> on_disk;
+        std::atomic<size_t> generation = 0;
+        std::atomic<void (*)()> on_update = nullptr;
+        std::thread writer;
+
+        void writerLoop();
+        // True once `bytes` are on disk, written or found there already
+        bool write(const std::string& path, const std::string& bytes);
+
+       public:
+        Autosave(Utils::Logger& logger);
+        // Pending writes are flushed, not dropped
+        ~Autosave();
+
+        // Writes `bytes` to `path` after DEBOUNCE, or as soon as possible if `immediately`. Returns a ticket that
+        // Status::written reaches once these bytes, or newer ones for the same path, are on disk.
+        uint64_t Schedule(const std::string& path, std::string bytes, bool immediately = false);
+        Status GetStatus();
+
+        // Incremented after every write, to know when to redraw the indicator
+        size_t Generation() { return this->generation.load(); };
+        // Called on the I/O thread after every write, e.g. to wake an idle main loop
+        void SetWakeCallback(void (*callback)()) { this->on_update.store(callback); };
+    };
+}  // namespace Engine
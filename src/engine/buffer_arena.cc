@@ -0,0 +1,272 @@
+#include "buffer_arena.hh"
+
+#include <algorithm>
+
+namespace Engine {
+    RangeAllocator::RangeAllocator(uint32_t capacity) { this->Grow(capacity); }
+
+    uint32_t RangeAllocator::Allocate(uint32_t length) {
+        auto best = this->free_ranges.end();
+        for (auto it = this->free_ranges.begin(); it != this->free_ranges.end(); it++) {
+            if (it->second >= length && (best == this->free_ranges.end() || it->second < best->second)) {
+                best = it;
+                if (it->second == length) break;
+            }
+        }
+        if (best == this->free_ranges.end()) return NONE;
+
+        uint32_t offset = best->first;
+        uint32_t remaining = best->second - length;
+        this->free_ranges.erase(best);
+        if (remaining > 0) this->free_ranges[offset + length] = remaining;
+        this->free_total -= length;
+        return offset;
+    }
+
+    bool RangeAllocator::Claim(uint32_t offset, uint32_t length) {
+        auto it = this->free_ranges.upper_bound(offset);
+        if (it == this->free_ranges.begin()) return false;
+        it--;
+        uint32_t start = it->first;
+        uint32_t end = it->first + it->second;
+        if (offset + length > end) return false;
+
+        this->free_ranges.erase(it);
+        if (offset > start) this->free_ranges[start] = offset - start;
+        if (end > offset + length) this->free_ranges[offset + length] = end - (offset + length);
+        this->free_total -= length;
+        return true;
+    }
+
+    void RangeAllocator::Release(uint32_t offset, uint32_t length) {
+        if (length == 0) return;
+        this->free_total += length;
+        auto next = this->free_ranges.lower_bound(offset);
+        if (next != this->free_ranges.end() && next->first == offset + length) {
+            length += next->second;
+            next = this->free_ranges.erase(next);
+        }
+        if (next != this->free_ranges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                previous->second += length;
+                return;
+            }
+        }
+        this->free_ranges[offset] = length;
+    }
+
+    void RangeAllocator::Grow(uint32_t new_capacity) {
+        if (new_capacity <= this->capacity) return;
+        uint32_t old_capacity = this->capacity;
+        this->capacity = new_capacity;
+        this->Release(old_capacity, new_capacity - old_capacity);
+    }
+
+    bool RangeAllocator::FirstFree(uint32_t& offset, uint32_t& length) const {
+        if (this->free_ranges.empty()) return false;
+        offset = this->free_ranges.begin()->first;
+        length = this->free_ranges.begin()->second;
+        return true;
+    }
+
+    uint32_t RangeAllocator::LargestFree() const {
+        uint32_t largest = 0;
+        for (auto& [offset, length] : this->free_ranges) largest = std::max(largest, length);
+        return largest;
+    }
+
+    BufferArena::BufferArena(GLsizeiptr vertex_size, std::vector<Attribute> attributes, uint32_t vertex_capacity, uint32_t index_capacity)
+        : attributes(std::move(attributes)), vertex_buffer(), index_buffer(), copy_buffer(), VAO() {
+        this->vertices.buffer = this->vertex_buffer.id;
+        this->vertices.element_size = vertex_size;
+        this->indices.buffer = this->index_buffer.id;
+        this->indices.element_size = sizeof(GLuint);
+        for (Space* space : {&this->vertices, &this->indices}) {
+            uint32_t capacity = space == &this->vertices ? vertex_capacity : index_capacity;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, space->buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, capacity * space->element_size, nullptr, GL_DYNAMIC_DRAW);
+            space->allocator.Grow(capacity);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        this->ranges.resize(1);
+        this->Link(this->VAO);
+    }
+
+    void BufferArena::Link(Engine::VAO& vao) {
+        vao.Bind();
+        for (const Attribute& attribute : this->attributes) {
+            vao.LinkAttrib(this->vertex_buffer, attribute.layout, attribute.components, attribute.type, this->vertices.element_size, (void*)attribute.offset);
+        }
+        this->index_buffer.Bind();
+        vao.Unbind();
+    }
+
+    uint32_t BufferArena::allocate(Space& space, uint32_t length) {
+        uint32_t offset = space.allocator.Allocate(length);
+        while (offset == RangeAllocator::NONE) {
+            uint32_t capacity = space.allocator.Capacity();
+            grow(space, std::max(capacity * 2, capacity + length));
+            offset = space.allocator.Allocate(length);
+        }
+        return offset;
+    }
+
+    void BufferArena::grow(Space& space, uint32_t new_capacity) {
+        // glBufferData on the same name keeps every VAO that links the buffer valid, the old contents go through a temporary
+        GLsizeiptr old_bytes = space.allocator.Capacity() * space.element_size;
+        Engine::VBO old_contents;
+        glBindBuffer(GL_COPY_READ_BUFFER, space.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, old_contents.id);
+        glBufferData(GL_COPY_WRITE_BUFFER, old_bytes, nullptr, GL_STREAM_COPY);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_bytes);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, old_contents.id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, space.buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, new_capacity * space.element_size, nullptr, GL_DYNAMIC_DRAW);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        space.allocator.Grow(new_capacity);
+    }
+
+    void BufferArena::release(Space& space, uint32_t offset, uint32_t length) {
+        if (length == 0) return;
+        space.allocator.Release(offset, length);
+        space.owners.erase(offset);
+    }
+
+    void BufferArena::shrink(Space& space, uint32_t offset, uint32_t length, uint32_t new_length) {
+        if (new_length == 0) {
+            release(space, offset, length);
+        } else {
+            space.allocator.Release(offset + new_length, length - new_length);
+        }
+    }
+
+    void BufferArena::Store(Handle& handle, const void* vertex_data, uint32_t vertex_count, const GLuint* index_data, uint32_t index_count) {
+        if (handle == 0 || handle >= this->ranges.size()) {
+            if (this->free_handles.empty()) {
+                handle = this->ranges.size();
+                this->ranges.emplace_back();
+            } else {
+                handle = this->free_handles.back();
+                this->free_handles.pop_back();
+                this->ranges[handle] = Range();
+            }
+        }
+
+        Range& range = this->ranges[handle];
+        struct Part {
+            Space& space;
+            uint32_t offset;
+            uint32_t length;
+            uint32_t new_length;
+            const void* data;
+        };
+        Part parts[] = {{this->vertices, (uint32_t)range.base_vertex, range.vertex_count, vertex_count, vertex_data},
+            {this->indices, range.first_index, (uint32_t)range.index_count, index_count, index_data}};
+        for (Part& part : parts) {
+            if (part.new_length <= part.length) {
+                shrink(part.space, part.offset, part.length, part.new_length);
+                if (part.new_length == 0) part.offset = 0;
+            } else {
+                release(part.space, part.offset, part.length);
+                part.offset = allocate(part.space, part.new_length);
+                part.space.owners[part.offset] = handle;
+            }
+            if (part.new_length == 0) continue;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, part.space.buffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, part.offset * part.space.element_size, part.new_length * part.space.element_size, part.data);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        range.base_vertex = parts[0].offset;
+        range.vertex_count = vertex_count;
+        range.first_index = parts[1].offset;
+        range.index_count = index_count;
+    }
+
+    void BufferArena::Release(Handle& handle) {
+        if (handle == 0 || handle >= this->ranges.size()) return;
+        Range& range = this->ranges[handle];
+        release(this->vertices, range.base_vertex, range.vertex_count);
+        release(this->indices, range.first_index, range.index_count);
+        range = Range();
+        this->free_handles.push_back(handle);
+        handle = 0;
+    }
+
+    void BufferArena::copyWithin(Space& space, uint32_t from, uint32_t to, uint32_t length) {
+        GLsizeiptr bytes = length * space.element_size;
+        GLintptr source = from * space.element_size;
+        GLintptr destination = to * space.element_size;
+        if (to + length <= from) {
+            glBindBuffer(GL_COPY_READ_BUFFER, space.buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, space.buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, destination, bytes);
+        } else {
+            // Copies within one buffer must not overlap, so the mesh takes a detour through the staging buffer
+            glBindBuffer(GL_COPY_WRITE_BUFFER, this->copy_buffer.id);
+            if (bytes > this->copy_capacity) {
+                glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STREAM_COPY);
+                this->copy_capacity = bytes;
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, space.buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, 0, bytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, this->copy_buffer.id);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, space.buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, destination, bytes);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    size_t BufferArena::compactStep(Space& space, bool vertex_space) {
+        uint32_t hole, hole_length;
+        if (!space.allocator.FirstFree(hole, hole_length)) return 0;
+        // Free ranges are merged, so whatever follows the first hole is either a mesh or the end of the buffer
+        auto owner = space.owners.find(hole + hole_length);
+        if (owner == space.owners.end()) return 0;
+
+        Handle handle = owner->second;
+        uint32_t from = owner->first;
+        Range& range = this->ranges[handle];
+        uint32_t length = vertex_space ? range.vertex_count : range.index_count;
+        copyWithin(space, from, hole, length);
+        space.allocator.Release(from, length);
+        space.allocator.Claim(hole, length);
+        space.owners.erase(owner);
+        space.owners[hole] = handle;
+        if (vertex_space) {
+            range.base_vertex = hole;
+        } else {
+            range.first_index = hole;
+        }
+        return length * space.element_size;
+    }
+
+    bool BufferArena::Compact(size_t budget) {
+        size_t moved = 0;
+        while (moved < budget) {
+            size_t step = compactStep(this->vertices, true);
+            if (step == 0) step = compactStep(this->indices, false);
+            if (step == 0) return true;
+            moved += step;
+            this->compacted_bytes += step;
+        }
+        return false;
+    }
+
+    BufferArena::Stats BufferArena::GetStats() const {
+        Stats stats;
+        stats.meshes = this->ranges.size() - 1 - this->free_handles.size();
+        stats.vertex_bytes = this->vertices.allocator.Used() * this->vertices.element_size;
+        stats.vertex_capacity = this->vertices.allocator.Capacity() * this->vertices.element_size;
+        stats.index_bytes = this->indices.allocator.Used() * this->indices.element_size;
+        stats.index_capacity = this->indices.allocator.Capacity() * this->indices.element_size;
+        stats.free_ranges = this->vertices.allocator.FreeRanges() + this->indices.allocator.FreeRanges();
+        stats.compacted_bytes = this->compacted_bytes;
+        return stats;
+    }
+}  // namespace Engine
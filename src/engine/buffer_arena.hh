@@ -0,0 +1,148 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+// clang-format on
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "EBO.hh"
+#include "VAO.hh"
+#include "VBO.hh"
+
+namespace Engine {
+    // Hands out ranges of [0, capacity) in whatever unit the owner counts in.
+    // Free ranges are kept sorted by offset and merged with their neighbours on
+    // release, allocation takes the smallest free range that is long enough.
+    class RangeAllocator {
+       private:
+        uint32_t capacity = 0;
+        uint32_t free_total = 0;
+        std::map<uint32_t, uint32_t> free_ranges;  // Offset to length
+
+       public:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        explicit RangeAllocator(uint32_t capacity = 0);
+
+        // The offset of the range, NONE when no free range is long enough
+        uint32_t Allocate(uint32_t length);
+        // Takes exactly [offset, offset + length), which has to be free
+        bool Claim(uint32_t offset, uint32_t length);
+        void Release(uint32_t offset, uint32_t length);
+        // Appends [capacity, new_capacity) as free space
+        void Grow(uint32_t new_capacity);
+
+        // The free range with the lowest offset, false if everything is allocated
+        bool FirstFree(uint32_t& offset, uint32_t& length) const;
+        uint32_t LargestFree() const;
+        uint32_t Capacity() const { return this->capacity; };
+        uint32_t Used() const { return this->capacity - this->free_total; };
+        size_t FreeRanges() const { return this->free_ranges.size(); };
+    };
+
+    // One large vertex buffer and one large index buffer shared by every entity
+    // mesh, so loading a model allocates ranges instead of GL objects and all
+    // meshes draw from the same VAO. Meshes are addressed through handles: their
+    // ranges move when the buffers are compacted, the handle stays valid.
+    // Indices stay relative to the mesh's own vertices and are drawn with its
+    // base vertex, so moving a mesh never rewrites its index data.
+    class BufferArena {
+       public:
+        // One vertex attribute at `offset` bytes into each vertex
+        struct Attribute {
+            GLuint layout;
+            GLuint components;
+            GLenum type;
+            size_t offset;
+        };
+
+        // Where a mesh lives in the shared buffers
+        struct Range {
+            GLint base_vertex = 0;
+            GLuint vertex_count = 0;
+            GLuint first_index = 0;
+            GLsizei index_count = 0;
+
+            // Byte offset into the index buffer, what the draw calls take
+            GLintptr IndexOffset() const { return (GLintptr)this->first_index * sizeof(GLuint); };
+        };
+
+        // 0 is no mesh
+        using Handle = uint32_t;
+
+        struct Stats {
+            size_t meshes = 0;
+            size_t vertex_bytes = 0;  // Allocated in the vertex buffer
+            size_t vertex_capacity = 0;
+            size_t index_bytes = 0;
+            size_t index_capacity = 0;
+            size_t free_ranges = 0;  // Holes in both buffers, the free tail included
+            size_t compacted_bytes = 0;  // Moved by Compact since the arena was created
+        };
+
+       private:
+        // A buffer and the allocator that tracks which of its elements are taken
+        struct Space {
+            RangeAllocator allocator;
+            GLuint buffer = 0;
+            GLsizeiptr element_size = 0;
+            // The handle whose range starts at an offset, for compaction
+            std::map<uint32_t, Handle> owners;
+        };
+
+        std::vector<Attribute> attributes;
+        Engine::VBO vertex_buffer;
+        Engine::EBO index_buffer;
+        // Staging for moves whose source and destination overlap
+        Engine::VBO copy_buffer;
+        GLsizeiptr copy_capacity = 0;
+        Space vertices;
+        Space indices;
+
+        std::vector<Range> ranges;  // Indexed by handle, 0 is unused
+        std::vector<Handle> free_handles;
+        size_t compacted_bytes = 0;
+
+        uint32_t allocate(Space& space, uint32_t length);
+        void release(Space& space, uint32_t offset, uint32_t length);
+        // Releases the end of a range in place when a mesh shrinks
+        void shrink(Space& space, uint32_t offset, uint32_t length, uint32_t new_length);
+        void grow(Space& space, uint32_t new_capacity);
+        void copyWithin(Space& space, uint32_t from, uint32_t to, uint32_t length);
+        size_t compactStep(Space& space, bool vertex_space);
+
+       public:
+        static constexpr uint32_t INITIAL_VERTICES = 1 << 16;
+        static constexpr uint32_t INITIAL_INDICES = 1 << 18;
+
+        Engine::VAO VAO;
+
+        BufferArena(GLsizeiptr vertex_size, std::vector<Attribute> attributes, uint32_t vertex_capacity = INITIAL_VERTICES,
+            uint32_t index_capacity = INITIAL_INDICES);
+        BufferArena(const BufferArena&) = delete;
+        BufferArena& operator=(const BufferArena&) = delete;
+
+        // Links the shared vertex attributes and index buffer into another VAO, e.g. one that adds per-instance
+        // attributes. Growing the buffers keeps their names, so linked VAOs stay valid.
+        void Link(Engine::VAO& vao);
+
+        // Replaces the mesh behind `handle`, allocating one if it is 0. A mesh that shrinks or keeps
+        // its size is rewritten in place, one that grows moves to wherever it fits.
+        void Store(Handle& handle, const void* vertex_data, uint32_t vertex_count, const GLuint* index_data, uint32_t index_count);
+        // Hands the ranges back and sets `handle` to 0
+        void Release(Handle& handle);
+        // An empty range for handle 0
+        const Range& Get(Handle handle) const { return this->ranges[handle < this->ranges.size() ? handle : 0]; };
+
+        // Moves meshes down into the holes left by released ones, copying at most about `budget` bytes
+        // on the GPU. Meant to run every frame so the work is spread out. Returns true once both
+        // buffers are packed and there is nothing left to move.
+        bool Compact(size_t budget);
+
+        Stats GetStats() const;
+    };
+}  // namespace Engine
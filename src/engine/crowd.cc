@@ -0,0 +1,82 @@
+#include "crowd.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace Engine {
+    Crowd::Crowd() : VAO(), instanceVBO() {
+        this->VAO.Bind();
+        // A mat4 attribute occupies four consecutive vec4 locations
+        for (int i = 0; i < 4; i++) {
+            this->VAO.LinkAttrib(instanceVBO, 3 + i, 4, GL_FLOAT, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)), 1);
+        }
+        this->VAO.Unbind();
+    }
+
+    void Crowd::Generate(glm::vec3 model_size) {
+        // Text entry in the slider can go past its range, and Reserve would take a negative count as huge
+        this->count = std::max(this->count, 1);
+        std::mt19937 rng(this->seed);
+        std::uniform_int_distribution<int> quarter_turns(0, 3);
+
+        float footprint = fmax(model_size.x, fmax(model_size.y, model_size.z));
+        float cell = fmax(footprint, 1.0f) * this->spacing;
+        int columns = std::ceil(std::sqrt((float)this->count));
+        float extent = columns * cell;
+        std::uniform_real_distribution<float> scatter(-extent / 2.0f, extent / 2.0f);
+
+        this->transforms.Clear();
+        this->transforms.Reserve(this->count);
+        for (int i = 0; i < this->count; i++) {
+            glm::vec3 position;
+            if (this->layout == CrowdLayout::GRID) {
+                position = glm::vec3((i % columns) * cell - extent / 2.0f, 0.0f, (i / columns) * cell - extent / 2.0f);
+            } else {
+                position = glm::vec3(scatter(rng), 0.0f, scatter(rng));
+            }
+            this->transforms.Add(position, glm::vec3(0.0f), QuarterTurns::Code(0, quarter_turns(rng), 0));
+        }
+        this->generated_size = model_size;
+        this->dirty = false;
+    }
+
+    void Crowd::Update(glm::vec3 model_size) {
+        if (this->dirty || model_size != this->generated_size) {
+            Generate(model_size);
+        }
+
+        auto [first, last] = this->transforms.Update();
+        if (first == last) return;
+        const std::vector<glm::mat4>& world = this->transforms.World();
+        if (world.size() != this->uploaded) {
+            this->instanceVBO.Update(const_cast<GLfloat*>(glm::value_ptr(world[0])), world.size() * sizeof(glm::mat4));
+            this->uploaded = world.size();
+        } else {
+            this->instanceVBO.UpdateRange(first * sizeof(glm::mat4), glm::value_ptr(world[first]), (last - first) * sizeof(glm::mat4));
+        }
+        this->instanceVBO.Unbind();
+    }
+
+    void Crowd::Render(GLsizei index_count, GLintptr first, GLint base_vertex) {
+        if (this->transforms.Size() == 0) return;
+        this->VAO.Bind();
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, (const void*)first, this->transforms.Size(), base_vertex);
+        this->VAO.Unbind();
+    }
+
+    void Crowd::RenderMenu(GLsizei index_count) {
+        const char* layouts[] = {"Grid", "Random"};
+        int layout = (int)this->layout;
+        this->dirty |= ImGui::SliderInt("Instances", &this->count, 1, 20000, "%d", ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_AlwaysClamp);
+        this->dirty |= ImGui::Combo("Layout", &layout, layouts, IM_ARRAYSIZE(layouts));
+        this->dirty |= ImGui::SliderFloat("Spacing", &this->spacing, 1.0f, 4.0f, "%.2f");
+        this->dirty |= ImGui::InputInt("Seed", &this->seed);
+        this->layout = (CrowdLayout)layout;
+        ImGui::Separator();
+
+        float framerate = ImGui::GetIO().Framerate;
+        ImGui::Text("FPS: %.1f (%.2f ms/frame)", framerate, 1000.0f / framerate);
+        ImGui::Text("Triangles: %lld", (long long)(index_count / 3) * this->InstanceCount());
+    }
+}  // namespace Engine
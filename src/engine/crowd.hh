@@ -0,0 +1,49 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+// clang-format on
+#include <imgui.h>
+
+#include <vector>
+
+#include "VAO.hh"
+#include "VBO.hh"
+#include "transform_system.hh"
+
+namespace Engine {
+    enum class CrowdLayout { GRID, RANDOM };
+
+    // Draws many copies of one mesh with a single instanced draw call.
+    // The mesh buffers are linked into `VAO` by their owner, the per-instance
+    // model matrices live in `instanceVBO` at attribute locations 3-6 and are
+    // re-uploaded only where `transforms` changed.
+    class Crowd {
+       private:
+        TransformSystem transforms;
+        size_t uploaded = 0;  // Instances the VBO has room for
+        glm::vec3 generated_size = glm::vec3(0.0f);
+        bool dirty = true;
+
+       public:
+        Engine::VAO VAO;
+        Engine::VBO instanceVBO;
+
+        int count = 1000;
+        CrowdLayout layout = CrowdLayout::GRID;
+        float spacing = 1.5f;  // Multiple of the model footprint
+        int seed = 1337;
+
+        Crowd();
+
+        void Generate(glm::vec3 model_size);
+        void Update(glm::vec3 model_size);
+        void Render(GLsizei index_count, GLintptr first = 0, GLint base_vertex = 0);
+        void RenderMenu(GLsizei index_count);
+        GLsizei InstanceCount() { return this->transforms.Size(); };
+    };
+}  // namespace Engine
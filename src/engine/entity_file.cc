@@ -0,0 +1,182 @@
+#include "entity_file.hh"
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+
+#include "../utils/trace.hh"
+#include "vox_metadata.hh"
+
+namespace Engine {
+    namespace {
+        // Missing values are 0, like fields an older Save did not write
+        float readFloatOrZero(const YAML::Node& node) { return node.IsDefined() ? node.as<float>() : 0.0f; }
+
+        glm::vec3 readVector(const YAML::Node& node) { return glm::vec3(readFloatOrZero(node["x"]), readFloatOrZero(node["y"]), readFloatOrZero(node["z"])); }
+
+        // variants: [{name: .., colors: {<palette index>: "#rrggbb[aa]", ..}}, ..]
+        std::string readVariants(const YAML::Node& node, std::vector<PaletteVariant>& variants) {
+            if (!node.IsDefined()) return "";
+            if (!node.IsSequence()) return "variants is not a list";
+            for (const YAML::Node& entry : node) {
+                PaletteVariant& variant = variants.emplace_back();
+                if (!entry.IsMap() || !entry["name"].IsDefined()) return std::format("variant {} has no name", variants.size());
+                variant.name = entry["name"].as<std::string>();
+                const YAML::Node& colors = entry["colors"];
+                if (!colors.IsDefined()) continue;
+                if (!colors.IsMap()) return std::format("colors of variant `{}` is not a map", variant.name);
+                for (auto it = colors.begin(); it != colors.end(); ++it) {
+                    int index = it->first.as<int>();
+                    if (index < 1 || index > 255) return std::format("variant `{}` sets palette index {}, expected 1-255", variant.name, index);
+                    std::string error = ParseColor(it->second.as<std::string>(), variant.colors[index]);
+                    if (!error.empty()) return std::format("variant `{}`: {}", variant.name, error);
+                }
+            }
+            return "";
+        }
+
+        void checkEntity(EntityCheck& check) {
+            EntityFile entity;
+            std::string error = ReadEntityFile(check.path, entity);
+            if (!error.empty()) {
+                check.errors.push_back(error);
+                return;
+            }
+
+            const char* axes[] = {"x", "y", "z"};
+            for (int axis = 0; axis < 3; axis++) {
+                float turns = entity.rotation[axis];
+                if (turns != std::floor(turns) || turns < 0.0f || turns > 3.0f) {
+                    check.errors.push_back(std::format("rotation.{} is {}, expected a whole number of quarter turns in 0-3", axes[axis], turns));
+                }
+            }
+
+            for (size_t i = 0; i < entity.variants.size(); i++) {
+                for (size_t j = 0; j < i; j++) {
+                    if (entity.variants[i].name == entity.variants[j].name) check.errors.push_back(std::format("two variants are called `{}`", entity.variants[i].name));
+                }
+            }
+
+            if (entity.model.empty()) {
+                check.errors.push_back("no model");
+                return;
+            }
+            std::string model = ResolveModelPath(check.path, entity.model);
+            if (!std::filesystem::is_regular_file(model)) {
+                check.errors.push_back(std::format("model `{}` not found", entity.model));
+                return;
+            }
+            VoxMetadata metadata;
+            if (!PeekVoxHeader(model, metadata)) {
+                check.errors.push_back(std::format("model `{}` has no valid VOX header", entity.model));
+                return;
+            }
+            if (metadata.version != 200) {
+                check.errors.push_back(std::format("model `{}` has unsupported VOX version {}", entity.model, metadata.version));
+            }
+
+            // The same range the editor's offset slider allows
+            int bound = std::max(metadata.size.x, std::max(metadata.size.y, metadata.size.z));
+            for (int axis = 0; axis < 3; axis++) {
+                if (std::abs(entity.position_offset[axis]) > bound) {
+                    check.errors.push_back(std::format("position_offset.{} is {}, outside the model bounds of +-{}", axes[axis], entity.position_offset[axis], bound));
+                }
+            }
+        }
+
+        void writeJsonString(std::ostream& out, const std::string& text) {
+            out << '"';
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    out << '\\' << c;
+                } else if ((unsigned char)c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out << escaped;
+                } else {
+                    out << c;
+                }
+            }
+            out << '"';
+        }
+    }  // namespace
+
+    std::string ReadEntityFile(const std::string& path, EntityFile& entity) {
+        try {
+            YAML::Node data = YAML::LoadFile(path);
+            if (!data.IsMap()) return "not a YAML map";
+            if (data["name"].IsDefined()) entity.name = data["name"].as<std::string>();
+            if (data["model"].IsDefined()) entity.model = data["model"].as<std::string>();
+            entity.position_offset = readVector(data["position_offset"]);
+            entity.rotation = readVector(data["rotation"]);
+            std::string error = readVariants(data["variants"], entity.variants);
+            if (!error.empty()) return error;
+        } catch (const YAML::Exception& exception) {
+            return exception.what();
+        }
+        return "";
+    }
+
+    std::string ResolveModelPath(const std::string& yml_path, const std::string& model) {
+        std::filesystem::path path(model);
+        if (path.is_absolute() || std::filesystem::exists(path)) return model;
+        return (std::filesystem::path(yml_path).parent_path() / path).string();
+    }
+
+    ValidationReport ValidateEntities(const std::string& root, JobSystem& jobs) {
+        auto start = std::chrono::steady_clock::now();
+        ValidationReport report;
+        report.root = root;
+
+        std::error_code error;
+        std::filesystem::recursive_directory_iterator it(root, std::filesystem::directory_options::skip_permission_denied, error), end;
+        for (; !error && it != end; it.increment(error)) {
+            std::error_code file_error;
+            if (it->path().extension() == ".yml" && it->is_regular_file(file_error)) report.files.push_back(EntityCheck{it->path().string(), {}});
+        }
+        if (error) {
+            report.error = error.message();
+            return report;
+        }
+        std::sort(report.files.begin(), report.files.end(), [](const EntityCheck& a, const EntityCheck& b) { return a.path < b.path; });
+
+        report.threads = std::min<size_t>(jobs.ThreadCount(), std::max<size_t>(report.files.size(), 1));
+        // One file per job, since files differ a lot in cost. Results land in their own slot so no locking is needed.
+        jobs.ParallelFor(report.files.size(), 1, [&report](size_t begin, size_t end) {
+            TRACE_SCOPE("Validate entities");
+            for (size_t index = begin; index < end; index++) checkEntity(report.files[index]);
+        });
+
+        report.failed = std::count_if(report.files.begin(), report.files.end(), [](const EntityCheck& check) { return !check.errors.empty(); });
+        report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return report;
+    }
+
+    void WriteValidationReport(const ValidationReport& report, std::ostream& out) {
+        out << "{\"root\":";
+        writeJsonString(out, report.root);
+        if (!report.error.empty()) {
+            out << ",\"error\":";
+            writeJsonString(out, report.error);
+        }
+        out << std::format(",\"files\":{},\"failed\":{},\"threads\":{},\"milliseconds\":{:.3f},\"results\":[", report.files.size(), report.failed,
+            report.threads, report.milliseconds);
+        for (size_t i = 0; i < report.files.size(); i++) {
+            const EntityCheck& check = report.files[i];
+            out << (i == 0 ? "\n{\"path\":" : ",\n{\"path\":");
+            writeJsonString(out, check.path);
+            out << ",\"ok\":" << (check.errors.empty() ? "true" : "false") << ",\"errors\":[";
+            for (size_t e = 0; e < check.errors.size(); e++) {
+                if (e > 0) out << ',';
+                writeJsonString(out, check.errors[e]);
+            }
+            out << "]}";
+        }
+        out << "\n]}\n";
+    }
+}  // namespace Engine
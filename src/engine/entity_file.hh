@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "job_system.hh"
+#include "palette.hh"
+
+namespace Engine {
+    // Entity settings as EntityBase::Serialize writes them to .yml
+    struct EntityFile {
+        std::string name;
+        std::string model;  // As written, see ResolveModelPath
+        glm::vec3 position_offset = glm::vec3(0);
+        glm::vec3 rotation = glm::vec3(0);  // Quarter turns per axis, not range checked
+        std::vector<PaletteVariant> variants;
+    };
+
+    // Parses an entity .yml, returns an empty string on success and otherwise what is wrong with it
+    std::string ReadEntityFile(const std::string& path, EntityFile& entity);
+    // The model path in a .yml is relative to the working directory it was saved from, or failing that to the .yml itself
+    std::string ResolveModelPath(const std::string& yml_path, const std::string& model);
+
+    struct EntityCheck {
+        std::string path;
+        std::vector<std::string> errors;  // Empty if the file passed
+    };
+
+    struct ValidationReport {
+        std::string root;
+        std::string error;  // Set if the tree could not be walked at all
+        int threads = 0;
+        size_t failed = 0;
+        double milliseconds = 0.0;
+        std::vector<EntityCheck> files;  // Sorted by path
+    };
+
+    // Checks every .yml under `root` without loading any model: the file parses,
+    // the model exists and has a valid VOX header, the offset lies within the
+    // model bounds, the rotations are whole quarter turns in 0-3 and palette
+    // variant names are unique. Files are
+    // checked in parallel on `jobs`.
+    ValidationReport ValidateEntities(const std::string& root, JobSystem& jobs);
+    void WriteValidationReport(const ValidationReport& report, std::ostream& out);
+}  // namespace Engine
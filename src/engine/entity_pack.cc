@@ -0,0 +1,243 @@
+#include "entity_pack.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <numeric>
+#ifdef _WIN32
+// Keep std::min and std::max usable
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../utils/atomic_file.hh"
+#include "../utils/trace.hh"
+
+namespace Engine {
+    namespace {
+        constexpr size_t BLOB_ALIGNMENT = 16;
+        constexpr uint32_t MAX_VERTEX_STRIDE = 64;
+
+        uint64_t fnv1a(const void* bytes, size_t length, uint64_t hash = 14695981039346656037ull) {
+            const unsigned char* data = static_cast<const unsigned char*>(bytes);
+            for (size_t i = 0; i < length; i++) hash = (hash ^ data[i]) * 1099511628211ull;
+            return hash;
+        }
+
+        void pad(std::string& out) { out.resize((out.size() + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT, '\0'); }
+
+        void append(std::string& out, const void* bytes, size_t length) { out.append(static_cast<const char*>(bytes), length); }
+
+        bool entityLess(const PackEntity& a, std::string_view a_name, const PackEntity& b, std::string_view b_name) {
+            return a.name_hash != b.name_hash ? a.name_hash < b.name_hash : a_name < b_name;
+        }
+    }  // namespace
+
+    uint64_t PackNameHash(std::string_view name) { return fnv1a(name.data(), name.size()); }
+
+    std::string WriteEntityPack(const std::string& path, const std::vector<PackInput>& entities, uint32_t vertex_stride) {
+        TRACE_SCOPE("Write entity pack");
+        if (vertex_stride == 0 || vertex_stride > MAX_VERTEX_STRIDE) return std::format("unsupported vertex stride {}", vertex_stride);
+
+        // The table is sorted by name hash so a lookup is a binary search over it
+        std::vector<size_t> order(entities.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::vector<uint64_t> hashes(entities.size());
+        for (size_t i = 0; i < entities.size(); i++) hashes[i] = PackNameHash(entities[i].name);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : entities[a].name < entities[b].name; });
+        for (size_t i = 1; i < order.size(); i++) {
+            if (entities[order[i]].name == entities[order[i - 1]].name) return std::format("two entities are called `{}`", entities[order[i]].name);
+        }
+
+        PackHeader header{};
+        header.magic = PackHeader::MAGIC;
+        header.version = PackHeader::VERSION;
+        header.entity_count = entities.size();
+        header.vertex_stride = vertex_stride;
+        header.names_offset = sizeof(PackHeader) + entities.size() * sizeof(PackEntity);
+
+        std::string names;
+        std::vector<PackEntity> table(entities.size());
+        std::vector<std::vector<PackPalette>> palettes(entities.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            const PackInput& input = entities[order[i]];
+            PackEntity& entity = table[i];
+            entity.name_hash = hashes[order[i]];
+            entity.name_offset = names.size();
+            entity.name_length = input.name.size();
+            names += input.name;
+            if (input.vertices.size() % vertex_stride != 0) return std::format("`{}` has a partial vertex", input.name);
+            entity.vertex_count = input.vertices.size() / vertex_stride;
+            entity.index_count = input.indices.size();
+            for (int axis = 0; axis < 3; axis++) {
+                entity.position_offset[axis] = input.position_offset[axis];
+                entity.rotation[axis] = input.rotation[axis];
+                entity.model_size[axis] = input.model_size[axis];
+                entity.bounds_min[axis] = entity.vertex_count > 0 ? input.vertices[axis] : 0.0f;
+                entity.bounds_max[axis] = entity.bounds_min[axis];
+            }
+            for (size_t v = 0; v < input.vertices.size(); v += vertex_stride) {
+                for (int axis = 0; axis < 3; axis++) {
+                    entity.bounds_min[axis] = std::min(entity.bounds_min[axis], input.vertices[v + axis]);
+                    entity.bounds_max[axis] = std::max(entity.bounds_max[axis], input.vertices[v + axis]);
+                }
+            }
+            for (uint32_t index : input.indices) {
+                if (index >= entity.vertex_count) return std::format("`{}` has an index past its last vertex", input.name);
+            }
+
+            entity.palette_count = input.variants.size() + 1;
+            palettes[i].resize(entity.palette_count);
+            palettes[i][0].colors = input.palette;
+            for (size_t v = 0; v < input.variants.size(); v++) {
+                PackPalette& palette = palettes[i][v + 1];
+                palette.name_offset = names.size();
+                palette.name_length = input.variants[v].name.size();
+                names += input.variants[v].name;
+                palette.colors = ApplyVariant(input.palette, input.variants[v]);
+            }
+        }
+        header.names_size = names.size();
+
+        // Blobs are laid out in table order, so neighbours in a lookup are neighbours on disk
+        std::string out;
+        out.resize(header.names_offset);
+        out += names;
+        for (size_t i = 0; i < order.size(); i++) {
+            const PackInput& input = entities[order[i]];
+            pad(out);
+            table[i].vertex_offset = out.size();
+            append(out, input.vertices.data(), input.vertices.size() * sizeof(float));
+            pad(out);
+            table[i].index_offset = out.size();
+            append(out, input.indices.data(), input.indices.size() * sizeof(uint32_t));
+            pad(out);
+            table[i].palette_offset = out.size();
+            append(out, palettes[i].data(), palettes[i].size() * sizeof(PackPalette));
+        }
+        pad(out);
+        std::memcpy(out.data() + sizeof(PackHeader), table.data(), table.size() * sizeof(PackEntity));
+
+        header.file_size = out.size();
+        header.checksum = fnv1a(out.data() + sizeof(PackHeader), out.size() - sizeof(PackHeader));
+        std::memcpy(out.data(), &header, sizeof(PackHeader));
+        return Utils::WriteFileAtomic(path, out);
+    }
+
+    std::string EntityPack::Open(const std::string& path) {
+        TRACE_SCOPE("Open entity pack");
+        Close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return std::format("cannot open `{}`", path);
+        LARGE_INTEGER file_size;
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view) {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            return std::format("cannot map `{}`", path);
+        }
+        this->file_handle = file;
+        this->mapping_handle = mapping;
+        this->data = static_cast<const uint8_t*>(view);
+        this->size = file_size.QuadPart;
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0) return std::format("cannot open `{}`: {}", path, std::strerror(errno));
+        struct stat status;
+        void* view = MAP_FAILED;
+        if (fstat(file, &status) == 0 && status.st_size > 0) view = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        int map_error = errno;
+        // The mapping keeps the file alive on its own
+        close(file);
+        if (view == MAP_FAILED) return std::format("cannot map `{}`: {}", path, std::strerror(map_error));
+        this->data = static_cast<const uint8_t*>(view);
+        this->size = status.st_size;
+#endif
+        std::string error = check();
+        if (!error.empty()) {
+            Close();
+            return std::format("`{}`: {}", path, error);
+        }
+        return "";
+    }
+
+    void EntityPack::Close() {
+        if (!this->data) return;
+#ifdef _WIN32
+        UnmapViewOfFile(this->data);
+        CloseHandle(this->mapping_handle);
+        CloseHandle(this->file_handle);
+        this->mapping_handle = nullptr;
+        this->file_handle = nullptr;
+#else
+        munmap(const_cast<uint8_t*>(this->data), this->size);
+#endif
+        this->data = nullptr;
+        this->size = 0;
+    }
+
+    // Everything the accessors rely on, without reading the blobs themselves
+    std::string EntityPack::check() {
+        auto fits = [this](uint64_t offset, uint64_t bytes) { return offset <= this->size && bytes <= this->size - offset; };
+        if (this->size < sizeof(PackHeader)) return "too small for a pack header";
+        const PackHeader& header = this->header();
+        if (header.magic != PackHeader::MAGIC) return "not an entity pack";
+        if (header.version != PackHeader::VERSION) return std::format("unsupported pack version {}, expected {}", header.version, PackHeader::VERSION);
+        if (header.file_size != this->size) return std::format("truncated, {} of {} bytes", this->size, header.file_size);
+        if (header.vertex_stride == 0 || header.vertex_stride > MAX_VERTEX_STRIDE) return std::format("unsupported vertex stride {}", header.vertex_stride);
+        if (header.names_offset < sizeof(PackHeader) + (uint64_t)header.entity_count * sizeof(PackEntity) || !fits(header.names_offset, header.names_size)) {
+            return "entity table out of bounds";
+        }
+        for (const PackEntity& entity : this->Entities()) {
+            if ((uint64_t)entity.name_offset + entity.name_length > header.names_size) return "entity name out of bounds";
+            if (entity.vertex_offset % BLOB_ALIGNMENT != 0 || !fits(entity.vertex_offset, (uint64_t)entity.vertex_count * header.vertex_stride * sizeof(float)) ||
+                entity.index_offset % BLOB_ALIGNMENT != 0 || !fits(entity.index_offset, (uint64_t)entity.index_count * sizeof(uint32_t))) {
+                return std::format("mesh of `{}` out of bounds", this->Name(entity));
+            }
+            if (entity.palette_offset % BLOB_ALIGNMENT != 0 || !fits(entity.palette_offset, (uint64_t)entity.palette_count * sizeof(PackPalette))) {
+                return std::format("palettes of `{}` out of bounds", this->Name(entity));
+            }
+            for (const PackPalette& palette : this->Palettes(entity)) {
+                if ((uint64_t)palette.name_offset + palette.name_length > header.names_size) return std::format("palette name of `{}` out of bounds", this->Name(entity));
+            }
+        }
+        return "";
+    }
+
+    std::string EntityPack::Verify() const {
+        TRACE_SCOPE("Verify entity pack");
+        if (!this->data) return "no pack open";
+        if (fnv1a(this->data + sizeof(PackHeader), this->size - sizeof(PackHeader)) != this->header().checksum) return "checksum mismatch";
+        std::span<const PackEntity> entities = this->Entities();
+        for (size_t i = 0; i < entities.size(); i++) {
+            const PackEntity& entity = entities[i];
+            std::string_view name = this->Name(entity);
+            if (entity.name_hash != PackNameHash(name)) return std::format("wrong name hash for `{}`", name);
+            if (i > 0 && !entityLess(entities[i - 1], this->Name(entities[i - 1]), entity, name)) return std::format("table out of order at `{}`", name);
+            for (uint32_t index : this->Indices(entity)) {
+                if (index >= entity.vertex_count) return std::format("`{}` has an index past its last vertex", name);
+            }
+        }
+        return "";
+    }
+
+    const PackEntity* EntityPack::Find(std::string_view name) const {
+        if (!this->data) return nullptr;
+        uint64_t hash = PackNameHash(name);
+        std::span<const PackEntity> entities = this->Entities();
+        auto it = std::lower_bound(entities.begin(), entities.end(), hash, [](const PackEntity& entity, uint64_t hash) { return entity.name_hash < hash; });
+        for (; it != entities.end() && it->name_hash == hash; it++) {
+            if (this->Name(*it) == name) return &*it;
+        }
+        return nullptr;
+    }
+}  // namespace Engine
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "palette.hh"
+
+namespace Engine {
+    // Layout of a pack file, every field little endian and used in place after mapping:
+    //
+    //   PackHeader
+    //   PackEntity[entity_count]  sorted by name_hash, then name
+    //   names                     not terminated, PackEntity::name_offset/length and PackPalette::name_offset/length
+    //   per entity, 16 byte aligned: vertices (float[vertex_count * vertex_stride]), indices (uint32_t[index_count]),
+    //                                palettes (PackPalette[palette_count])
+    //
+    // Vertices hold palette indices, not colors. Palette 0 is the model's own,
+    // the others are its named variants with their overrides already applied.
+    //
+    // The checksum covers everything after the header.
+    struct PackHeader {
+        static constexpr uint32_t MAGIC = 0x4b505856;  // "VXPK"
+        static constexpr uint32_t VERSION = 2;
+
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entity_count;
+        uint32_t vertex_stride;  // Floats per vertex, EntityBase::VERTEX_STRIDE at the time of writing
+        uint64_t file_size;
+        uint64_t names_offset;
+        uint64_t names_size;
+        uint64_t checksum;  // FNV-1a
+        uint8_t reserved[16];
+    };
+
+    struct PackEntity {
+        uint64_t name_hash;  // FNV-1a, see PackNameHash
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint64_t vertex_offset;  // From the start of the file
+        uint64_t index_offset;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        float position_offset[3];
+        float rotation[3];  // Quarter turns
+        float bounds_min[3];  // Of the mesh, in model space
+        float bounds_max[3];
+        int32_t model_size[3];
+        uint32_t palette_count;
+        uint64_t palette_offset;
+    };
+
+    struct PackPalette {
+        uint32_t name_offset;  // Empty for the model's own palette
+        uint32_t name_length;
+        uint32_t reserved[2];
+        PaletteColors colors;
+    };
+
+    static_assert(sizeof(PackHeader) == 64 && sizeof(PackEntity) % 16 == 0 && sizeof(PackPalette) % 16 == 0,
+        "pack records must keep the blobs after them aligned");
+    static_assert(std::endian::native == std::endian::little, "pack fields are little endian and used in place");
+
+    uint64_t PackNameHash(std::string_view name);
+
+    // One entity as it goes into a pack
+    struct PackInput {
+        std::string name;
+        glm::vec3 position_offset = glm::vec3(0);
+        glm::vec3 rotation = glm::vec3(0);
+        glm::ivec3 model_size = glm::ivec3(0);
+        PaletteColors palette{};
+        std::vector<PaletteVariant> variants;
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // Writes `entities` to `path` atomically, returns an empty string on success and otherwise what went wrong.
+    // Names must be unique, they are what the engine looks entities up by.
+    std::string WriteEntityPack(const std::string& path, const std::vector<PackInput>& entities, uint32_t vertex_stride);
+
+    // A pack file mapped read only. Open checks that the header and every
+    // offset in the table lie within the file, so lookups and the returned
+    // spans need no further checks; Verify additionally checksums the contents.
+    class EntityPack {
+       private:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+#endif
+
+        const PackHeader& header() const { return *reinterpret_cast<const PackHeader*>(this->data); };
+        std::string check();
+
+       public:
+        EntityPack() = default;
+        EntityPack(const EntityPack&) = delete;
+        EntityPack& operator=(const EntityPack&) = delete;
+        ~EntityPack() { Close(); };
+
+        // Returns an empty string on success, otherwise why the file cannot be used
+        std::string Open(const std::string& path);
+        void Close();
+        bool IsOpen() const { return this->data != nullptr; };
+        std::string Verify() const;
+
+        uint32_t Count() const { return this->header().entity_count; };
+        uint32_t VertexStride() const { return this->header().vertex_stride; };
+        size_t Bytes() const { return this->size; };
+        std::span<const PackEntity> Entities() const {
+            return std::span<const PackEntity>(reinterpret_cast<const PackEntity*>(this->data + sizeof(PackHeader)), this->Count());
+        };
+        // nullptr if there is no entity called `name`
+        const PackEntity* Find(std::string_view name) const;
+
+        std::string_view Name(const PackEntity& entity) const {
+            return std::string_view(reinterpret_cast<const char*>(this->data + this->header().names_offset + entity.name_offset), entity.name_length);
+        };
+        std::span<const float> Vertices(const PackEntity& entity) const {
+            return std::span<const float>(reinterpret_cast<const float*>(this->data + entity.vertex_offset), (size_t)entity.vertex_count * this->VertexStride());
+        };
+        std::span<const uint32_t> Indices(const PackEntity& entity) const {
+            return std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(this->data + entity.index_offset), entity.index_count);
+        };
+        std::span<const PackPalette> Palettes(const PackEntity& entity) const {
+            return std::span<const PackPalette>(reinterpret_cast<const PackPalette*>(this->data + entity.palette_offset), entity.palette_count);
+        };
+        std::string_view Name(const PackPalette& palette) const {
+            return std::string_view(reinterpret_cast<const char*>(this->data + this->header().names_offset + palette.name_offset), palette.name_length);
+        };
+    };
+}  // namespace Engine
@@ -0,0 +1,234 @@
+#include "job_system.hh"
+
+#include <algorithm>
+#include <format>
+
+#include "../utils/trace.hh"
+
+namespace Engine {
+    namespace {
+        static_assert((JobSystem::DEQUE_CAPACITY & (JobSystem::DEQUE_CAPACITY - 1)) == 0, "the deque ring is indexed with a mask");
+
+        // Failed attempts to find a job before a worker goes to sleep
+        constexpr int IDLE_SPINS = 64;
+
+        // Set on worker threads, the creating thread is recognized by its id instead
+        thread_local const JobSystem* current_system = nullptr;
+        thread_local int current_index = -1;
+    }  // namespace
+
+    JobSystem::Deque::Deque() : ring(new std::atomic<Job*>[DEQUE_CAPACITY]) {}
+
+    bool JobSystem::Deque::Push(Job* job) {
+        int64_t b = this->bottom.load(std::memory_order_relaxed);
+        int64_t t = this->top.load(std::memory_order_acquire);
+        if (b - t >= DEQUE_CAPACITY) return false;
+        this->ring[b & (DEQUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+        this->bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    JobSystem::Job* JobSystem::Deque::Pop() {
+        int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+        this->bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = this->top.load(std::memory_order_relaxed);
+        if (t > b) {
+            this->bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = this->ring[b & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // The last job, thieves may be after it too
+            if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+            this->bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    JobSystem::Job* JobSystem::Deque::Steal() {
+        int64_t t = this->top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = this->bottom.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+        Job* job = this->ring[t & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+        return job;
+    }
+
+    JobSystem::JobSystem(int threads) {
+        if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        this->owner = std::this_thread::get_id();
+        for (int i = 0; i < threads; i++) this->deques.push_back(std::make_unique<Deque>());
+        for (int i = 1; i < threads; i++) this->workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->work_available.notify_all();
+        for (auto& worker : this->workers) worker.join();
+        // Without workers, or for jobs queued by the last ones to finish
+        int index = ThreadIndex();
+        while (Job* job = take(index)) execute(job);
+    }
+
+    int JobSystem::ThreadIndex() const {
+        if (current_system == this) return current_index;
+        return std::this_thread::get_id() == this->owner ? 0 : -1;
+    }
+
+    void JobSystem::workerLoop(int index) {
+        current_system = this;
+        current_index = index;
+        Utils::TraceThreadName(std::format("Jobs {}", index));
+        int idle = 0;
+        while (true) {
+            if (Job* job = take(index)) {
+                execute(job);
+                idle = 0;
+                continue;
+            }
+            if (++idle < IDLE_SPINS) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (this->stopping && this->queued.load() <= 0) return;
+            // Run reads `sleeping` after raising `queued`, so either it sees this worker or the predicate sees its job
+            this->sleeping.fetch_add(1);
+            this->work_available.wait(lock, [this] { return this->stopping || this->queued.load() > 0; });
+            this->sleeping.fetch_sub(1);
+            idle = 0;
+        }
+    }
+
+    JobSystem::Job* JobSystem::take(int index) {
+        Job* job = index >= 0 ? this->deques[index]->Pop() : nullptr;
+        if (job == nullptr && this->injected_count.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (!this->injected.empty()) {
+                job = this->injected.front();
+                this->injected.pop_front();
+                this->injected_count.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        if (job == nullptr) {
+            // Every thief starts at its right neighbour, so they do not all pile onto the same deque
+            int count = this->deques.size();
+            for (int i = 1; i <= count && job == nullptr; i++) {
+                int victim = (index + i) % count;
+                if (victim != index) job = this->deques[victim]->Steal();
+            }
+            if (job != nullptr) this->stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (job != nullptr) this->queued.fetch_sub(1);
+        return job;
+    }
+
+    void JobSystem::execute(Job* job) {
+        {
+            Utils::AllocPhaseScope phase(job->phase);
+            job->body();
+            // Whatever the job captured goes before its counter is released, a waiter may free what it refers to
+            job->body = nullptr;
+        }
+        Counter* counter = job->counter;
+        delete job;
+        this->executed.fetch_add(1, std::memory_order_relaxed);
+        if (counter != nullptr) counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    void JobSystem::Run(std::function<void()> body, Counter* counter) {
+        if (counter != nullptr) counter->pending.fetch_add(1, std::memory_order_relaxed);
+        Job* job = new Job{std::move(body), counter, Utils::CurrentAllocPhase()};
+        int index = ThreadIndex();
+        this->queued.fetch_add(1);
+        if (index >= 0) {
+            if (!this->deques[index]->Push(job)) {
+                this->queued.fetch_sub(1);
+                execute(job);
+                return;
+            }
+            if (this->sleeping.load() > 0) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->work_available.notify_one();
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->injected.push_back(job);
+            this->injected_count.fetch_add(1, std::memory_order_relaxed);
+            this->work_available.notify_one();
+        }
+        // Without workers nothing steals the job, the main loop has to come around and run it
+        if (this->workers.empty()) {
+            if (auto callback = this->on_main_job.load()) callback();
+        }
+    }
+
+    void JobSystem::Wait(Counter& counter) {
+        int index = ThreadIndex();
+        while (!counter.Done()) {
+            if (Job* job = take(index)) {
+                execute(job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+        if (count == 0) return;
+        if (grain == 0) grain = std::max<size_t>(1, count / (this->deques.size() * 4));
+        if (this->deques.size() == 1 || grain >= count) {
+            for (size_t begin = 0; begin < count; begin += grain) body(begin, std::min(begin + grain, count));
+            return;
+        }
+        Counter counter;
+        // Queued last to first, so the calling thread pops them in order after its own piece while thieves take the far end
+        for (size_t begin = (count - 1) / grain * grain; begin > 0; begin -= grain) {
+            size_t end = std::min(begin + grain, count);
+            Run([&body, begin, end] { body(begin, end); }, &counter);
+        }
+        body(0, grain);
+        Wait(counter);
+    }
+
+    void JobSystem::RunOnMainThread(std::function<void()> body) {
+        {
+            std::lock_guard<std::mutex> lock(this->main_mutex);
+            this->main_jobs.push_back(std::move(body));
+        }
+        if (auto callback = this->on_main_job.load()) callback();
+    }
+
+    size_t JobSystem::RunMainThreadJobs() {
+        size_t ran = 0;
+        if (this->workers.empty()) {
+            // The only thread of the system, queued jobs would otherwise wait for the next Wait or the destructor
+            int index = ThreadIndex();
+            while (Job* job = take(index)) {
+                execute(job);
+                ran++;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->main_mutex);
+            std::swap(this->main_jobs, this->main_running);
+        }
+        for (auto& job : this->main_running) job();
+        ran += this->main_running.size();
+        this->main_running.clear();
+        return ran;
+    }
+
+    JobSystem::Stats JobSystem::GetStats() const {
+        Stats stats;
+        stats.threads = this->deques.size();
+        stats.jobs = this->executed.load(std::memory_order_relaxed);
+        stats.stolen = this->stolen.load(std::memory_order_relaxed);
+        return stats;
+    }
+}  // namespace Engine
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../utils/alloc_tracker.hh"
+
+namespace Engine {
+    // Runs short CPU jobs on one thread per core. Every thread of the system owns
+    // a deque it pushes to and pops from at the bottom, idle threads steal from the
+    // top of the others', so a thread that fans out keeps working on its own most
+    // recent, cache-warm jobs while the oldest ones spread out. The thread that
+    // creates the system counts as one of them, it runs jobs whenever it waits.
+    //
+    // Completion is tracked with counters instead of handles: Run adds the job to
+    // a counter and the job takes itself off when it returns. A job can run its
+    // children on the counter it runs under, which then covers the whole tree.
+    // Wait never blocks a thread, it runs other jobs until the counter is done.
+    //
+    // GL may only be used on the main thread, jobs hand that part over with
+    // RunOnMainThread and the main loop calls RunMainThreadJobs once per frame.
+    class JobSystem {
+       public:
+        struct Counter {
+            std::atomic<int> pending = 0;
+
+            bool Done() const { return this->pending.load(std::memory_order_acquire) == 0; };
+        };
+
+        struct Stats {
+            int threads = 0;
+            uint64_t jobs = 0;    // Run since the system was created
+            uint64_t stolen = 0;  // Of those, taken from another thread's deque
+        };
+
+        // Jobs a thread can have queued, when its deque is full Run executes the job right away
+        static constexpr int64_t DEQUE_CAPACITY = 4096;
+
+       private:
+        struct Job {
+            std::function<void()> body;
+            Counter* counter;
+            Utils::AllocPhase phase;  // Of the thread that queued it, so allocations are counted as if it ran there
+        };
+
+        // Chase-Lev work-stealing deque on a fixed ring (Lê et al., "Correct and Efficient Work-Stealing for Weak
+        // Memory Models"). Push and Pop are for the owning thread only, Steal is safe from any thread.
+        class Deque {
+           private:
+            alignas(64) std::atomic<int64_t> top = 0;
+            alignas(64) std::atomic<int64_t> bottom = 0;
+            std::unique_ptr<std::atomic<Job*>[]> ring;
+
+           public:
+            Deque();
+
+            // False if the deque is full
+            bool Push(Job* job);
+            Job* Pop();
+            // nullptr if empty, or if another thread took the same job first
+            Job* Steal();
+        };
+
+        std::vector<std::unique_ptr<Deque>> deques;  // One per thread, 0 is the creating thread's
+        std::vector<std::thread> workers;
+        std::thread::id owner;
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::deque<Job*> injected;  // Queued by threads outside the system
+        std::atomic<size_t> injected_count = 0;
+        std::atomic<int> queued = 0;  // Jobs waiting in any deque or in `injected`
+        std::atomic<int> sleeping = 0;
+        bool stopping = false;
+
+        std::atomic<uint64_t> executed = 0;
+        std::atomic<uint64_t> stolen = 0;
+
+        std::mutex main_mutex;
+        std::vector<std::function<void()>> main_jobs;
+        std::vector<std::function<void()>> main_running;  // Swapped with main_jobs, so a main job can queue the next one
+        std::atomic<void (*)()> on_main_job = nullptr;
+
+        void workerLoop(int index);
+        // A queued job for thread `index`, -1 outside the system: its own newest, then injected ones, then stolen ones
+        Job* take(int index);
+        void execute(Job* job);
+
+       public:
+        // `threads` includes the creating thread, 0 picks one per core
+        explicit JobSystem(int threads = 0);
+        // Runs whatever is still queued before joining, main thread jobs that never ran are dropped
+        ~JobSystem();
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        int ThreadCount() const { return this->deques.size(); };
+        // Of the calling thread in [0, ThreadCount()), -1 if it is not part of this system
+        int ThreadIndex() const;
+
+        // Queues `body`, adding it to `counter` if there is one. Callable from any thread and from inside jobs.
+        void Run(std::function<void()> body, Counter* counter = nullptr);
+        // Returns once `counter` is done, running queued jobs in the meantime
+        void Wait(Counter& counter);
+
+        // Calls `body` on the ranges [begin, end) that cut [0, count) into pieces of `grain` items and waits for all
+        // of them, the calling thread takes the first piece. `grain` 0 picks about four pieces per thread.
+        void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+        // Queues `body` for the next RunMainThreadJobs, e.g. the GL upload at the end of a job
+        void RunOnMainThread(std::function<void()> body);
+        // Main thread only, returns how many jobs ran. With a single thread it first runs the queued jobs, which
+        // have no worker to run them.
+        size_t RunMainThreadJobs();
+
+        Stats GetStats() const;
+        // Called on the queueing thread after RunOnMainThread, and after Run without workers, e.g. to wake an idle main loop
+        void SetWakeCallback(void (*callback)()) { this->on_main_job.store(callback); };
+    };
+}  // namespace Engine
@@ -0,0 +1,324 @@
+#include "mesh_optimizer.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+
+namespace Engine {
+    namespace MeshOptimizer {
+        CacheStats AnalyzeVertexCache(const std::vector<GLuint>& indices, size_t vertex_count, int cache_size, std::pmr::memory_resource* scratch) {
+            CacheStats stats;
+            stats.triangles = indices.size() / 3;
+            if (stats.triangles == 0) return stats;
+
+            // FIFO cache: a vertex is resident if it was inserted less than `cache_size` misses ago, hits do not refresh it
+            std::pmr::vector<int64_t> inserted(vertex_count, -1, scratch);
+            std::pmr::vector<bool> referenced(vertex_count, false, scratch);
+            int64_t time = 0;
+            size_t misses = 0;
+            for (GLuint index : indices) {
+                if (inserted[index] < 0 || time - inserted[index] >= cache_size) {
+                    inserted[index] = time++;
+                    misses++;
+                }
+                if (!referenced[index]) {
+                    referenced[index] = true;
+                    stats.vertices++;
+                }
+            }
+            stats.acmr = (float)misses / stats.triangles;
+            stats.atvr = stats.vertices ? (float)misses / stats.vertices : 0.0f;
+            return stats;
+        }
+
+        void WeldVertices(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, int stride, std::pmr::memory_resource* scratch) {
+            size_t vertex_count = vertices.size() / stride;
+            size_t table_size = 1;
+            while (table_size < vertex_count * 2) table_size *= 2;
+
+            // Open addressing table of unique vertex ids, keyed by the raw vertex bytes
+            std::pmr::vector<int64_t> table(table_size, -1, scratch);
+            std::pmr::vector<GLuint> remap(vertex_count, scratch);
+            std::pmr::vector<GLfloat> unique(scratch);
+            unique.reserve(vertices.size());
+            size_t unique_count = 0;
+
+            for (size_t v = 0; v < vertex_count; v++) {
+                const GLfloat* vertex = &vertices[v * stride];
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(vertex);
+                uint64_t hash = 14695981039346656037ull;
+                for (size_t b = 0; b < stride * sizeof(GLfloat); b++) hash = (hash ^ bytes[b]) * 1099511628211ull;
+
+                size_t slot = hash & (table_size - 1);
+                while (table[slot] >= 0 && std::memcmp(&unique[table[slot] * stride], vertex, stride * sizeof(GLfloat)) != 0) {
+                    slot = (slot + 1) & (table_size - 1);
+                }
+                if (table[slot] < 0) {
+                    table[slot] = unique_count++;
+                    unique.insert(unique.end(), vertex, vertex + stride);
+                }
+                remap[v] = table[slot];
+            }
+
+            for (GLuint& index : indices) index = remap[index];
+            vertices.assign(unique.begin(), unique.end());
+        }
+
+        namespace {
+            constexpr int FORSYTH_CACHE_SIZE = 32;
+            constexpr int FORSYTH_MAX_VALENCE = 32;
+            constexpr float CACHE_DECAY_POWER = 1.5f;
+            constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+            constexpr float VALENCE_BOOST_SCALE = 2.0f;
+            constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+            struct ScoreTables {
+                float cache[FORSYTH_CACHE_SIZE];
+                float valence[FORSYTH_MAX_VALENCE];
+
+                ScoreTables() {
+                    for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+                        if (i < 3) {
+                            // The last triangle's vertices get a fixed score so its neighbours are not preferred too strongly
+                            cache[i] = LAST_TRIANGLE_SCORE;
+                        } else {
+                            float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                            cache[i] = std::pow(1.0f - (i - 3) * scaler, CACHE_DECAY_POWER);
+                        }
+                    }
+                    valence[0] = 0.0f;
+                    for (int i = 1; i < FORSYTH_MAX_VALENCE; i++) {
+                        valence[i] = VALENCE_BOOST_SCALE * std::pow((float)i, -VALENCE_BOOST_POWER);
+                    }
+                }
+            };
+
+            float vertexScore(const ScoreTables& tables, int cache_position, int remaining_valence) {
+                // Vertices without remaining triangles never need to be picked
+                if (remaining_valence == 0) return -1.0f;
+                float score = cache_position >= 0 ? tables.cache[cache_position] : 0.0f;
+                return score + tables.valence[std::min(remaining_valence, FORSYTH_MAX_VALENCE - 1)];
+            }
+        }  // namespace
+
+        void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertex_count, std::pmr::memory_resource* scratch) {
+            static const ScoreTables tables;
+            size_t triangle_count = indices.size() / 3;
+            if (triangle_count == 0) return;
+
+            // Triangles adjacent to every vertex, the live (not yet emitted) ones are kept at the front of each range
+            std::pmr::vector<uint32_t> valence(vertex_count, 0, scratch);
+            for (GLuint index : indices) valence[index]++;
+            std::pmr::vector<uint32_t> adjacency_offset(vertex_count + 1, 0, scratch);
+            for (size_t v = 0; v < vertex_count; v++) adjacency_offset[v + 1] = adjacency_offset[v] + valence[v];
+            std::pmr::vector<uint32_t> adjacency(indices.size(), scratch);
+            std::pmr::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1, scratch);
+            for (size_t t = 0; t < triangle_count; t++) {
+                for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = t;
+            }
+
+            std::pmr::vector<int> cache_position(vertex_count, -1, scratch);
+            std::pmr::vector<float> vertex_score(vertex_count, scratch);
+            for (size_t v = 0; v < vertex_count; v++) vertex_score[v] = vertexScore(tables, -1, valence[v]);
+
+            std::pmr::vector<float> triangle_score(triangle_count, scratch);
+            std::pmr::vector<bool> emitted(triangle_count, false, scratch);
+            int64_t best_triangle = -1;
+            float best_score = -1.0f;
+            for (size_t t = 0; t < triangle_count; t++) {
+                triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best_triangle = t;
+                }
+            }
+
+            std::pmr::vector<GLuint> output(scratch);
+            output.reserve(indices.size());
+            std::pmr::vector<GLuint> cache(scratch);
+            std::pmr::vector<GLuint> new_cache(scratch);
+            cache.reserve(FORSYTH_CACHE_SIZE + 3);
+            new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+            size_t cursor = 0;
+
+            for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++) {
+                if (best_triangle < 0) {
+                    // Nothing adjacent to the cache is left, continue with the next triangle in input order
+                    while (emitted[cursor]) cursor++;
+                    best_triangle = cursor;
+                }
+
+                const GLuint* triangle = &indices[best_triangle * 3];
+                emitted[best_triangle] = true;
+                new_cache.clear();
+                for (int k = 0; k < 3; k++) {
+                    GLuint v = triangle[k];
+                    output.push_back(v);
+
+                    // Remove the triangle from the live part of the vertex' adjacency
+                    uint32_t* begin = &adjacency[adjacency_offset[v]];
+                    uint32_t* end = begin + valence[v];
+                    uint32_t* found = std::find(begin, end, (uint32_t)best_triangle);
+                    if (found != end) {
+                        std::swap(*found, *(end - 1));
+                        valence[v]--;
+                    }
+                    if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end()) new_cache.push_back(v);
+                }
+                for (GLuint v : cache) {
+                    if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end()) new_cache.push_back(v);
+                }
+
+                for (size_t i = 0; i < new_cache.size(); i++) {
+                    GLuint v = new_cache[i];
+                    cache_position[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+                    vertex_score[v] = vertexScore(tables, cache_position[v], valence[v]);
+                }
+
+                // Only triangles touching the cache can change their score, the best of them is emitted next
+                best_triangle = -1;
+                best_score = -1.0f;
+                for (GLuint v : new_cache) {
+                    for (uint32_t a = adjacency_offset[v]; a < adjacency_offset[v] + valence[v]; a++) {
+                        uint32_t t = adjacency[a];
+                        triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+                        if (triangle_score[t] > best_score) {
+                            best_score = triangle_score[t];
+                            best_triangle = t;
+                        }
+                    }
+                }
+
+                if (new_cache.size() > FORSYTH_CACHE_SIZE) new_cache.resize(FORSYTH_CACHE_SIZE);
+                cache.swap(new_cache);
+            }
+
+            indices.assign(output.begin(), output.end());
+        }
+
+        void OptimizeOverdraw(std::vector<GLuint>& indices, const std::vector<GLfloat>& vertices, int stride,
+            const std::function<glm::vec3(const GLfloat* vertex)>& facing, float threshold, std::pmr::memory_resource* scratch) {
+            size_t triangle_count = indices.size() / 3;
+            size_t vertex_count = vertices.size() / stride;
+            if (triangle_count == 0) return;
+
+            // Counts FIFO cache misses for triangles [begin, end) starting from an empty cache
+            std::pmr::vector<int64_t> inserted(vertex_count, -1, scratch);
+            int64_t time = 0;
+            auto missesOf = [&](size_t triangle) {
+                int misses = 0;
+                for (int k = 0; k < 3; k++) {
+                    GLuint v = indices[triangle * 3 + k];
+                    if (inserted[v] < 0 || time - inserted[v] >= FIFO_CACHE_SIZE) {
+                        inserted[v] = time++;
+                        misses++;
+                    }
+                }
+                return misses;
+            };
+            auto flush = [&]() { time += FIFO_CACHE_SIZE; };
+
+            // Hard boundaries: triangles where the cache-optimized order had to start over (all three vertices missed)
+            std::pmr::vector<size_t> hard(scratch);
+            for (size_t t = 0; t < triangle_count; t++) {
+                if (missesOf(t) == 3) hard.push_back(t);
+            }
+            if (hard.empty() || hard[0] != 0) hard.insert(hard.begin(), 0);
+            hard.push_back(triangle_count);
+
+            // Soft boundaries: split a hard cluster as soon as its prefix is within `threshold` of the cluster's own ACMR
+            std::pmr::vector<size_t> clusters(scratch);
+            for (size_t h = 0; h + 1 < hard.size(); h++) {
+                size_t begin = hard[h], end = hard[h + 1];
+                flush();
+                int cluster_misses = 0;
+                for (size_t t = begin; t < end; t++) cluster_misses += missesOf(t);
+                float cluster_acmr = (float)cluster_misses / (end - begin);
+
+                flush();
+                size_t start = begin;
+                int misses = 0;
+                clusters.push_back(begin);
+                for (size_t t = begin; t < end; t++) {
+                    misses += missesOf(t);
+                    size_t length = t - start + 1;
+                    if (length >= 8 && t + 1 < end && (float)misses / length <= cluster_acmr * threshold) {
+                        clusters.push_back(t + 1);
+                        start = t + 1;
+                        misses = 0;
+                        flush();
+                    }
+                }
+            }
+            clusters.push_back(triangle_count);
+
+            // Sort key: how far the cluster sits out from the mesh centroid along its average facing direction
+            auto position = [&](GLuint v) { return &vertices[v * stride]; };
+            double mesh_centroid[3] = {0.0, 0.0, 0.0};
+            for (GLuint index : indices) {
+                for (int c = 0; c < 3; c++) mesh_centroid[c] += position(index)[c];
+            }
+            for (int c = 0; c < 3; c++) mesh_centroid[c] /= indices.size();
+
+            size_t cluster_count = clusters.size() - 1;
+            std::pmr::vector<float> sort_key(cluster_count, scratch);
+            for (size_t c = 0; c < cluster_count; c++) {
+                double centroid[3] = {0.0, 0.0, 0.0};
+                double normal[3] = {0.0, 0.0, 0.0};
+                double area_sum = 0.0;
+                for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+                    const GLfloat* p0 = position(indices[t * 3]);
+                    const GLfloat* p1 = position(indices[t * 3 + 1]);
+                    const GLfloat* p2 = position(indices[t * 3 + 2]);
+                    double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                    double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+                    double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+                    double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    glm::vec3 face = facing(p0);
+                    for (int k = 0; k < 3; k++) {
+                        centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0 * area;
+                        normal[k] += face[k] * area;
+                    }
+                    area_sum += area;
+                }
+                double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                if (area_sum == 0.0 || length == 0.0) {
+                    sort_key[c] = 0.0f;
+                    continue;
+                }
+                double key = 0.0;
+                for (int k = 0; k < 3; k++) key += (centroid[k] / area_sum - mesh_centroid[k]) * normal[k] / length;
+                sort_key[c] = key;
+            }
+
+            std::pmr::vector<size_t> order(cluster_count, scratch);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sort_key[a] > sort_key[b]; });
+
+            std::pmr::vector<GLuint> output(scratch);
+            output.reserve(indices.size());
+            for (size_t c : order) {
+                output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+            }
+            indices.assign(output.begin(), output.end());
+        }
+
+        void OptimizeVertexFetch(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, int stride, std::pmr::memory_resource* scratch) {
+            size_t vertex_count = vertices.size() / stride;
+            std::pmr::vector<GLuint> remap(vertex_count, ~0u, scratch);
+            std::pmr::vector<GLfloat> output(scratch);
+            output.reserve(vertices.size());
+            GLuint next = 0;
+            for (GLuint& index : indices) {
+                if (remap[index] == ~0u) {
+                    remap[index] = next++;
+                    output.insert(output.end(), vertices.begin() + index * stride, vertices.begin() + (index + 1) * stride);
+                }
+                index = remap[index];
+            }
+            vertices.assign(output.begin(), output.end());
+        }
+    }  // namespace MeshOptimizer
+}  // namespace Engine
@@ -0,0 +1,52 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+// clang-format on
+
+#include <cstddef>
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory_resource>
+#include <vector>
+
+namespace Engine {
+    // Post-transform vertex cache statistics of an indexed triangle list, simulated with a FIFO cache.
+    // ACMR is transformed vertices per triangle (0.5 is the best case for a regular grid, 3 the worst),
+    // ATVR is transformed vertices per referenced vertex (1 is optimal).
+    struct CacheStats {
+        float acmr = 0.0f;
+        float atvr = 0.0f;
+        size_t vertices = 0;
+        size_t triangles = 0;
+    };
+
+    // Every function takes its temporary buffers from `scratch`, a LoadArena when called while loading. The
+    // results are copied back into the caller's vectors, which keeps their capacity for the next mesh.
+    namespace MeshOptimizer {
+        constexpr int FIFO_CACHE_SIZE = 16;
+        constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+        CacheStats AnalyzeVertexCache(const std::vector<GLuint>& indices, size_t vertex_count, int cache_size = FIFO_CACHE_SIZE,
+            std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+        // Merges bit-identical vertices so neighbouring faces can share them, otherwise there is nothing to reuse
+        void WeldVertices(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, int stride,
+            std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+        // Tom Forsyth's linear-speed vertex cache optimization
+        void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertex_count, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+        // Splits the cache-optimized triangle order into clusters and sorts them front to back with respect to
+        // their facing, so that outer geometry tends to be drawn first. `threshold` bounds how much ACMR
+        // may be sacrificed for smaller clusters. `facing` returns the outward normal of a vertex; it is not
+        // derived from the winding because the voxel mesher does not wind all faces the same way.
+        void OptimizeOverdraw(std::vector<GLuint>& indices, const std::vector<GLfloat>& vertices, int stride,
+            const std::function<glm::vec3(const GLfloat* vertex)>& facing, float threshold = OVERDRAW_THRESHOLD,
+            std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+        // Reorders vertices by first use in the index buffer so vertex fetch walks memory linearly, and drops unused ones
+        void OptimizeVertexFetch(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, int stride,
+            std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+    }  // namespace MeshOptimizer
+}  // namespace Engine
@@ -0,0 +1,61 @@
+#include "palette.hh"
+
+#include <format>
+
+namespace Engine {
+    std::string ParseColor(const std::string& text, PaletteColor& color) {
+        if ((text.size() != 7 && text.size() != 9) || text[0] != '#') return std::format("color `{}` is not #rrggbb or #rrggbbaa", text);
+        color = {0, 0, 0, 0xFF};
+        for (size_t i = 1; i < text.size(); i++) {
+            char c = text[i];
+            int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            if (digit < 0) return std::format("color `{}` is not #rrggbb or #rrggbbaa", text);
+            uint8_t& channel = color[(i - 1) / 2];
+            channel = i % 2 == 1 ? digit << 4 : channel | digit;
+        }
+        return "";
+    }
+
+    std::string FormatColor(const PaletteColor& color) { return std::format("#{:02x}{:02x}{:02x}{:02x}", color[0], color[1], color[2], color[3]); }
+
+    PaletteColors ApplyVariant(const PaletteColors& base, const PaletteVariant& variant) {
+        PaletteColors colors = base;
+        for (auto& [index, color] : variant.colors) {
+            if (index > 0 && index < 256) colors[index] = color;
+        }
+        return colors;
+    }
+
+    PaletteSet::~PaletteSet() {
+        if (!this->textures.empty()) glDeleteTextures(this->textures.size(), this->textures.data());
+    }
+
+    void PaletteSet::Upload(const PaletteColors& base, const std::vector<PaletteVariant>& variants) {
+        size_t count = variants.size() + 1;
+        if (this->textures.size() > count) {
+            glDeleteTextures(this->textures.size() - count, this->textures.data() + count);
+            this->textures.resize(count);
+        } else if (this->textures.size() < count) {
+            size_t existing = this->textures.size();
+            this->textures.resize(count);
+            glGenTextures(count - existing, this->textures.data() + existing);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            PaletteColors colors = i == 0 ? base : ApplyVariant(base, variants[i - 1]);
+            glBindTexture(GL_TEXTURE_1D, this->textures[i]);
+            glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, 256, 0, GL_RGBA, GL_UNSIGNED_BYTE, colors.data());
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAX_LEVEL, 0);
+        }
+        glBindTexture(GL_TEXTURE_1D, 0);
+    }
+
+    void PaletteSet::Bind(int index) {
+        if (index < 0 || index >= (int)this->textures.size()) index = 0;
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_1D, this->textures.empty() ? 0 : this->textures[index]);
+        glActiveTexture(GL_TEXTURE0);
+    }
+}  // namespace Engine
@@ -0,0 +1,51 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+// clang-format on
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Engine {
+    // RGBA, as the VOX RGBA chunk stores it
+    using PaletteColor = std::array<uint8_t, 4>;
+    using PaletteColors = std::array<PaletteColor, 256>;
+
+    // A named alternative palette, e.g. team colors or a damage state. Only the
+    // entries that differ from the model's palette are stored.
+    struct PaletteVariant {
+        std::string name;
+        std::map<int, PaletteColor> colors;  // Palette index 1-255 to its replacement
+    };
+
+    // "#rrggbb" or "#rrggbbaa", returns an empty string on success and otherwise what is wrong with `text`
+    std::string ParseColor(const std::string& text, PaletteColor& color);
+    // "#rrggbbaa"
+    std::string FormatColor(const PaletteColor& color);
+    PaletteColors ApplyVariant(const PaletteColors& base, const PaletteVariant& variant);
+
+    // A model's palette and its variants as one 256 texel GL_TEXTURE_1D each.
+    // Meshes only store palette indices, so switching variants is a different
+    // texture bound to TEXTURE_UNIT and never touches the vertex data.
+    class PaletteSet {
+       private:
+        std::vector<GLuint> textures;
+
+       public:
+        static constexpr int TEXTURE_UNIT = 2;
+
+        PaletteSet() = default;
+        PaletteSet(const PaletteSet&) = delete;
+        PaletteSet& operator=(const PaletteSet&) = delete;
+        ~PaletteSet();
+
+        // Texture 0 is `base`, texture i + 1 is `variants[i]` applied to it
+        void Upload(const PaletteColors& base, const std::vector<PaletteVariant>& variants);
+        void Bind(int index);
+        int Count() { return this->textures.size(); };
+    };
+}  // namespace Engine
@@ -0,0 +1,220 @@
+#include "profiler.hh"
+
+#include <algorithm>
+#include <fstream>
+
+namespace Engine {
+    Profiler::Scope::Scope(Profiler& profiler, int section) : trace(profiler.sections[section].trace_name) {
+        this->profiler = profiler.active ? &profiler : nullptr;
+        this->section = section;
+        if (this->profiler) this->profiler->begin(section);
+    }
+
+    Profiler::Scope::~Scope() {
+        if (this->profiler) this->profiler->end(this->section);
+    }
+
+    Profiler::Profiler(Utils::Logger& logger) {
+        this->logger = &logger;
+        this->frame_ms.resize(HISTORY, 0.0f);
+    }
+
+    Profiler::~Profiler() {
+        for (auto& section : this->sections) {
+            glDeleteQueries(LATENCY, section.queries);
+        }
+    }
+
+    int Profiler::Register(const std::string& name, bool gpu) {
+        Section section;
+        section.name = name;
+        section.trace_name = Utils::TraceIntern(name);
+        section.gpu = gpu;
+        section.cpu_ms.resize(HISTORY, 0.0f);
+        section.gpu_ms.resize(HISTORY, 0.0f);
+        glGenQueries(LATENCY, section.queries);
+        for (int i = 0; i < LATENCY; i++) {
+            section.query_pending[i] = false;
+            section.query_frame[i] = 0;
+        }
+        this->sections.push_back(section);
+        return this->sections.size() - 1;
+    }
+
+    void Profiler::reset() {
+        this->frame = 0;
+        this->recorded = 0;
+        std::fill(this->frame_ms.begin(), this->frame_ms.end(), 0.0f);
+        for (auto& section : this->sections) {
+            std::fill(section.cpu_ms.begin(), section.cpu_ms.end(), 0.0f);
+            std::fill(section.gpu_ms.begin(), section.gpu_ms.end(), 0.0f);
+            for (int i = 0; i < LATENCY; i++) section.query_pending[i] = false;
+        }
+    }
+
+    void Profiler::collectQueries() {
+        int set = this->frame % LATENCY;
+        for (auto& section : this->sections) {
+            if (!section.query_pending[set]) continue;
+            section.query_pending[set] = false;
+
+            // Never block: a result that is still not available after LATENCY frames is dropped
+            GLint available = 0;
+            glGetQueryObjectiv(section.queries[set], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available || this->frame - section.query_frame[set] >= HISTORY) continue;
+
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(section.queries[set], GL_QUERY_RESULT, &elapsed_ns);
+            section.gpu_ms[section.query_frame[set] % HISTORY] = elapsed_ns / 1e6f;
+        }
+    }
+
+    void Profiler::BeginFrame() {
+        if (this->enabled && !this->active) reset();
+        this->active = this->enabled;
+        if (!this->active) return;
+
+        collectQueries();
+        int slot = this->frame % HISTORY;
+        for (auto& section : this->sections) {
+            section.cpu_ms[slot] = 0.0f;
+            section.gpu_ms[slot] = 0.0f;
+        }
+        this->frame_start = std::chrono::steady_clock::now();
+    }
+
+    void Profiler::EndFrame() {
+        if (!this->active) return;
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - this->frame_start;
+        this->frame_ms[this->frame % HISTORY] = elapsed.count();
+        this->frame++;
+        this->recorded++;
+    }
+
+    void Profiler::begin(int section) {
+        Section& s = this->sections[section];
+        if (s.gpu) glBeginQuery(GL_TIME_ELAPSED, s.queries[this->frame % LATENCY]);
+        s.cpu_start = std::chrono::steady_clock::now();
+    }
+
+    void Profiler::end(int section) {
+        Section& s = this->sections[section];
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - s.cpu_start;
+        // A section may be entered several times per frame, accumulate
+        s.cpu_ms[this->frame % HISTORY] += elapsed.count();
+        if (s.gpu) {
+            int set = this->frame % LATENCY;
+            glEndQuery(GL_TIME_ELAPSED);
+            s.query_pending[set] = true;
+            s.query_frame[set] = this->frame;
+        }
+    }
+
+    void Profiler::percentiles(const std::vector<float>& history, float& p50, float& p95, float& p99) {
+        size_t count = std::min<uint64_t>(this->recorded, HISTORY);
+        if (count == 0) {
+            p50 = p95 = p99 = 0.0f;
+            return;
+        }
+        std::vector<float> sorted(history.begin(), history.begin() + count);
+        std::sort(sorted.begin(), sorted.end());
+        p50 = sorted[(count - 1) * 50 / 100];
+        p95 = sorted[(count - 1) * 95 / 100];
+        p99 = sorted[(count - 1) * 99 / 100];
+    }
+
+    void Profiler::RenderMenu() {
+        int count = std::min<uint64_t>(this->recorded, HISTORY);
+        int offset = this->recorded >= HISTORY ? this->frame % HISTORY : 0;
+        float p50, p95, p99;
+        percentiles(this->frame_ms, p50, p95, p99);
+        std::string overlay = std::format("frame p50 {:.2f} / p95 {:.2f} / p99 {:.2f} ms", p50, p95, p99);
+        ImGui::PlotLines("##frame", this->frame_ms.data(), count, offset, overlay.c_str(), 0.0f, std::max(p99 * 1.5f, 1.0f),
+            ImVec2(ImGui::GetContentRegionAvail().x, 80.0f));
+
+        if (ImGui::BeginTable("sections", 7, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("Section");
+            ImGui::TableSetupColumn("CPU p50");
+            ImGui::TableSetupColumn("CPU p95");
+            ImGui::TableSetupColumn("CPU p99");
+            ImGui::TableSetupColumn("GPU p50");
+            ImGui::TableSetupColumn("GPU p95");
+            ImGui::TableSetupColumn("GPU p99");
+            ImGui::TableHeadersRow();
+            for (auto& section : this->sections) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(section.name.c_str());
+                percentiles(section.cpu_ms, p50, p95, p99);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", p50);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", p95);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", p99);
+                if (section.gpu) {
+                    percentiles(section.gpu_ms, p50, p95, p99);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", p50);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", p95);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", p99);
+                }
+            }
+            ImGui::EndTable();
+        }
+
+        if (ImGui::Button("Dump CSV")) {
+            auto now = std::chrono::system_clock::now().time_since_epoch();
+            DumpCsv(std::format("profile_{}.csv", std::chrono::duration_cast<std::chrono::seconds>(now).count()));
+        }
+        ImGui::SameLine();
+        if (!Utils::trace_enabled.load()) {
+            if (ImGui::Button("Record trace")) Utils::TraceStart();
+        } else if (ImGui::Button("Stop and dump trace")) {
+            Utils::TraceStop();
+            auto now = std::chrono::system_clock::now().time_since_epoch();
+            DumpTrace(std::format("trace_{}.json", std::chrono::duration_cast<std::chrono::seconds>(now).count()));
+        }
+    }
+
+    bool Profiler::DumpTrace(const std::string& path) {
+        int64_t count = Utils::TraceDump(path);
+        if (count < 0) {
+            this->logger->Error("Failed to write trace to `{}`", path);
+            return false;
+        }
+        this->logger->Info("Dumped {} trace spans to `{}`, open it in chrome://tracing or ui.perfetto.dev", count, path);
+        return true;
+    }
+
+    bool Profiler::DumpCsv(const std::string& path) {
+        std::ofstream file(path);
+        if (!file) {
+            this->logger->Error("Failed to open `{}` for writing", path);
+            return false;
+        }
+
+        file << "frame,frame_cpu_ms";
+        for (auto& section : this->sections) {
+            file << "," << section.name << "_cpu_ms";
+            if (section.gpu) file << "," << section.name << "_gpu_ms";
+        }
+        file << "\n";
+
+        uint64_t count = std::min<uint64_t>(this->recorded, HISTORY);
+        for (uint64_t f = this->frame - count; f < this->frame; f++) {
+            int slot = f % HISTORY;
+            file << f << "," << this->frame_ms[slot];
+            for (auto& section : this->sections) {
+                file << "," << section.cpu_ms[slot];
+                if (section.gpu) file << "," << section.gpu_ms[slot];
+            }
+            file << "\n";
+        }
+        file.close();
+        this->logger->Info("Dumped {} profiled frames to `{}`", count, path);
+        return true;
+    }
+}  // namespace Engine
@@ -0,0 +1,78 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+// clang-format on
+#include <imgui.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../utils/logger.hh"
+#include "../utils/trace.hh"
+
+namespace Engine {
+    // Frame profiler with CPU timers and GL_TIME_ELAPSED queries per section.
+    // GPU results are read back LATENCY frames later so the CPU never waits on
+    // the GPU. While the profiler is inactive every call returns after one branch.
+    // GL timer queries cannot nest, so sections timed on the GPU must not overlap.
+    // Every section scope is also a trace span, independently of the profiler being active.
+    class Profiler {
+       public:
+        static constexpr int HISTORY = 512;  // Frames kept for the graph, percentiles and the CSV dump
+        static constexpr int LATENCY = 2;    // Query sets in flight
+
+        class Scope {
+           private:
+            Profiler* profiler;
+            int section;
+            Utils::TraceScope trace;
+
+           public:
+            Scope(Profiler& profiler, int section);
+            ~Scope();
+        };
+
+       private:
+        struct Section {
+            std::string name;
+            const char* trace_name;
+            bool gpu;
+            std::vector<float> cpu_ms;
+            std::vector<float> gpu_ms;
+            std::chrono::steady_clock::time_point cpu_start;
+            GLuint queries[LATENCY];
+            bool query_pending[LATENCY];
+            uint64_t query_frame[LATENCY];
+        };
+
+        Utils::Logger* logger;
+        std::vector<Section> sections;
+        std::vector<float> frame_ms;
+        std::chrono::steady_clock::time_point frame_start;
+        uint64_t frame = 0;
+        uint64_t recorded = 0;  // Frames recorded since the profiler was last enabled
+        bool active = false;     // Latched from `enabled` at the start of each frame
+
+        void begin(int section);
+        void end(int section);
+        void collectQueries();
+        void reset();
+        void percentiles(const std::vector<float>& history, float& p50, float& p95, float& p99);
+
+       public:
+        bool enabled = false;  // Toggled by the UI, takes effect on the next frame
+
+        Profiler(Utils::Logger& logger);
+        ~Profiler();
+
+        int Register(const std::string& name, bool gpu);
+        void BeginFrame();
+        void EndFrame();
+        void RenderMenu();
+        bool DumpCsv(const std::string& path);
+        bool DumpTrace(const std::string& path);
+    };
+}  // namespace Engine
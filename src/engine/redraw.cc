@@ -0,0 +1,43 @@
+#include "redraw.hh"
+
+#include <algorithm>
+
+namespace Engine {
+    void Redraw::requestFromWindow(GLFWwindow* window) {
+        Redraw* redraw = static_cast<Redraw*>(glfwGetWindowUserPointer(window));
+        if (redraw) redraw->Request();
+    }
+
+    void Redraw::InstallCallbacks(GLFWwindow* window) {
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, [](GLFWwindow* window, int, int, int, int) { requestFromWindow(window); });
+        glfwSetCharCallback(window, [](GLFWwindow* window, unsigned int) { requestFromWindow(window); });
+        glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int, int, int) { requestFromWindow(window); });
+        glfwSetCursorPosCallback(window, [](GLFWwindow* window, double, double) { requestFromWindow(window); });
+        glfwSetCursorEnterCallback(window, [](GLFWwindow* window, int) { requestFromWindow(window); });
+        glfwSetScrollCallback(window, [](GLFWwindow* window, double, double) { requestFromWindow(window); });
+        glfwSetWindowFocusCallback(window, [](GLFWwindow* window, int) { requestFromWindow(window); });
+        glfwSetWindowSizeCallback(window, [](GLFWwindow* window, int, int) { requestFromWindow(window); });
+        glfwSetWindowRefreshCallback(window, [](GLFWwindow* window) { requestFromWindow(window); });
+        glfwSetDropCallback(window, [](GLFWwindow* window, int, const char**) { requestFromWindow(window); });
+    }
+
+    void Redraw::Request(int frames) { frames_left = std::max(frames_left, frames); }
+
+    void Redraw::WaitEvents() {
+        timed_out = false;
+        if (!on_demand || frames_left > 0) {
+            glfwPollEvents();
+            return;
+        }
+        glfwWaitEventsTimeout(idle_timeout);
+        // No callback asked for a frame, so the wait ran out (or an event nobody cares about arrived)
+        timed_out = frames_left == 0;
+    }
+
+    bool Redraw::ShouldDraw() { return !on_demand || frames_left > 0; }
+
+    void Redraw::FrameDrawn() {
+        if (frames_left > 0) frames_left--;
+    }
+}  // namespace Engine
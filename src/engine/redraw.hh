@@ -0,0 +1,37 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+namespace Engine {
+    // Decides whether the main loop has to produce a frame. In on-demand mode
+    // the loop blocks in glfwWaitEventsTimeout until something asks for a
+    // redraw (input, camera movement, entity edits, loads, log lines), and
+    // then draws a few extra frames so ImGui hover and fade animations settle.
+    class Redraw {
+       private:
+        int frames_left;
+        bool timed_out = false;
+
+        static void requestFromWindow(GLFWwindow* window);
+
+       public:
+        bool on_demand = true;
+        int settle_frames = 3;
+        double idle_timeout = 0.5;  // Seconds between wake-ups while idle
+
+        Redraw() { frames_left = settle_frames; };
+
+        // Must run before ImGui installs its callbacks so that ImGui chains to these
+        void InstallCallbacks(GLFWwindow* window);
+
+        void Request() { Request(settle_frames); };
+        void Request(int frames);
+        void WaitEvents();
+        bool ShouldDraw();
+        void FrameDrawn();
+        bool TimedOut() { return timed_out; };
+    };
+}  // namespace Engine
@@ -0,0 +1,215 @@
+#include "render_queue.hh"
+
+#include <cstring>
+
+namespace Engine {
+    // Key layout, most significant first: layer (4) | program (12) | vao (12) | uniform hash (16) | sequence (20).
+    // Sorting on it groups draws by program, then VAO, then identical uniform sets, and keeps submission order otherwise.
+    uint64_t RenderQueue::sortKey(const DrawItem& item, uint8_t layer, uint32_t sequence) {
+        uint64_t key = 0;
+        key |= (uint64_t)(layer & 0xF) << 60;
+        key |= (uint64_t)(item.program & 0xFFF) << 48;
+        key |= (uint64_t)(item.vao & 0xFFF) << 36;
+        key |= (uint64_t)(uniformHash(item) & 0xFFFF) << 20;
+        key |= (uint64_t)(sequence & 0xFFFFF);
+        return key;
+    }
+
+    uint32_t RenderQueue::uniformHash(const DrawItem& item) {
+        // FNV-1a over the uniform values
+        uint32_t hash = 2166136261u;
+        for (uint32_t i = item.uniform_first; i < item.uniform_first + item.uniform_count; i++) {
+            const UniformValue& uniform = this->uniforms[i];
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(uniform.data);
+            hash = (hash ^ (uint32_t)uniform.location) * 16777619u;
+            for (size_t b = 0; b < sizeof(uniform.data); b++) {
+                hash = (hash ^ bytes[b]) * 16777619u;
+            }
+        }
+        return hash ^ (hash >> 16);
+    }
+
+    bool RenderQueue::sameUniforms(const DrawItem& a, const DrawItem& b) {
+        if (a.uniform_count != b.uniform_count) return false;
+        for (uint32_t i = 0; i < a.uniform_count; i++) {
+            const UniformValue& ua = this->uniforms[a.uniform_first + i];
+            const UniformValue& ub = this->uniforms[b.uniform_first + i];
+            if (ua.location != ub.location || ua.type != ub.type || std::memcmp(ua.data, ub.data, sizeof(ua.data)) != 0) return false;
+        }
+        return true;
+    }
+
+    bool RenderQueue::canMerge(const DrawItem& a, const DrawItem& b) {
+        return a.program == b.program && a.vao == b.vao && a.mode == b.mode && a.instances == 1 && b.instances == 1 && sameUniforms(a, b);
+    }
+
+    void RenderQueue::radixSort() {
+        size_t n = this->keys.size();
+        this->order.resize(n);
+        this->order_scratch.resize(n);
+        this->keys_scratch.resize(n);
+        for (size_t i = 0; i < n; i++) this->order[i] = i;
+
+        // LSD radix sort on 8-bit digits, passes where every key has the same digit are skipped
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t histogram[256] = {0};
+            for (size_t i = 0; i < n; i++) histogram[(this->keys[i] >> shift) & 0xFF]++;
+            if (n == 0 || histogram[(this->keys[0] >> shift) & 0xFF] == n) continue;
+
+            size_t offset = 0;
+            for (int d = 0; d < 256; d++) {
+                size_t c = histogram[d];
+                histogram[d] = offset;
+                offset += c;
+            }
+            for (size_t i = 0; i < n; i++) {
+                size_t dst = histogram[(this->keys[i] >> shift) & 0xFF]++;
+                this->keys_scratch[dst] = this->keys[i];
+                this->order_scratch[dst] = this->order[i];
+            }
+            this->keys.swap(this->keys_scratch);
+            this->order.swap(this->order_scratch);
+        }
+    }
+
+    void RenderQueue::applyUniforms(const DrawItem& item) {
+        for (uint32_t i = item.uniform_first; i < item.uniform_first + item.uniform_count; i++) {
+            const UniformValue& uniform = this->uniforms[i];
+            if (uniform.location < 0) continue;
+
+            uint64_t cache_key = ((uint64_t)item.program << 32) | (uint32_t)uniform.location;
+            auto cached = this->uploaded.find(cache_key);
+            if (cached != this->uploaded.end() && cached->second.type == uniform.type &&
+                std::memcmp(cached->second.data, uniform.data, sizeof(uniform.data)) == 0) {
+                this->stats.uniform_skips++;
+                continue;
+            }
+
+            switch (uniform.type) {
+                case UniformType::INT:
+                    glUniform1i(uniform.location, (GLint)uniform.data[0]);
+                    break;
+                case UniformType::FLOAT:
+                    glUniform1f(uniform.location, uniform.data[0]);
+                    break;
+                case UniformType::VEC3:
+                    glUniform3fv(uniform.location, 1, uniform.data);
+                    break;
+                case UniformType::VEC4:
+                    glUniform4fv(uniform.location, 1, uniform.data);
+                    break;
+                case UniformType::MAT4:
+                    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, uniform.data);
+                    break;
+            }
+            this->uploaded[cache_key] = uniform;
+            this->stats.uniform_uploads++;
+        }
+    }
+
+    void RenderQueue::pushUniform(GLint location, UniformType type, const GLfloat* data, int length) {
+        if (this->items.empty()) return;
+        UniformValue uniform;
+        std::memset(&uniform, 0, sizeof(uniform));
+        uniform.location = location;
+        uniform.type = type;
+        std::memcpy(uniform.data, data, length * sizeof(GLfloat));
+        this->uniforms.push_back(uniform);
+        this->items.back().uniform_count++;
+    }
+
+    void RenderQueue::Submit(Engine::Shader& shader, Engine::VAO& vao, GLsizei count, GLintptr first, GLint base_vertex, GLsizei instances, uint8_t layer) {
+        DrawItem item;
+        item.program = shader.id;
+        item.vao = vao.id;
+        item.mode = GL_TRIANGLES;
+        item.count = count;
+        item.first = first;
+        item.base_vertex = base_vertex;
+        item.instances = instances;
+        item.uniform_first = this->uniforms.size();
+        item.uniform_count = 0;
+        this->items.push_back(item);
+        // The key is finalized in Flush once all uniforms of the item are known, stash the layer for now
+        this->keys.push_back((uint64_t)layer);
+    }
+
+    void RenderQueue::Uniform(GLint location, int value) {
+        GLfloat data = (GLfloat)value;
+        pushUniform(location, UniformType::INT, &data, 1);
+    }
+
+    void RenderQueue::Uniform(GLint location, float value) { pushUniform(location, UniformType::FLOAT, &value, 1); }
+
+    void RenderQueue::Uniform(GLint location, const glm::vec3& value) { pushUniform(location, UniformType::VEC3, glm::value_ptr(value), 3); }
+
+    void RenderQueue::Uniform(GLint location, const glm::vec4& value) { pushUniform(location, UniformType::VEC4, glm::value_ptr(value), 4); }
+
+    void RenderQueue::Uniform(GLint location, const glm::mat4& value) { pushUniform(location, UniformType::MAT4, glm::value_ptr(value), 16); }
+
+    void RenderQueue::Flush() {
+        this->stats = Stats();
+        this->stats.items = this->items.size();
+
+        for (size_t i = 0; i < this->items.size(); i++) {
+            this->keys[i] = sortKey(this->items[i], (uint8_t)this->keys[i], i);
+        }
+        radixSort();
+
+        GLuint bound_program = 0;
+        GLuint bound_vao = 0;
+        size_t i = 0;
+        while (i < this->order.size()) {
+            const DrawItem& item = this->items[this->order[i]];
+            if (item.program != bound_program) {
+                glUseProgram(item.program);
+                bound_program = item.program;
+                this->stats.program_binds++;
+            }
+            if (item.vao != bound_vao) {
+                glBindVertexArray(item.vao);
+                bound_vao = item.vao;
+                this->stats.vao_binds++;
+            }
+            applyUniforms(item);
+
+            size_t end = i + 1;
+            while (end < this->order.size() && canMerge(item, this->items[this->order[end]])) end++;
+
+            if (item.instances != 1) {
+                glDrawElementsInstancedBaseVertex(item.mode, item.count, GL_UNSIGNED_INT, (const void*)item.first, item.instances, item.base_vertex);
+            } else if (end - i == 1) {
+                if (item.base_vertex != 0) {
+                    glDrawElementsBaseVertex(item.mode, item.count, GL_UNSIGNED_INT, (const void*)item.first, item.base_vertex);
+                } else {
+                    glDrawElements(item.mode, item.count, GL_UNSIGNED_INT, (const void*)item.first);
+                }
+            } else {
+                this->multi_counts.clear();
+                this->multi_offsets.clear();
+                this->multi_base_vertices.clear();
+                bool any_base_vertex = false;
+                for (size_t j = i; j < end; j++) {
+                    const DrawItem& merged = this->items[this->order[j]];
+                    this->multi_counts.push_back(merged.count);
+                    this->multi_offsets.push_back((const void*)merged.first);
+                    this->multi_base_vertices.push_back(merged.base_vertex);
+                    any_base_vertex |= merged.base_vertex != 0;
+                }
+                if (any_base_vertex) {
+                    glMultiDrawElementsBaseVertex(item.mode, this->multi_counts.data(), GL_UNSIGNED_INT, this->multi_offsets.data(), end - i,
+                        this->multi_base_vertices.data());
+                } else {
+                    glMultiDrawElements(item.mode, this->multi_counts.data(), GL_UNSIGNED_INT, this->multi_offsets.data(), end - i);
+                }
+            }
+            this->stats.draw_calls++;
+            i = end;
+        }
+        glBindVertexArray(0);
+
+        this->items.clear();
+        this->uniforms.clear();
+        this->keys.clear();
+    }
+}  // namespace Engine
@@ -0,0 +1,93 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+// clang-format on
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "VAO.hh"
+#include "shader.hh"
+
+namespace Engine {
+    enum class UniformType : uint8_t { INT, FLOAT, VEC3, VEC4, MAT4 };
+
+    struct UniformValue {
+        GLint location;
+        UniformType type;
+        GLfloat data[16];
+    };
+
+    struct DrawItem {
+        GLuint program;
+        GLuint vao;
+        GLenum mode;
+        GLsizei count;
+        GLintptr first;  // Byte offset into the element buffer
+        GLint base_vertex;
+        GLsizei instances;
+        uint32_t uniform_first;
+        uint32_t uniform_count;
+    };
+
+    // Collects the draws of a frame, sorts them by a 64-bit key so that items
+    // sharing a program and VAO end up next to each other, and replays them
+    // with as few state changes as possible. Consecutive non-instanced items
+    // with the same program, VAO and uniforms are merged into one multi-draw.
+    class RenderQueue {
+       public:
+        struct Stats {
+            int items = 0;
+            int draw_calls = 0;
+            int program_binds = 0;
+            int vao_binds = 0;
+            int uniform_uploads = 0;
+            int uniform_skips = 0;
+
+            int StateChanges() { return program_binds + vao_binds + uniform_uploads; };
+        };
+
+       private:
+        std::vector<DrawItem> items;
+        std::vector<UniformValue> uniforms;
+        std::vector<uint64_t> keys;
+        std::vector<uint64_t> keys_scratch;
+        std::vector<uint32_t> order;
+        std::vector<uint32_t> order_scratch;
+        // Last value uploaded per (program, location), uniforms persist in the program object between frames
+        std::unordered_map<uint64_t, UniformValue> uploaded;
+
+        std::vector<GLsizei> multi_counts;
+        std::vector<const void*> multi_offsets;
+        std::vector<GLint> multi_base_vertices;
+
+        uint64_t sortKey(const DrawItem& item, uint8_t layer, uint32_t sequence);
+        uint32_t uniformHash(const DrawItem& item);
+        bool sameUniforms(const DrawItem& a, const DrawItem& b);
+        bool canMerge(const DrawItem& a, const DrawItem& b);
+        void radixSort();
+        void applyUniforms(const DrawItem& item);
+        void pushUniform(GLint location, UniformType type, const GLfloat* data, int length);
+
+       public:
+        Stats stats;
+
+        RenderQueue(){};
+
+        void Submit(Engine::Shader& shader, Engine::VAO& vao, GLsizei count, GLintptr first = 0, GLint base_vertex = 0, GLsizei instances = 1,
+            uint8_t layer = 0);
+
+        // Per-draw uniforms, attached to the most recently submitted item
+        void Uniform(GLint location, int value);
+        void Uniform(GLint location, float value);
+        void Uniform(GLint location, const glm::vec3& value);
+        void Uniform(GLint location, const glm::vec4& value);
+        void Uniform(GLint location, const glm::mat4& value);
+
+        void Flush();
+    };
+}  // namespace Engine
@@ -12,7 +12,7 @@ namespace Engine {
             in.close();
             return contents;
         }
-        logger->Info(std::format("Failed to read shader file ~{}~", filename));
+        logger->Info("Failed to read shader file ~{}~", filename);
         return "";
     }
 
@@ -29,7 +29,7 @@ namespace Engine {
         if (!success) {
             char infoLog[512];
             glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-            this->logger->Error(std::format("Failed to compile vertex shader:\n{}", infoLog));
+            this->logger->Error("Failed to compile vertex shader:\n{}", infoLog);
         }
 
         // Create the fragment shader
@@ -42,7 +42,7 @@ namespace Engine {
         if (!success) {
             char infoLog[512];
             glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-            this->logger->Error(std::format("Failed to compile fragment shader:\n{}", infoLog));
+            this->logger->Error("Failed to compile fragment shader:\n{}", infoLog);
         }
 
         // Create the shader program
@@ -60,5 +60,13 @@ namespace Engine {
 
     void Shader::Activate() { glUseProgram(id); }
 
+    GLint Shader::Uniform(const std::string& name) {
+        auto it = uniform_locations.find(name);
+        if (it != uniform_locations.end()) return it->second;
+        GLint location = glGetUniformLocation(id, name.c_str());
+        uniform_locations[name] = location;
+        return location;
+    }
+
     Shader::~Shader() { glDeleteProgram(id); }
 }  // namespace Engine
@@ -8,6 +8,8 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <unordered_map>
 
 #include "../utils/logger.hh"
 
@@ -17,6 +19,7 @@ namespace Engine {
     class Shader {
        private:
         Utils::Logger* logger;
+        std::unordered_map<std::string, GLint> uniform_locations;
 
        public:
         GLuint id;
@@ -25,5 +28,6 @@ namespace Engine {
         ~Shader();
 
         void Activate();
+        GLint Uniform(const std::string& name);
     };
 }  // namespace Engine
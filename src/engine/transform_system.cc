@@ -0,0 +1,149 @@
+#include "transform_system.hh"
+
+#include <algorithm>
+
+#include "../utils/trace.hh"
+
+namespace Engine {
+    namespace {
+        // The unique rotations as floats, column major like glm, so the update loop does no conversions
+        struct FloatRotations {
+            float columns[QuarterTurns::UNIQUE][9];
+        };
+
+        constexpr FloatRotations buildFloatRotations() {
+            FloatRotations rotations{};
+            for (int i = 0; i < QuarterTurns::UNIQUE; i++) {
+                for (int row = 0; row < 3; row++) {
+                    for (int column = 0; column < 3; column++) rotations.columns[i][column * 3 + row] = QuarterTurns::TABLE.matrices[i][row * 3 + column];
+                }
+            }
+            return rotations;
+        }
+
+        constexpr FloatRotations FLOAT_ROTATIONS = buildFloatRotations();
+
+        // Above this share of dirty entities one pass over everything beats visiting them one by one
+        constexpr size_t FULL_UPDATE_DIVISOR = 4;
+    }  // namespace
+
+    glm::mat4 TransformSystem::Compose(glm::vec3 position, glm::vec3 offset, uint8_t rotation) {
+        const float* r = FLOAT_ROTATIONS.columns[QuarterTurns::TABLE.index[rotation & (QuarterTurns::CODES - 1)]];
+        glm::mat4 model;
+        model[0] = glm::vec4(r[0], r[1], r[2], 0.0f);
+        model[1] = glm::vec4(r[3], r[4], r[5], 0.0f);
+        model[2] = glm::vec4(r[6], r[7], r[8], 0.0f);
+        model[3] = glm::vec4(position + glm::vec3(model[0]) * offset.x + glm::vec3(model[1]) * offset.y + glm::vec3(model[2]) * offset.z, 1.0f);
+        return model;
+    }
+
+    uint32_t TransformSystem::Add(glm::vec3 position, glm::vec3 offset, uint8_t rotation) {
+        uint32_t index = this->rotation.size();
+        this->position_x.push_back(position.x);
+        this->position_y.push_back(position.y);
+        this->position_z.push_back(position.z);
+        this->offset_x.push_back(offset.x);
+        this->offset_y.push_back(offset.y);
+        this->offset_z.push_back(offset.z);
+        this->rotation.push_back(rotation & (QuarterTurns::CODES - 1));
+        this->world.emplace_back(1.0f);
+        this->is_dirty.push_back(0);
+        markDirty(index);
+        return index;
+    }
+
+    void TransformSystem::Clear() {
+        for (auto* column : {&this->position_x, &this->position_y, &this->position_z, &this->offset_x, &this->offset_y, &this->offset_z}) column->clear();
+        this->rotation.clear();
+        this->world.clear();
+        this->is_dirty.clear();
+        this->dirty.clear();
+    }
+
+    void TransformSystem::Reserve(size_t count) {
+        for (auto* column : {&this->position_x, &this->position_y, &this->position_z, &this->offset_x, &this->offset_y, &this->offset_z}) column->reserve(count);
+        this->rotation.reserve(count);
+        this->world.reserve(count);
+        this->is_dirty.reserve(count);
+    }
+
+    void TransformSystem::markDirty(uint32_t index) {
+        if (this->is_dirty[index]) return;
+        this->is_dirty[index] = 1;
+        this->dirty.push_back(index);
+    }
+
+    void TransformSystem::SetPosition(uint32_t index, glm::vec3 position) {
+        this->position_x[index] = position.x;
+        this->position_y[index] = position.y;
+        this->position_z[index] = position.z;
+        markDirty(index);
+    }
+
+    void TransformSystem::SetOffset(uint32_t index, glm::vec3 offset) {
+        this->offset_x[index] = offset.x;
+        this->offset_y[index] = offset.y;
+        this->offset_z[index] = offset.z;
+        markDirty(index);
+    }
+
+    void TransformSystem::SetRotation(uint32_t index, uint8_t rotation) {
+        this->rotation[index] = rotation & (QuarterTurns::CODES - 1);
+        markDirty(index);
+    }
+
+    // Branch free over separate arrays, so the compiler is free to vectorize it
+    void TransformSystem::updateRange(size_t begin, size_t end) {
+        const float* px = this->position_x.data();
+        const float* py = this->position_y.data();
+        const float* pz = this->position_z.data();
+        const float* ox = this->offset_x.data();
+        const float* oy = this->offset_y.data();
+        const float* oz = this->offset_z.data();
+        const uint8_t* codes = this->rotation.data();
+        float* out = reinterpret_cast<float*>(this->world.data());
+        for (size_t i = begin; i < end; i++) {
+            const float* r = FLOAT_ROTATIONS.columns[QuarterTurns::TABLE.index[codes[i]]];
+            float* m = out + i * 16;
+            m[0] = r[0];
+            m[1] = r[1];
+            m[2] = r[2];
+            m[3] = 0.0f;
+            m[4] = r[3];
+            m[5] = r[4];
+            m[6] = r[5];
+            m[7] = 0.0f;
+            m[8] = r[6];
+            m[9] = r[7];
+            m[10] = r[8];
+            m[11] = 0.0f;
+            m[12] = px[i] + r[0] * ox[i] + r[3] * oy[i] + r[6] * oz[i];
+            m[13] = py[i] + r[1] * ox[i] + r[4] * oy[i] + r[7] * oz[i];
+            m[14] = pz[i] + r[2] * ox[i] + r[5] * oy[i] + r[8] * oz[i];
+            m[15] = 1.0f;
+        }
+    }
+
+    std::pair<size_t, size_t> TransformSystem::Update() {
+        TRACE_SCOPE("Update transforms");
+        if (this->dirty.empty()) return {0, 0};
+        size_t first, last;
+        if (this->dirty.size() >= this->Size() / FULL_UPDATE_DIVISOR) {
+            first = 0;
+            last = this->Size();
+            updateRange(first, last);
+            std::fill(this->is_dirty.begin(), this->is_dirty.end(), 0);
+        } else {
+            first = this->Size();
+            last = 0;
+            for (uint32_t index : this->dirty) {
+                updateRange(index, index + 1);
+                this->is_dirty[index] = 0;
+                first = std::min<size_t>(first, index);
+                last = std::max<size_t>(last, index + 1);
+            }
+        }
+        this->dirty.clear();
+        return {first, last};
+    }
+}  // namespace Engine
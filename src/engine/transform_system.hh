@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Engine {
+    // Entity rotations are whole quarter turns per axis, packed as x | y << 2 | z << 4.
+    // The 64 codes only produce 24 distinct rotations, which are worked out at compile time.
+    namespace QuarterTurns {
+        constexpr int CODES = 64;
+        constexpr int UNIQUE = 24;
+
+        // Row major, every element -1, 0 or 1
+        using Matrix = std::array<int8_t, 9>;
+
+        struct Table {
+            std::array<Matrix, UNIQUE> matrices{};
+            std::array<uint8_t, CODES> index{};  // Code to its entry in matrices
+            int unique = 0;
+        };
+
+        constexpr Matrix Multiply(const Matrix& a, const Matrix& b) {
+            Matrix result{};
+            for (int row = 0; row < 3; row++) {
+                for (int column = 0; column < 3; column++) {
+                    int sum = 0;
+                    for (int k = 0; k < 3; k++) sum += a[row * 3 + k] * b[k * 3 + column];
+                    result[row * 3 + column] = sum;
+                }
+            }
+            return result;
+        }
+
+        // `turns` quarter turns counterclockwise about `axis`, as glm::rotate builds them
+        constexpr Matrix AxisRotation(int axis, int turns) {
+            constexpr int8_t COS[4] = {1, 0, -1, 0};
+            constexpr int8_t SIN[4] = {0, 1, 0, -1};
+            int8_t c = COS[turns & 3], s = SIN[turns & 3];
+            switch (axis) {
+                case 0: return Matrix{1, 0, 0, 0, c, (int8_t)-s, 0, s, c};
+                case 1: return Matrix{c, 0, s, 0, 1, 0, (int8_t)-s, 0, c};
+                default: return Matrix{c, (int8_t)-s, 0, s, c, 0, 0, 0, 1};
+            }
+        }
+
+        constexpr Table BuildTable() {
+            Table table;
+            for (int code = 0; code < CODES; code++) {
+                // Z after Y after X, the order EntityBase has always applied them in
+                Matrix matrix = Multiply(AxisRotation(2, code >> 4), Multiply(AxisRotation(1, code >> 2), AxisRotation(0, code)));
+                int found = 0;
+                while (found < table.unique && table.matrices[found] != matrix) found++;
+                if (found == table.unique) table.matrices[table.unique++] = matrix;
+                table.index[code] = found;
+            }
+            return table;
+        }
+
+        inline constexpr Table TABLE = BuildTable();
+        static_assert(TABLE.unique == UNIQUE, "quarter turns about three axes form the 24 rotations of a cube");
+
+        // Wraps each component into 0-3
+        constexpr uint8_t Code(int x, int y, int z) { return (x & 3) | (y & 3) << 2 | (z & 3) << 4; }
+        inline uint8_t Code(glm::vec3 turns) { return Code((int)turns.x, (int)turns.y, (int)turns.z); }
+        inline const Matrix& Rotation(uint8_t code) { return TABLE.matrices[TABLE.index[code & (CODES - 1)]]; }
+    }  // namespace QuarterTurns
+
+    // Positions, pivot offsets and quarter-turn rotations of many entities in
+    // structure of arrays form, and their world matrices, which Update only
+    // recomputes for entities that changed. The matrices are contiguous so they
+    // can be uploaded as instance data as they are.
+    class TransformSystem {
+       private:
+        std::vector<float> position_x, position_y, position_z;
+        std::vector<float> offset_x, offset_y, offset_z;
+        std::vector<uint8_t> rotation;
+        std::vector<glm::mat4> world;
+
+        std::vector<uint8_t> is_dirty;
+        std::vector<uint32_t> dirty;
+
+        void markDirty(uint32_t index);
+        void updateRange(size_t begin, size_t end);
+
+       public:
+        // The world matrix of one entity: translated to `position` plus the rotated `offset`, then rotated
+        static glm::mat4 Compose(glm::vec3 position, glm::vec3 offset, uint8_t rotation);
+
+        uint32_t Add(glm::vec3 position, glm::vec3 offset = glm::vec3(0.0f), uint8_t rotation = 0);
+        void Clear();
+        void Reserve(size_t count);
+        size_t Size() { return this->rotation.size(); };
+
+        void SetPosition(uint32_t index, glm::vec3 position);
+        void SetOffset(uint32_t index, glm::vec3 offset);
+        void SetRotation(uint32_t index, uint8_t rotation);
+
+        // Brings the world matrices up to date, returns the [first, last) range of those that changed
+        std::pair<size_t, size_t> Update();
+        const std::vector<glm::mat4>& World() { return this->world; };
+    };
+}  // namespace Engine
@@ -0,0 +1,391 @@
+#include "vox_metadata.hh"
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <sstream>
+
+#include "../utils/atomic_file.hh"
+#include "../utils/trace.hh"
+
+namespace Engine {
+    namespace {
+        int32_t readInt(std::ifstream& file) {
+            unsigned char bytes[4] = {0, 0, 0, 0};
+            file.read(reinterpret_cast<char*>(bytes), 4);
+            return (int32_t)(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24));
+        }
+
+        std::string readId(std::ifstream& file) {
+            std::string id(4, '\0');
+            file.read(id.data(), 4);
+            return id;
+        }
+
+        // Positions `file` at the first child of MAIN and returns the offset one past the last one, or -1 if this is not a VOX file
+        int64_t openMain(std::ifstream& file, int& version) {
+            if (readId(file) != "VOX ") return -1;
+            version = readInt(file);
+            if (readId(file) != "MAIN") return -1;
+            int32_t content = readInt(file);
+            int32_t children = readInt(file);
+            if (!file || content < 0 || children < 0) return -1;
+            file.seekg(content, std::ios::cur);
+            return (int64_t)file.tellg() + children;
+        }
+
+        struct ChunkHeader {
+            std::string id;
+            int32_t content;
+            int32_t children;
+            int64_t next;  // Offset of the following chunk
+        };
+
+        bool nextChunk(std::ifstream& file, int64_t end, ChunkHeader& chunk) {
+            if ((int64_t)file.tellg() + 12 > end) return false;
+            chunk.id = readId(file);
+            chunk.content = readInt(file);
+            chunk.children = readInt(file);
+            if (!file || chunk.content < 0 || chunk.children < 0) return false;
+            chunk.next = (int64_t)file.tellg() + chunk.content + chunk.children;
+            return chunk.next <= end;
+        }
+
+        bool validSize(glm::ivec3 size) { return size.x > 0 && size.y > 0 && size.z > 0; }
+
+        void renderThumbnail(VoxMetadata& metadata, const std::vector<uint8_t>& voxels, const uint8_t palette[256][4]) {
+            constexpr int T = VoxMetadata::THUMBNAIL_SIZE;
+            glm::ivec3 size = metadata.size;
+            float scale = (float)T / std::max(size.x, size.y);
+            float offset_x = (T - size.x * scale) / 2.0f;
+            float offset_y = (T - size.y * scale) / 2.0f;
+
+            // Highest voxel per pixel, looking down the z axis which is up in MagicaVoxel
+            std::array<int, T * T> top;
+            std::array<uint8_t, T * T> color{};
+            top.fill(-1);
+            for (size_t i = 0; i + 3 < voxels.size(); i += 4) {
+                int x = voxels[i], y = voxels[i + 1], z = voxels[i + 2];
+                if (x >= size.x || y >= size.y || z >= size.z) continue;
+                int px0 = std::clamp((int)(offset_x + x * scale), 0, T - 1);
+                int px1 = std::clamp((int)(offset_x + (x + 1) * scale), px0 + 1, T);
+                int py0 = std::clamp((int)(offset_y + (size.y - 1 - y) * scale), 0, T - 1);
+                int py1 = std::clamp((int)(offset_y + (size.y - y) * scale), py0 + 1, T);
+                for (int py = py0; py < py1; py++) {
+                    for (int px = px0; px < px1; px++) {
+                        if (z > top[py * T + px]) {
+                            top[py * T + px] = z;
+                            color[py * T + px] = voxels[i + 3];
+                        }
+                    }
+                }
+            }
+
+            for (int p = 0; p < T * T; p++) {
+                GLubyte* out = &metadata.thumbnail[p * 4];
+                if (top[p] < 0) {
+                    out[0] = out[1] = out[2] = out[3] = 0;
+                    continue;
+                }
+                // Darken lower surfaces so the shape reads without lighting
+                float shade = 0.55f + 0.45f * (top[p] + 1) / size.z;
+                for (int c = 0; c < 3; c++) out[c] = (GLubyte)(palette[color[p]][c] * shade);
+                out[3] = 255;
+            }
+        }
+    }  // namespace
+
+    bool PeekVoxHeader(const std::string& path, VoxMetadata& metadata) {
+        TRACE_SCOPE("Peek VOX header");
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        int64_t end = openMain(file, metadata.version);
+        if (end < 0) return false;
+
+        bool has_size = false;
+        ChunkHeader chunk;
+        while (nextChunk(file, end, chunk)) {
+            if (chunk.id == "SIZE" && !has_size) {
+                metadata.size.x = readInt(file);
+                metadata.size.y = readInt(file);
+                metadata.size.z = readInt(file);
+                has_size = true;
+            } else if (chunk.id == "XYZI") {
+                metadata.voxel_count = readInt(file);
+                return file && has_size && metadata.voxel_count >= 0 && validSize(metadata.size);
+            }
+            file.seekg(chunk.next);
+        }
+        return false;
+    }
+
+    bool ScanVoxContent(const std::string& path, VoxMetadata& metadata) {
+        TRACE_SCOPE("Scan VOX content");
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        int64_t end = openMain(file, metadata.version);
+        if (end < 0) return false;
+
+        bool has_size = false, has_voxels = false;
+        std::vector<uint8_t> voxels;
+        uint8_t palette[256][4];
+        std::fill(&palette[0][0], &palette[0][0] + 256 * 4, 200);
+        ChunkHeader chunk;
+        while (nextChunk(file, end, chunk)) {
+            if (chunk.id == "SIZE" && !has_size) {
+                metadata.size.x = readInt(file);
+                metadata.size.y = readInt(file);
+                metadata.size.z = readInt(file);
+                has_size = true;
+            } else if (chunk.id == "XYZI" && !has_voxels) {
+                int32_t count = readInt(file);
+                if (count < 0 || (int64_t)count * 4 > chunk.content - 4) return false;
+                metadata.voxel_count = count;
+                voxels.resize((size_t)count * 4);
+                file.read(reinterpret_cast<char*>(voxels.data()), voxels.size());
+                has_voxels = true;
+            } else if (chunk.id == "RGBA" && chunk.content == 1024) {
+                file.read(reinterpret_cast<char*>(palette), 1024);
+            }
+            if (!file) return false;
+            file.seekg(chunk.next);
+        }
+        if (!has_size || !has_voxels || !validSize(metadata.size)) return false;
+
+        std::bitset<256> used;
+        for (size_t i = 3; i < voxels.size(); i += 4) used.set(voxels[i]);
+        metadata.palette_used = used.count();
+        renderThumbnail(metadata, voxels, palette);
+        return true;
+    }
+
+    VoxMetadataCache::VoxMetadataCache(Utils::Logger& logger, const std::string& index_path, int threads) {
+        this->logger = &logger;
+        this->index_path = index_path;
+        loadIndex();
+
+        if (threads <= 0) threads = std::clamp((int)std::thread::hardware_concurrency() / 2, 1, 4);
+        for (int i = 0; i < threads; i++) {
+            this->workers.emplace_back([this, i] {
+                Utils::TraceThreadName(std::format("Metadata {}", i));
+                workerLoop();
+            });
+        }
+    }
+
+    VoxMetadataCache::~VoxMetadataCache() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->work_available.notify_all();
+        for (auto& worker : this->workers) worker.join();
+        if (this->dirty) Save();
+        for (auto& [path, thumbnail] : this->thumbnails) glDeleteTextures(1, &thumbnail.texture);
+    }
+
+    void VoxMetadataCache::workerLoop() {
+        while (true) {
+            std::string path;
+            uint64_t modified;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                while (!this->stopping && this->queue.empty()) {
+                    if (!this->dirty || this->save_failed) {
+                        this->work_available.wait(lock);
+                    } else if (std::chrono::steady_clock::now() < this->last_finished + SAVE_DELAY) {
+                        this->work_available.wait_until(lock, this->last_finished + SAVE_DELAY);
+                    } else {
+                        lock.unlock();
+                        Save();
+                        lock.lock();
+                    }
+                }
+                if (this->stopping) return;
+                path = std::move(this->queue.front());
+                this->queue.pop_front();
+                modified = this->entries[path].modified;
+            }
+
+            VoxMetadata metadata;
+            if (!PeekVoxHeader(path, metadata)) {
+                publish(path, modified, State::FAILED, metadata);
+                continue;
+            }
+            publish(path, modified, State::HEADER, metadata);
+            publish(path, modified, ScanVoxContent(path, metadata) ? State::COMPLETE : State::FAILED, metadata);
+        }
+    }
+
+    void VoxMetadataCache::publish(const std::string& path, uint64_t modified, State state, const VoxMetadata& metadata) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->entries.find(path);
+            // The file changed again while this job ran, a newer job is queued
+            if (it == this->entries.end() || it->second.modified != modified) return;
+            it->second.state = state;
+            it->second.metadata = metadata;
+            if (state == State::COMPLETE) {
+                this->dirty = true;
+                this->save_failed = false;
+                this->last_finished = std::chrono::steady_clock::now();
+            }
+        }
+        this->generation.fetch_add(1);
+        void (*wake)() = this->on_update.load();
+        if (wake) wake();
+    }
+
+    VoxMetadataCache::Entry VoxMetadataCache::Get(const std::filesystem::path& path) {
+        std::string key = path.string();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->entries.find(key);
+            if (it != this->entries.end() && it->second.checked) return it->second;
+        }
+
+        std::error_code time_error, size_error;
+        auto modified_time = std::filesystem::last_write_time(path, time_error);
+        uint64_t file_size = std::filesystem::file_size(path, size_error);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        Entry& entry = this->entries[key];
+        if (time_error || size_error) {
+            entry = Entry{State::FAILED, 0, 0, true};
+            return entry;
+        }
+        uint64_t modified = modified_time.time_since_epoch().count();
+        if (entry.state == State::COMPLETE && entry.modified == modified && entry.file_size == file_size) {
+            entry.checked = true;
+            return entry;
+        }
+        entry = Entry{State::QUEUED, modified, file_size, true};
+        // Most recent requests first, so the rows on screen fill in before the ones scrolled past
+        this->queue.push_front(key);
+        this->work_available.notify_one();
+        return entry;
+    }
+
+    GLuint VoxMetadataCache::Thumbnail(const std::filesystem::path& path) {
+        std::string key = path.string();
+        uint64_t modified;
+        std::array<GLubyte, VoxMetadata::THUMBNAIL_SIZE * VoxMetadata::THUMBNAIL_SIZE * 4> pixels;
+        auto cached = this->thumbnails.end();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->entries.find(key);
+            if (it == this->entries.end() || it->second.state != State::COMPLETE) return 0;
+            modified = it->second.modified;
+            cached = this->thumbnails.find(key);
+            if (cached != this->thumbnails.end()) {
+                this->thumbnail_uses.splice(this->thumbnail_uses.begin(), this->thumbnail_uses, cached->second.use);
+                if (cached->second.modified == modified) return cached->second.texture;
+            }
+            pixels = it->second.metadata.thumbnail;
+        }
+
+        if (cached == this->thumbnails.end()) {
+            if (this->thumbnails.size() >= MAX_THUMBNAILS) {
+                auto oldest = this->thumbnails.find(this->thumbnail_uses.back());
+                glDeleteTextures(1, &oldest->second.texture);
+                this->thumbnails.erase(oldest);
+                this->thumbnail_uses.pop_back();
+            }
+            this->thumbnail_uses.push_front(key);
+            cached = this->thumbnails.try_emplace(key).first;
+            cached->second.use = this->thumbnail_uses.begin();
+        }
+
+        auto& thumbnail = cached->second;
+        if (thumbnail.texture == 0) glGenTextures(1, &thumbnail.texture);
+        thumbnail.modified = modified;
+        glBindTexture(GL_TEXTURE_2D, thumbnail.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, VoxMetadata::THUMBNAIL_SIZE, VoxMetadata::THUMBNAIL_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return thumbnail.texture;
+    }
+
+    // Index layout, host byte order since it never leaves the machine:
+    // magic, version, entry count, then per entry the path length and bytes,
+    // mtime, file size, dimensions, voxel count, palette usage and thumbnail.
+    bool VoxMetadataCache::Save() {
+        // Taken before the entries are copied, so when two saves overlap the one writing last has the newer copy
+        std::lock_guard<std::mutex> save_lock(this->save_mutex);
+        std::vector<std::pair<std::string, Entry>> complete;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            for (auto& [path, entry] : this->entries) {
+                if (entry.state == State::COMPLETE) complete.emplace_back(path, entry);
+            }
+            this->dirty = false;
+        }
+
+        std::ostringstream out;
+        auto write = [&](const auto& value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        write(INDEX_MAGIC);
+        write(INDEX_VERSION);
+        write((uint32_t)complete.size());
+        for (auto& [path, entry] : complete) {
+            write((uint32_t)path.size());
+            out.write(path.data(), path.size());
+            write(entry.modified);
+            write(entry.file_size);
+            write(entry.metadata.size.x);
+            write(entry.metadata.size.y);
+            write(entry.metadata.size.z);
+            write(entry.metadata.voxel_count);
+            write(entry.metadata.palette_used);
+            out.write(reinterpret_cast<const char*>(entry.metadata.thumbnail.data()), entry.metadata.thumbnail.size());
+        }
+        std::string error = Utils::WriteFileAtomic(this->index_path, out.str());
+        if (!error.empty()) {
+            this->logger->Warn("Failed to save the metadata index: {}", error);
+            // Still unsaved, tried again after the next finished entry and on exit
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->dirty = true;
+            this->save_failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    void VoxMetadataCache::loadIndex() {
+        std::ifstream file(this->index_path, std::ios::binary);
+        if (!file) return;
+        auto read = [&](auto& value) { file.read(reinterpret_cast<char*>(&value), sizeof(value)); };
+        uint32_t magic = 0, version = 0, count = 0;
+        read(magic);
+        read(version);
+        read(count);
+        if (!file || magic != INDEX_MAGIC || version != INDEX_VERSION) {
+            this->logger->Warn("Ignoring metadata index `{}` with an unknown format", this->index_path);
+            return;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t length = 0;
+            read(length);
+            if (!file || length > 4096) break;
+            std::string path(length, '\0');
+            file.read(path.data(), length);
+            Entry entry;
+            entry.state = State::COMPLETE;
+            read(entry.modified);
+            read(entry.file_size);
+            read(entry.metadata.size.x);
+            read(entry.metadata.size.y);
+            read(entry.metadata.size.z);
+            read(entry.metadata.voxel_count);
+            read(entry.metadata.palette_used);
+            file.read(reinterpret_cast<char*>(entry.metadata.thumbnail.data()), entry.metadata.thumbnail.size());
+            if (!file) break;
+            this->entries[path] = entry;
+        }
+        this->logger->Info("Loaded {} entries from metadata index `{}`", this->entries.size(), this->index_path);
+    }
+}  // namespace Engine
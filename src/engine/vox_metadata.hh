@@ -0,0 +1,117 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+// clang-format on
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../utils/logger.hh"
+
+namespace Engine {
+    // What the file browser shows about a .vox file without loading it
+    struct VoxMetadata {
+        static constexpr int THUMBNAIL_SIZE = 32;
+
+        glm::ivec3 size = glm::ivec3(0);
+        int voxel_count = 0;
+        int palette_used = 0;  // Distinct palette indices referenced by the voxels
+        int version = 0;       // Of the file format, the loader only reads 200
+        // Top-down view, RGBA, row 0 at the top, transparent where no voxel is
+        std::array<GLubyte, THUMBNAIL_SIZE * THUMBNAIL_SIZE * 4> thumbnail{};
+    };
+
+    // Reads only the SIZE chunk and the voxel count of the first XYZI chunk, seeking over everything else
+    bool PeekVoxHeader(const std::string& path, VoxMetadata& metadata);
+    // Reads the voxels and the palette to fill in palette usage and the thumbnail
+    bool ScanVoxContent(const std::string& path, VoxMetadata& metadata);
+
+    // Memoizes VoxMetadata per file on a small pool of worker threads. Every
+    // file first gets a header peek, so dimensions and counts show up almost
+    // immediately, and then a full pass for the palette and the thumbnail.
+    // Finished entries persist in an index file keyed by path, mtime and size,
+    // so revisiting a folder needs no file reads at all. The workers write the
+    // index once they have been idle for SAVE_DELAY.
+    class VoxMetadataCache {
+       public:
+        enum class State { QUEUED, HEADER, COMPLETE, FAILED };
+
+        struct Entry {
+            State state = State::QUEUED;
+            uint64_t modified = 0;
+            uint64_t file_size = 0;
+            bool checked = false;  // Key compared against the file on disk this session
+            VoxMetadata metadata;
+        };
+
+       private:
+        static constexpr uint32_t INDEX_MAGIC = 0x494d5856;  // "VXMI"
+        static constexpr uint32_t INDEX_VERSION = 1;
+        // After the last finished entry, so a folder full of new files is written once instead of once per file
+        static constexpr std::chrono::seconds SAVE_DELAY = std::chrono::seconds(2);
+        // Textures kept for the most recently drawn thumbnails, 4 KiB each
+        static constexpr size_t MAX_THUMBNAILS = 512;
+
+        struct Thumbnail {
+            GLuint texture = 0;
+            uint64_t modified = 0;
+            std::list<std::string>::iterator use;  // Position in `thumbnail_uses`
+        };
+
+        Utils::Logger* logger;
+        std::string index_path;
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::unordered_map<std::string, Entry> entries;
+        std::deque<std::string> queue;
+        bool stopping = false;
+        bool dirty = false;  // Entries finished since the index was last written
+        std::chrono::steady_clock::time_point last_finished;
+        bool save_failed = false;  // The workers retry after the next finished entry instead of in a loop
+        std::mutex save_mutex;  // Save runs on the workers and in the destructor
+        std::atomic<size_t> generation = 0;
+        std::atomic<void (*)()> on_update = nullptr;
+        std::vector<std::thread> workers;
+
+        // Only touched on the main thread, which owns the GL context
+        std::unordered_map<std::string, Thumbnail> thumbnails;
+        std::list<std::string> thumbnail_uses;  // Keys of `thumbnails`, most recently drawn first
+
+        void workerLoop();
+        void publish(const std::string& path, uint64_t modified, State state, const VoxMetadata& metadata);
+        void loadIndex();
+
+       public:
+        // `threads` 0 picks a count from the hardware concurrency
+        VoxMetadataCache(Utils::Logger& logger, const std::string& index_path, int threads = 0);
+        ~VoxMetadataCache();
+
+        // Returns a copy of the entry for `path` and queues the file if it is unknown or changed on disk.
+        // The first call per path in a session stats the file, later calls only look it up.
+        Entry Get(const std::filesystem::path& path);
+        // GL texture of the thumbnail, 0 until the full pass finished. Main thread only.
+        GLuint Thumbnail(const std::filesystem::path& path);
+
+        // Writes completed entries to the index file, returns false if it could not be written
+        bool Save();
+
+        // Incremented whenever a worker finishes a stage, to know when to redraw
+        size_t Generation() { return this->generation.load(); };
+        // Called on a worker thread after it finished a stage, e.g. to wake an idle main loop
+        void SetWakeCallback(void (*callback)()) { this->on_update.store(callback); };
+    };
+}  // namespace Engine
@@ -0,0 +1,41 @@
+#include "voxel_animation.hh"
+
+#include "../utils/trace.hh"
+
+namespace Engine {
+    void VoxelAnimation::Clear() {
+        this->keyframe = VoxelGrid();
+        this->deltas.clear();
+        this->frame_ends.clear();
+    }
+
+    void VoxelAnimation::Begin(const VoxelGrid& keyframe) {
+        this->keyframe = keyframe;
+        this->deltas.clear();
+        this->frame_ends.assign(1, 0);
+    }
+
+    void VoxelAnimation::AddFrame(const VoxelGrid& previous, const VoxelGrid& frame) {
+        TRACE_SCOPE("Diff frame");
+        const uint8_t* before = previous.voxels.data();
+        const uint8_t* after = frame.voxels.data();
+        for (size_t i = 0; i < frame.voxels.size(); i++) {
+            if (before[i] != after[i]) this->deltas.push_back({(uint32_t)i, before[i], after[i]});
+        }
+        this->frame_ends.push_back(this->deltas.size());
+    }
+
+    void VoxelAnimation::Seek(VoxelGrid& grid, int from, int to) const {
+        for (int frame = from + 1; frame <= to; frame++) {
+            for (const VoxelDelta& delta : Deltas(frame)) grid.voxels[delta.index] = delta.after;
+        }
+        for (int frame = from; frame > to; frame--) {
+            for (const VoxelDelta& delta : Deltas(frame)) grid.voxels[delta.index] = delta.before;
+        }
+    }
+
+    std::span<const VoxelDelta> VoxelAnimation::Deltas(int frame) const {
+        if (frame <= 0 || frame >= (int)this->frame_ends.size()) return {};
+        return std::span<const VoxelDelta>(this->deltas.data() + this->frame_ends[frame - 1], this->frame_ends[frame] - this->frame_ends[frame - 1]);
+    }
+}  // namespace Engine
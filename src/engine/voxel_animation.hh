@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "voxel_bake.hh"
+
+namespace Engine {
+    // One voxel that differs between a frame and the one before it. Both values are kept so
+    // the delta can be undone, which lets a grid step backwards as cheaply as forwards.
+    struct VoxelDelta {
+        uint32_t index;  // Into VoxelGrid::voxels
+        uint8_t before;
+        uint8_t after;
+    };
+
+    // The frames of an animated VOX model, one per SIZE and XYZI pair. Frame 0 is kept
+    // whole as the keyframe, every later frame only as its deltas to the previous one,
+    // so a mostly static animation costs little more than a single frame.
+    class VoxelAnimation {
+       private:
+        VoxelGrid keyframe;
+        std::vector<VoxelDelta> deltas;
+        // The deltas of frame f > 0 are [frame_ends[f - 1], frame_ends[f]), frame_ends[0] is 0
+        std::vector<uint32_t> frame_ends;
+
+       public:
+        void Clear();
+        // Starts over with `keyframe` as frame 0
+        void Begin(const VoxelGrid& keyframe);
+        // Appends `frame`, which has to have the size of the keyframe, as its difference to `previous`
+        void AddFrame(const VoxelGrid& previous, const VoxelGrid& frame);
+
+        // Steps `grid`, which holds frame `from`, to frame `to` by applying or undoing the deltas between them
+        void Seek(VoxelGrid& grid, int from, int to) const;
+
+        // 0 before Begin
+        int FrameCount() const { return this->frame_ends.size(); };
+        const VoxelGrid& Keyframe() const { return this->keyframe; };
+        // What changed from frame - 1 to frame, empty for frame 0
+        std::span<const VoxelDelta> Deltas(int frame) const;
+        size_t Bytes() const { return this->keyframe.voxels.capacity() + this->deltas.capacity() * sizeof(VoxelDelta); };
+    };
+}  // namespace Engine
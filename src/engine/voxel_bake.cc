@@ -0,0 +1,97 @@
+#include "voxel_bake.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "../utils/trace.hh"
+#include "transform_system.hh"
+
+namespace Engine {
+    glm::vec3 RotateGrid(const VoxelGrid& grid, uint8_t code, VoxelGrid& rotated, JobSystem* jobs) {
+        TRACE_SCOPE("Rotate grid");
+        const QuarterTurns::Matrix& rotation = QuarterTurns::Rotation(code);
+        // Where a mesh puts the center of voxel (0, 0, 0), PushBlock spans z - 1 to z
+        const float center[3] = {0.5f, 0.5f, -0.5f};
+        const ptrdiff_t source_strides[3] = {1, grid.size.x, (ptrdiff_t)grid.size.x * grid.size.y};
+
+        // Each output axis reads one source axis, forwards or backwards
+        ptrdiff_t strides[3];
+        ptrdiff_t base = 0;
+        glm::vec3 translation;
+        for (int axis = 0; axis < 3; axis++) {
+            int source = 0;
+            while (rotation[axis * 3 + source] == 0) source++;
+            int length = grid.size[source];
+            rotated.size[axis] = length;
+            if (rotation[axis * 3 + source] > 0) {
+                strides[axis] = source_strides[source];
+                translation[axis] = center[axis] - center[source];
+            } else {
+                strides[axis] = -source_strides[source];
+                base += (ptrdiff_t)(length - 1) * source_strides[source];
+                translation[axis] = length - 1 + center[source] + center[axis];
+            }
+        }
+
+        glm::ivec3 size = rotated.size;
+        rotated.voxels.resize((size_t)size.x * size.y * size.z);
+        const uint8_t* in = grid.voxels.data();
+        uint8_t* out = rotated.voxels.data();
+        auto rotateLayer = [&](int bz) {
+            for (int by = 0; by < size.y; by += BAKE_BLOCK) {
+                for (int bx = 0; bx < size.x; bx += BAKE_BLOCK) {
+                    int x_end = std::min(bx + BAKE_BLOCK, size.x);
+                    for (int z = bz; z < std::min(bz + BAKE_BLOCK, size.z); z++) {
+                        for (int y = by; y < std::min(by + BAKE_BLOCK, size.y); y++) {
+                            ptrdiff_t source = base + bx * strides[0] + y * strides[1] + z * strides[2];
+                            uint8_t* row = out + rotated.Index(bx, y, z);
+                            for (int x = bx; x < x_end; x++, source += strides[0]) *row++ = in[source];
+                        }
+                    }
+                }
+            }
+        };
+        size_t layers = (size.z + BAKE_BLOCK - 1) / BAKE_BLOCK;
+        if (jobs != nullptr) {
+            jobs->ParallelFor(layers, 1, [&](size_t begin, size_t end) {
+                for (size_t layer = begin; layer < end; layer++) rotateLayer(layer * BAKE_BLOCK);
+            });
+        } else {
+            for (size_t layer = 0; layer < layers; layer++) rotateLayer(layer * BAKE_BLOCK);
+        }
+        return translation;
+    }
+
+    namespace {
+        // Position in 1/1024 units and face direction after the model matrix, and palette index
+        using Corner = std::array<int32_t, 7>;
+
+        std::vector<Corner> corners(const std::vector<float>& vertices, const glm::mat4& model, int stride, glm::vec3 (*normal)(const float* vertex)) {
+            std::vector<Corner> result;
+            result.reserve(vertices.size() / stride);
+            for (size_t i = 0; i + stride <= vertices.size(); i += stride) {
+                const float* vertex = &vertices[i];
+                glm::vec4 position = model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f);
+                glm::vec3 facing = glm::mat3(model) * normal(vertex);
+                Corner corner;
+                for (int axis = 0; axis < 3; axis++) {
+                    corner[axis] = (int32_t)std::lround(position[axis] * 1024.0f);
+                    corner[3 + axis] = (int32_t)std::lround(facing[axis]);
+                }
+                corner[6] = (int32_t)std::lround(vertex[3]);
+                result.push_back(corner);
+            }
+            // Welding may have merged corners on one side only
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+            return result;
+        }
+    }  // namespace
+
+    bool SameSurface(const std::vector<float>& a, const glm::mat4& a_model, const std::vector<float>& b, const glm::mat4& b_model, int stride,
+        glm::vec3 (*normal)(const float* vertex)) {
+        TRACE_SCOPE("Compare surfaces");
+        return corners(a, a_model, stride, normal) == corners(b, b_model, stride, normal);
+    }
+}  // namespace Engine
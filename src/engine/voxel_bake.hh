@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "job_system.hh"
+
+namespace Engine {
+    // Palette indices of a model, x fastest, then y, then z, 0 is empty. The
+    // same layout VoxelVolume::Upload takes.
+    struct VoxelGrid {
+        glm::ivec3 size = glm::ivec3(0);
+        std::vector<uint8_t> voxels;
+
+        size_t Index(int x, int y, int z) const { return x + (size_t)this->size.x * (y + (size_t)this->size.y * z); };
+    };
+
+    // Applies the quarter-turn rotation `code` (see QuarterTurns) to the voxels
+    // themselves by permuting and flipping the grid axes. The grid is walked in
+    // BAKE_BLOCK^3 blocks so both sides stay in cache on large models, with `jobs`
+    // each layer of blocks is a job. Returns the whole number translation t for
+    // which a mesh of `rotated` equals the rotation applied to a mesh of `grid`,
+    // plus t.
+    constexpr int BAKE_BLOCK = 16;
+    glm::vec3 RotateGrid(const VoxelGrid& grid, uint8_t code, VoxelGrid& rotated, JobSystem* jobs = nullptr);
+
+    // Whether two meshes, each moved by its model matrix, cover the same faces
+    // with the same palette indices and facing. The triangulation inside a face
+    // may differ. Vertices start with their position and palette index, `normal`
+    // maps a vertex to the outward direction of its face.
+    bool SameSurface(const std::vector<float>& a, const glm::mat4& a_model, const std::vector<float>& b, const glm::mat4& b_model, int stride,
+        glm::vec3 (*normal)(const float* vertex));
+}  // namespace Engine
@@ -0,0 +1,377 @@
+#include "voxel_codec.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <format>
+
+#include "../utils/trace.hh"
+
+namespace Engine {
+    namespace {
+        constexpr size_t MIN_MATCH = 4;
+        constexpr int HASH_BITS = 14;
+        constexpr int BRICK_VOXELS = VXC_BRICK * VXC_BRICK * VXC_BRICK;
+
+        void append(std::string& out, const void* bytes, size_t length) { out.append(static_cast<const char*>(bytes), length); }
+
+        void appendLength(std::string& out, size_t length) {
+            for (; length >= 255; length -= 255) out.push_back((char)255);
+            out.push_back((char)length);
+        }
+
+        uint32_t load32(const uint8_t* data) {
+            uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        // One LZ sequence, `match` 0 for the literals at the end of a block
+        void appendSequence(std::string& out, const uint8_t* literals, size_t literal_length, size_t offset, size_t match) {
+            size_t match_code = match == 0 ? 0 : match - MIN_MATCH;
+            out.push_back((char)((std::min<size_t>(literal_length, 15) << 4) | std::min<size_t>(match_code, 15)));
+            if (literal_length >= 15) appendLength(out, literal_length - 15);
+            append(out, literals, literal_length);
+            if (match == 0) return;
+            out.push_back((char)(offset & 0xFF));
+            out.push_back((char)(offset >> 8));
+            if (match_code >= 15) appendLength(out, match_code - 15);
+        }
+
+        uint32_t spreadBits(uint32_t value) {
+            value &= 0x3FF;
+            value = (value | value << 16) & 0x030000FF;
+            value = (value | value << 8) & 0x0300F00F;
+            value = (value | value << 4) & 0x030C30C3;
+            value = (value | value << 2) & 0x09249249;
+            return value;
+        }
+
+        uint32_t morton(glm::ivec3 position) { return spreadBits(position.x) | spreadBits(position.y) << 1 | spreadBits(position.z) << 2; }
+
+        // The bricks of a grid in the order the stream visits them
+        std::vector<glm::ivec3> brickOrder(glm::ivec3 size) {
+            glm::ivec3 bricks = (size + VXC_BRICK - 1) / VXC_BRICK;
+            std::vector<glm::ivec3> order;
+            order.reserve((size_t)bricks.x * bricks.y * bricks.z);
+            for (int z = 0; z < bricks.z; z++) {
+                for (int y = 0; y < bricks.y; y++) {
+                    for (int x = 0; x < bricks.x; x++) order.push_back(glm::ivec3(x, y, z));
+                }
+            }
+            std::sort(order.begin(), order.end(), [](const glm::ivec3& a, const glm::ivec3& b) { return morton(a) < morton(b); });
+            return order;
+        }
+
+        // Position within a brick of the i-th voxel in Morton order
+        constexpr std::array<std::array<uint8_t, 3>, BRICK_VOXELS> BRICK_POSITIONS = [] {
+            std::array<std::array<uint8_t, 3>, BRICK_VOXELS> positions{};
+            for (int i = 0; i < BRICK_VOXELS; i++) {
+                for (int bit = 0; bit < 3; bit++) {
+                    for (int axis = 0; axis < 3; axis++) positions[i][axis] |= ((i >> (bit * 3 + axis)) & 1) << bit;
+                }
+            }
+            return positions;
+        }();
+    }  // namespace
+
+    void LzCompress(const uint8_t* data, size_t size, std::string& out) {
+        std::vector<int32_t> table(1 << HASH_BITS, -1);
+        size_t anchor = 0;
+        size_t i = 0;
+        while (i + MIN_MATCH <= size) {
+            uint32_t value = load32(data + i);
+            uint32_t hash = (value * 2654435761u) >> (32 - HASH_BITS);
+            int32_t candidate = table[hash];
+            table[hash] = i;
+            if (candidate < 0 || i - candidate > 0xFFFF || load32(data + candidate) != value) {
+                i++;
+                continue;
+            }
+            size_t match = MIN_MATCH;
+            while (i + match < size && data[candidate + match] == data[i + match]) match++;
+            appendSequence(out, data + anchor, i - anchor, i - candidate, match);
+            i += match;
+            anchor = i;
+        }
+        if (anchor < size) appendSequence(out, data + anchor, size - anchor, 0, 0);
+    }
+
+    bool LzDecompress(const uint8_t* data, size_t data_size, uint8_t* out, size_t size) {
+        const uint8_t* end = data + data_size;
+        size_t written = 0;
+        auto readLength = [&](size_t& length) {
+            uint8_t extra;
+            do {
+                if (data >= end) return false;
+                extra = *data++;
+                length += extra;
+            } while (extra == 255);
+            return true;
+        };
+
+        while (written < size) {
+            if (data >= end) return false;
+            uint8_t token = *data++;
+            size_t literals = token >> 4;
+            if (literals == 15 && !readLength(literals)) return false;
+            if (literals > (size_t)(end - data) || literals > size - written) return false;
+            std::memcpy(out + written, data, literals);
+            data += literals;
+            written += literals;
+            if (written == size) break;
+
+            if (end - data < 2) return false;
+            size_t offset = data[0] | data[1] << 8;
+            data += 2;
+            if (offset == 0 || offset > written) return false;
+            size_t match = token & 15;
+            if (match == 15 && !readLength(match)) return false;
+            match += MIN_MATCH;
+            if (match > size - written) return false;
+            uint8_t* destination = out + written;
+            const uint8_t* source = destination - offset;
+            if (offset >= match) {
+                std::memcpy(destination, source, match);
+            } else {
+                // The match repeats its own output, byte by byte
+                for (size_t i = 0; i < match; i++) destination[i] = source[i];
+            }
+            written += match;
+        }
+        return data == end;
+    }
+
+    VxcEncoder::VxcEncoder(glm::ivec3 size, const PaletteColors& palette, uint32_t frame_count) : size(size) {
+        VxcHeader header{VxcHeader::MAGIC, VxcHeader::VERSION, {size.x, size.y, size.z}, frame_count};
+        append(this->bytes, &header, sizeof(header));
+        append(this->bytes, palette.data(), sizeof(palette));
+    }
+
+    void VxcEncoder::AddFrame(const VoxelGrid& grid) {
+        TRACE_SCOPE("Encode vxc frame");
+        std::vector<glm::ivec3> order = brickOrder(this->size);
+        this->stream.assign((order.size() + 7) / 8, '\0');
+        uint8_t values[BRICK_VOXELS];
+        for (size_t b = 0; b < order.size(); b++) {
+            glm::ivec3 origin = order[b] * VXC_BRICK;
+            uint64_t mask[BRICK_VOXELS / 64] = {};
+            int count = 0;
+            for (int i = 0; i < BRICK_VOXELS; i++) {
+                glm::ivec3 position = origin + glm::ivec3(BRICK_POSITIONS[i][0], BRICK_POSITIONS[i][1], BRICK_POSITIONS[i][2]);
+                if (position.x >= this->size.x || position.y >= this->size.y || position.z >= this->size.z) continue;
+                uint8_t value = grid.voxels[grid.Index(position.x, position.y, position.z)];
+                if (value == 0) continue;
+                mask[i / 64] |= 1ull << (i % 64);
+                values[count++] = value;
+            }
+            if (count == 0) continue;
+
+            this->stream[b / 8] |= 1 << (b % 8);
+            append(this->stream, mask, sizeof(mask));
+            for (int i = 0; i < count;) {
+                int run = i + 1;
+                while (run < count && values[run] == values[i]) run++;
+                this->stream.push_back((char)values[i]);
+                for (uint32_t length = run - i; length != 0;) {
+                    uint8_t digit = length & 0x7F;
+                    length >>= 7;
+                    this->stream.push_back((char)(length != 0 ? digit | 0x80 : digit));
+                }
+                i = run;
+            }
+        }
+
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(this->stream.data());
+        VxcFrameHeader frame{(uint32_t)this->stream.size(), (uint32_t)((this->stream.size() + VXC_BLOCK_SIZE - 1) / VXC_BLOCK_SIZE)};
+        append(this->bytes, &frame, sizeof(frame));
+        std::string packed;
+        for (size_t offset = 0; offset < this->stream.size(); offset += VXC_BLOCK_SIZE) {
+            uint32_t raw_size = std::min<size_t>(VXC_BLOCK_SIZE, this->stream.size() - offset);
+            packed.clear();
+            LzCompress(data + offset, raw_size, packed);
+            bool stored = packed.size() >= raw_size;
+            VxcBlockHeader block{raw_size, stored ? raw_size : (uint32_t)packed.size()};
+            append(this->bytes, &block, sizeof(block));
+            if (stored) {
+                append(this->bytes, data + offset, raw_size);
+            } else {
+                this->bytes += packed;
+            }
+        }
+    }
+
+    VxcDecoder::VxcDecoder(std::istream& in) : in(&in) {}
+
+    std::string VxcDecoder::ReadHeader() {
+        if (!this->in->read(reinterpret_cast<char*>(&this->header), sizeof(this->header))) return "too short for a vxc header";
+        if (this->header.magic != VxcHeader::MAGIC) return "not a vxc file";
+        if (this->header.version != VxcHeader::VERSION) return std::format("unsupported vxc version {}", this->header.version);
+        glm::ivec3 size = Size();
+        if (size.x < 0 || size.y < 0 || size.z < 0 || std::max(size.x, std::max(size.y, size.z)) > VoxEncoder::MAX_SIZE) {
+            return std::format("invalid size {}x{}x{}", size.x, size.y, size.z);
+        }
+        if (!this->in->read(reinterpret_cast<char*>(this->palette.data()), sizeof(this->palette))) return "truncated palette";
+        return "";
+    }
+
+    bool VxcDecoder::nextBlock() {
+        if (!this->error.empty()) return false;
+        if (this->blocks_left == 0) {
+            this->error = "frame ends before its voxels do";
+            return false;
+        }
+        VxcBlockHeader header;
+        if (!this->in->read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            this->error = "truncated block header";
+            return false;
+        }
+        if (header.raw_size == 0 || header.raw_size > VXC_BLOCK_SIZE || header.stored_size > header.raw_size) {
+            this->error = std::format("invalid block of {} bytes stored in {}", header.raw_size, header.stored_size);
+            return false;
+        }
+        this->block.resize(header.raw_size);
+        if (header.stored_size == header.raw_size) {
+            if (!this->in->read(reinterpret_cast<char*>(this->block.data()), header.raw_size)) this->error = "truncated block";
+        } else {
+            this->compressed.resize(header.stored_size);
+            if (!this->in->read(reinterpret_cast<char*>(this->compressed.data()), header.stored_size)) {
+                this->error = "truncated block";
+            } else if (!LzDecompress(this->compressed.data(), header.stored_size, this->block.data(), header.raw_size)) {
+                this->error = "corrupt block";
+            }
+        }
+        this->blocks_left--;
+        this->block_used = 0;
+        return this->error.empty();
+    }
+
+    void VxcDecoder::nextBytes(uint8_t* out, size_t length) {
+        while (length > 0) {
+            if (this->block_used == this->block.size() && !nextBlock()) {
+                std::memset(out, 0, length);
+                return;
+            }
+            size_t chunk = std::min(length, this->block.size() - this->block_used);
+            std::memcpy(out, this->block.data() + this->block_used, chunk);
+            this->block_used += chunk;
+            out += chunk;
+            length -= chunk;
+        }
+    }
+
+    std::string VxcDecoder::ReadFrame(VoxelGrid& grid, size_t* voxels) {
+        TRACE_SCOPE("Decode vxc frame");
+        VxcFrameHeader frame;
+        if (!this->in->read(reinterpret_cast<char*>(&frame), sizeof(frame))) return "truncated frame header";
+        this->blocks_left = frame.block_count;
+        this->block.clear();
+        this->block_used = 0;
+        this->error.clear();
+
+        glm::ivec3 size = Size();
+        grid.size = size;
+        grid.voxels.assign((size_t)size.x * size.y * size.z, 0);
+        std::vector<glm::ivec3> order = brickOrder(size);
+        // The brick mask has to be known before the bricks that follow it, it is a bit per 512 voxels
+        std::vector<uint8_t> brick_mask((order.size() + 7) / 8);
+        nextBytes(brick_mask.data(), brick_mask.size());
+
+        // Where each voxel of a brick lands relative to the brick's first voxel
+        size_t offsets[BRICK_VOXELS];
+        for (int i = 0; i < BRICK_VOXELS; i++) offsets[i] = grid.Index(BRICK_POSITIONS[i][0], BRICK_POSITIONS[i][1], BRICK_POSITIONS[i][2]);
+
+        size_t filled = 0;
+        for (size_t b = 0; b < order.size() && this->error.empty(); b++) {
+            if (!(brick_mask[b / 8] >> (b % 8) & 1)) continue;
+            uint64_t mask[BRICK_VOXELS / 64];
+            nextBytes(reinterpret_cast<uint8_t*>(mask), sizeof(mask));
+            glm::ivec3 origin = order[b] * VXC_BRICK;
+            glm::ivec3 limit = glm::min(size - origin, glm::ivec3(VXC_BRICK));
+            bool partial = limit.x < VXC_BRICK || limit.y < VXC_BRICK || limit.z < VXC_BRICK;
+            uint8_t* base = grid.voxels.data() + grid.Index(origin.x, origin.y, origin.z);
+
+            uint8_t value = 0;
+            uint32_t run = 0;
+            for (int word = 0; word < BRICK_VOXELS / 64; word++) {
+                for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {
+                    int i = word * 64 + std::countr_zero(bits);
+                    if (run == 0) {
+                        value = nextByte();
+                        for (int shift = 0; shift < 35; shift += 7) {
+                            uint8_t digit = nextByte();
+                            run |= (uint32_t)(digit & 0x7F) << shift;
+                            if (!(digit & 0x80)) break;
+                        }
+                        if (value == 0 || run == 0) {
+                            if (this->error.empty()) this->error = "corrupt run";
+                            return this->error;
+                        }
+                    }
+                    if (partial && (BRICK_POSITIONS[i][0] >= limit.x || BRICK_POSITIONS[i][1] >= limit.y || BRICK_POSITIONS[i][2] >= limit.z)) {
+                        return "voxel outside the grid";
+                    }
+                    base[offsets[i]] = value;
+                    run--;
+                }
+            }
+            if (run != 0) return "run longer than its brick";
+            for (uint64_t word : mask) filled += std::popcount(word);
+        }
+        if (!this->error.empty()) return this->error;
+        if (this->blocks_left != 0 || this->block_used != this->block.size()) return "frame has data after its voxels";
+        if (voxels) *voxels = filled;
+        return "";
+    }
+
+    VoxEncoder::VoxEncoder(uint32_t frame_count) {
+        if (frame_count <= 1) return;
+        int32_t chunk[3] = {0, 0, 0};
+        std::memcpy(chunk, "PACK", 4);
+        chunk[1] = sizeof(int32_t);
+        append(this->children, chunk, sizeof(chunk));
+        append(this->children, &frame_count, sizeof(frame_count));
+    }
+
+    void VoxEncoder::AddFrame(const VoxelGrid& grid) {
+        TRACE_SCOPE("Encode vox frame");
+        int32_t size_chunk[6] = {0, 3 * sizeof(int32_t), 0, grid.size.x, grid.size.y, grid.size.z};
+        std::memcpy(size_chunk, "SIZE", 4);
+        append(this->children, size_chunk, sizeof(size_chunk));
+
+        size_t header_at = this->children.size();
+        int32_t xyzi_chunk[4] = {0, 0, 0, 0};
+        std::memcpy(xyzi_chunk, "XYZI", 4);
+        append(this->children, xyzi_chunk, sizeof(xyzi_chunk));
+        int32_t count = 0;
+        for (int z = 0; z < grid.size.z; z++) {
+            for (int y = 0; y < grid.size.y; y++) {
+                for (int x = 0; x < grid.size.x; x++) {
+                    uint8_t value = grid.voxels[grid.Index(x, y, z)];
+                    if (value == 0) continue;
+                    uint8_t voxel[4] = {(uint8_t)x, (uint8_t)y, (uint8_t)z, value};
+                    append(this->children, voxel, sizeof(voxel));
+                    count++;
+                }
+            }
+        }
+        xyzi_chunk[1] = sizeof(int32_t) + count * 4;
+        xyzi_chunk[3] = count;
+        std::memcpy(this->children.data() + header_at, xyzi_chunk, sizeof(xyzi_chunk));
+    }
+
+    std::string VoxEncoder::Finish(const PaletteColors& palette) {
+        int32_t rgba_chunk[3] = {0, sizeof(palette), 0};
+        std::memcpy(rgba_chunk, "RGBA", 4);
+        append(this->children, rgba_chunk, sizeof(rgba_chunk));
+        append(this->children, palette.data(), sizeof(palette));
+
+        std::string file;
+        int32_t header[5] = {0, 200, 0, 0, (int32_t)this->children.size()};
+        std::memcpy(&header[0], "VOX ", 4);
+        std::memcpy(&header[2], "MAIN", 4);
+        append(file, header, sizeof(header));
+        return file + this->children;
+    }
+}  // namespace Engine
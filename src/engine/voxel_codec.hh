@@ -0,0 +1,125 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "palette.hh"
+#include "voxel_bake.hh"
+
+namespace Engine {
+    // Layout of a .vxc file, every field little endian:
+    //
+    //   VxcHeader
+    //   PaletteColors                   as in the VOX RGBA chunk
+    //   per frame: VxcFrameHeader, then block_count times VxcBlockHeader and its bytes
+    //
+    // A frame is a brick stream cut into blocks of at most VXC_BLOCK_SIZE bytes,
+    // each compressed on its own so the decoder never holds more than one. The
+    // stream visits the VXC_BRICK^3 bricks of the grid in Morton order:
+    //
+    //   brick mask         a bit per brick, set if it holds any voxel
+    //   per set brick:     a bit per voxel in Morton order within the brick (64 bytes),
+    //                      then (palette index, LEB128 run length) pairs covering the set bits
+    //
+    // Bits are least significant first. Morton order keeps neighbouring voxels
+    // next to each other in the stream, so one run usually covers a whole
+    // surface patch.
+    struct VxcHeader {
+        static constexpr uint32_t MAGIC = 0x20435856;  // "VXC "
+        static constexpr uint32_t VERSION = 1;
+
+        uint32_t magic;
+        uint32_t version;
+        int32_t size[3];
+        uint32_t frame_count;
+    };
+
+    struct VxcFrameHeader {
+        uint32_t stream_size;  // Of the brick stream before compression
+        uint32_t block_count;
+    };
+
+    struct VxcBlockHeader {
+        uint32_t raw_size;
+        uint32_t stored_size;  // Equal to raw_size when the block did not compress and is stored as is
+    };
+
+    static_assert(sizeof(VxcHeader) == 24 && sizeof(VxcFrameHeader) == 8 && sizeof(VxcBlockHeader) == 8, "vxc records are read and written as is");
+
+    constexpr int VXC_BRICK = 8;
+    constexpr uint32_t VXC_BLOCK_SIZE = 64 << 10;
+
+    // Byte-oriented LZ77 in the style of LZ4: a token with literal and match length nibbles, the
+    // literals, a 16 bit offset and length extensions in 255 steps. No entropy coding, which keeps
+    // decoding at memory speed. Appends to `out`.
+    void LzCompress(const uint8_t* data, size_t size, std::string& out);
+    // False if `data` does not decode to exactly `size` bytes
+    bool LzDecompress(const uint8_t* data, size_t data_size, uint8_t* out, size_t size);
+
+    // Builds a .vxc in memory, one AddFrame per frame in order
+    class VxcEncoder {
+       private:
+        std::string bytes;
+        std::string stream;  // Brick stream of the frame being added, reused
+        glm::ivec3 size;
+
+       public:
+        VxcEncoder(glm::ivec3 size, const PaletteColors& palette, uint32_t frame_count);
+
+        // `grid` has to be the size given to the constructor
+        void AddFrame(const VoxelGrid& grid);
+        const std::string& Bytes() const { return this->bytes; };
+    };
+
+    // Reads a .vxc frame by frame from `in`. Frames are decoded a block at a time straight into the
+    // grid, so apart from the grid itself the decoder holds one compressed and one raw block.
+    class VxcDecoder {
+       private:
+        std::istream* in;
+        VxcHeader header{};
+        PaletteColors palette{};
+        std::vector<uint8_t> compressed;
+        std::vector<uint8_t> block;
+        size_t block_used = 0;
+        uint32_t blocks_left = 0;
+        std::string error;
+
+        bool nextBlock();
+        // Zero past the end of the frame, check `error` after the frame
+        uint8_t nextByte() { return this->block_used < this->block.size() ? this->block[this->block_used++] : nextBlock() ? this->block[this->block_used++] : 0; };
+        void nextBytes(uint8_t* out, size_t length);
+
+       public:
+        explicit VxcDecoder(std::istream& in);
+
+        // Empty on success, otherwise what is wrong with the file. Sizes past VoxEncoder::MAX_SIZE on any axis are
+        // rejected, like the .vox loader does, before ReadFrame would allocate the grid for them.
+        std::string ReadHeader();
+        glm::ivec3 Size() const { return glm::ivec3(this->header.size[0], this->header.size[1], this->header.size[2]); };
+        int FrameCount() const { return this->header.frame_count; };
+        const PaletteColors& Palette() const { return this->palette; };
+
+        // Decodes the next frame into `grid`, which is resized to Size(). `voxels` receives the number of filled voxels.
+        std::string ReadFrame(VoxelGrid& grid, size_t* voxels = nullptr);
+    };
+
+    // Builds a MagicaVoxel .vox in memory: a SIZE and XYZI chunk per frame, PACK when there is more than one, and RGBA
+    class VoxEncoder {
+       private:
+        std::string children;  // Of the MAIN chunk
+
+       public:
+        // VOX stores coordinates as bytes
+        static constexpr int MAX_SIZE = 256;
+
+        explicit VoxEncoder(uint32_t frame_count);
+
+        void AddFrame(const VoxelGrid& grid);
+        // The whole file, after the last frame
+        std::string Finish(const PaletteColors& palette);
+    };
+}  // namespace Engine
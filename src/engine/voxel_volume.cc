@@ -0,0 +1,68 @@
+#include "voxel_volume.hh"
+
+namespace Engine {
+    VoxelVolume::VoxelVolume() : VAO(), VBO(), EBO() {
+        glGenTextures(1, &this->volume);
+        glGenTextures(1, &this->occupancy);
+
+        // Unit cube, corner i is (i & 1, (i >> 1) & 1, (i >> 2) & 1), faces wound counter-clockwise from outside
+        GLfloat corners[24];
+        for (int i = 0; i < 8; i++) {
+            corners[i * 3] = i & 1;
+            corners[i * 3 + 1] = (i >> 1) & 1;
+            corners[i * 3 + 2] = (i >> 2) & 1;
+        }
+        GLuint faces[] = {4, 6, 2, 4, 2, 0, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4, 6, 7, 3, 6, 3, 2, 2, 3, 1, 2, 1, 0, 4, 5, 7, 4, 7, 6};
+        this->VAO.Bind();
+        this->VBO.Update(corners, sizeof(corners));
+        this->EBO.Update(faces, sizeof(faces));
+        this->VAO.LinkAttrib(this->VBO, 0, 3, GL_FLOAT, 3 * sizeof(GLfloat), (void*)0);
+        this->VAO.Unbind();
+    }
+
+    VoxelVolume::~VoxelVolume() {
+        glDeleteTextures(1, &this->volume);
+        glDeleteTextures(1, &this->occupancy);
+    }
+
+    void VoxelVolume::Upload(const std::vector<GLubyte>& grid, glm::ivec3 size) {
+        this->size = size;
+        this->bricks = (size + glm::ivec3(BRICK_SIZE - 1)) / BRICK_SIZE;
+
+        this->occupancy_data.assign((size_t)this->bricks.x * this->bricks.y * this->bricks.z, 0);
+        for (int z = 0; z < size.z; z++) {
+            for (int y = 0; y < size.y; y++) {
+                for (int x = 0; x < size.x; x++) {
+                    if (grid[x + size.x * (y + (size_t)size.y * z)] == 0) continue;
+                    int bx = x / BRICK_SIZE, by = y / BRICK_SIZE, bz = z / BRICK_SIZE;
+                    this->occupancy_data[bx + this->bricks.x * (by + (size_t)this->bricks.y * bz)] = 1;
+                }
+            }
+        }
+
+        // Rows of a one byte texture are not 4-byte aligned unless the width happens to be
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_3D, this->volume);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, size.x, size.y, size.z, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, grid.data());
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+
+        glBindTexture(GL_TEXTURE_3D, this->occupancy);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, this->bricks.x, this->bricks.y, this->bricks.z, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+            this->occupancy_data.data());
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_3D, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    void VoxelVolume::Bind() {
+        glActiveTexture(GL_TEXTURE0 + VOLUME_UNIT);
+        glBindTexture(GL_TEXTURE_3D, this->volume);
+        glActiveTexture(GL_TEXTURE0 + OCCUPANCY_UNIT);
+        glBindTexture(GL_TEXTURE_3D, this->occupancy);
+        glActiveTexture(GL_TEXTURE0);
+    }
+}  // namespace Engine
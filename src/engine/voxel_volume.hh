@@ -0,0 +1,48 @@
+#pragma once
+
+// clang-format off
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+// clang-format on
+
+#include <vector>
+
+#include "EBO.hh"
+#include "VAO.hh"
+#include "VBO.hh"
+
+namespace Engine {
+    // GPU side of the raymarch render mode. The voxel grid is a GL_R8UI 3D
+    // texture of palette indices, next to a coarse occupancy texture with one
+    // texel per BRICK_SIZE^3 brick that lets the ray skip empty space. Colors
+    // come from the entity's PaletteSet. Only the bounding box is drawn, the
+    // fragment shader (raymarch.vert/frag) finds the surface.
+    class VoxelVolume {
+       private:
+        std::vector<GLubyte> occupancy_data;
+
+       public:
+        static constexpr int BRICK_SIZE = 4;
+        // Texture units the samplers are bound to
+        static constexpr int VOLUME_UNIT = 0;
+        static constexpr int OCCUPANCY_UNIT = 1;
+
+        GLuint volume;
+        GLuint occupancy;
+        Engine::VAO VAO;
+        Engine::VBO VBO;
+        Engine::EBO EBO;
+        glm::ivec3 size = glm::ivec3(0);
+        glm::ivec3 bricks = glm::ivec3(0);
+
+        VoxelVolume();
+        ~VoxelVolume();
+
+        // `grid` holds one palette index per voxel, x fastest, then y, then z. Index 0 is empty.
+        void Upload(const std::vector<GLubyte>& grid, glm::ivec3 size);
+        void Bind();
+        // Upper bound of DDA steps through the brick and voxel grids along any ray
+        int MaxSteps() { return this->size.x + this->size.y + this->size.z + this->bricks.x + this->bricks.y + this->bricks.z + 4; };
+        GLsizei IndexCount() { return 36; };
+    };
+}  // namespace Engine
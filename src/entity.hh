@@ -3,15 +3,40 @@
 #include <GLFW/glfw3.h>
 #include <yaml-cpp/yaml.h>
 
+#include <array>
+#include <bit>
+#include <chrono>
 #include <filesystem>
+#include <format>
 #include <fstream>
+#include <functional>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <memory>
+#include <memory_resource>
+#include <sstream>
 #include <string>
 
+#include "engine/buffer_arena.hh"
+#include "engine/entity_file.hh"
+#include "engine/job_system.hh"
+#include "engine/mesh_optimizer.hh"
+#include "engine/palette.hh"
+#include "engine/transform_system.hh"
+#include "engine/voxel_animation.hh"
+#include "engine/voxel_bake.hh"
+#include "engine/voxel_codec.hh"
+#include "engine/voxel_volume.hh"
+#include "utils/alloc_tracker.hh"
+#include "utils/atomic_file.hh"
+#include "utils/load_arena.hh"
 #include "utils/logger.hh"
+#include "utils/trace.hh"
 
 namespace Entity {
+    // MESH triangulates the model, RAYMARCH uploads it as a 3D texture and raymarches its bounding box
+    enum class RenderMode { MESH, RAYMARCH };
+
     class Reader {
        private:
         std::ifstream file;
@@ -19,16 +44,20 @@ namespace Entity {
 
        public:
         int cursor;
+        int64_t size;
 
         Reader(Utils::Logger* logger, std::string path) {
             this->logger = logger;
-            this->file.open(path, std::ios::binary);
-            if (!this->file) {
-                this->logger->Fatal(std::format("Failed to open file: `{}` for reading", path));
-            }
+            this->file.open(path, std::ios::binary | std::ios::ate);
+            this->size = this->file ? (int64_t)this->file.tellg() : 0;
+            this->file.seekg(0);
             this->cursor = 0;
         }
 
+        // False once the file could not be opened or a read went past its end
+        bool Good() { return (bool)this->file; }
+        int64_t Remaining() { return this->size - this->cursor; }
+
         std::string String(int length) {
             std::string str;
             str.resize(length);
@@ -51,68 +80,485 @@ namespace Entity {
             return value;
         }
 
+        // One read for a whole block instead of a call per byte
+        void Bytes(void* out, int length) {
+            this->file.read(reinterpret_cast<char*>(out), length);
+            this->cursor += length;
+        }
+
+        void Skip(int length) {
+            this->file.seekg(length, std::ios::cur);
+            this->cursor += length;
+        }
+
         ~Reader() { this->file.close(); }
     };
 
     class EntityBase {
        private:
-        std::string data_path;
-        YAML::Node data;
+        std::string data_path;  // The .yml the entity was loaded from or saved to, empty for a bare model
+        // Settings as last loaded or written, for Dirty
+        std::string clean_name;
+        glm::vec3 clean_offset;
+        glm::vec3 clean_rotation;
+        // Settings as last handed to a write that has not completed yet, for Unscheduled
+        std::string scheduled_name;
+        glm::vec3 scheduled_offset;
+        glm::vec3 scheduled_rotation;
         Utils::Logger* logger;
 
         std::string model_path;
         glm::vec3 velocity;
         glm::vec3 acceleration;
 
-        Engine::VAO VAO;
-        Engine::VBO VBO;
-        Engine::EBO EBO;
+        // The mesh lives in ranges of buffers shared with every other entity, one mesh per animation frame
+        Engine::BufferArena* buffers;
+        std::vector<Engine::BufferArena::Handle> meshes;
+        Engine::VoxelVolume volume;
+        RenderMode render_mode = RenderMode::MESH;
+        // Each representation is built on first use after a load
+        bool mesh_built = false;
+        bool volume_built = false;
 
-        int pallet[256][4];
+        Engine::PaletteColors palette;
+        // Selectable in the preview, 0 is the model's own palette and i + 1 is variants[i]
+        std::vector<Engine::PaletteVariant> variants;
+        int variant = 0;
+        Engine::PaletteSet palettes;
         int voxel_amount;
-        std::vector<glm::vec4> voxels;
-        std::vector<std::vector<std::vector<int>>> blocks;
+        // x, y, z and palette index, as stored in the XYZI chunk
+        using RawVoxel = std::array<uint8_t, 4>;
+        // One SIZE and XYZI pair, its voxels are [first, first + count) of everything readModel read
+        struct RawFrame {
+            glm::ivec3 size;
+            size_t first;
+            size_t count;
+        };
+        // Frames past the first as deltas, `grid` always holds frame `frame`
+        Engine::VoxelAnimation animation;
+        int frame = 0;
+        float frame_time = 0.0f;  // Seconds into the current frame while playing
+        // Raw voxels and meshing scratch, reset at the start of every load and every triangulation. The
+        // grid and the mesh below are reassigned in place, so repeated loads reuse their capacity too.
+        Utils::LoadArena arena;
+        Engine::VoxelGrid grid;
         std::vector<GLfloat> vertices;
         std::vector<GLuint> indices;
-        int indices_size;
 
-        int readIntOrZero(YAML::Node node) { return node.IsDefined() ? node.as<int>() : 0; }
+        // Meshing is split into jobs, each meshes into its own part and the parts are joined in order
+        Engine::JobSystem* jobs;
+        struct MeshPart {
+            std::vector<GLfloat> vertices;
+            std::vector<GLuint> indices;
+        };
+        std::vector<MeshPart> mesh_parts;  // Slabs of a single frame, kept for their capacity
+        // Optimizer scratch per job system thread, by Engine::JobSystem::ThreadIndex
+        std::vector<std::unique_ptr<Utils::LoadArena>> thread_arenas;
+
+        // Each SIZE and XYZI pair is one frame, the model is as large as the largest frame. Returns an empty string
+        // on success, otherwise what is wrong with the file. Nothing of the entity changes before the file is known good.
+        std::string readModel(std::pmr::vector<RawVoxel>& voxels, std::pmr::vector<RawFrame>& frames, Engine::PaletteColors& palette, glm::vec3& model_size) {
+            TRACE_SCOPE("Read VOX");
+            ALLOC_PHASE(PARSE);
+            Reader r(this->logger, this->model_path);
+            if (!r.Good()) return "Cannot open the file";
+            std::string magic = r.String(4);
+            if (magic != "VOX ") return std::format("Invalid magic number: `{}` for VOX file", magic);
+
+            int version = r.Int(4);
+            if (version != 200) return std::format("Unsupported version: `{}`", version);
+
+            std::string main_chunk_name = r.String(4);
+            if (main_chunk_name != "MAIN") return std::format("Invalid main chunk name: `{}`", main_chunk_name);
+            int main_chunk_size = r.Int(4);
+            int remaining_file = r.Int(4);
+            if (main_chunk_size != 0) return std::format("Incorrect main chunk size: `{}`", main_chunk_size);
+
+            model_size = glm::vec3(0.0f);
+            while (r.cursor < remaining_file + 5 * 4) {
+                std::string chunk_name = r.String(4);
+                int chunk_size = r.Int(4);
+                int child_size = r.Int(4);
+                if (!r.Good()) return "File ends inside a chunk";
+                if (chunk_size < 0 || child_size < 0 || (int64_t)chunk_size + child_size > r.Remaining()) {
+                    return std::format("Chunk `{}` runs past the end of the file", chunk_name);
+                }
+                int64_t chunk_end = r.cursor + (int64_t)chunk_size + child_size;
+                if (chunk_name == "SIZE") {
+                    glm::ivec3 size;
+                    size.x = r.Int(4);
+                    size.y = r.Int(4);
+                    size.z = r.Int(4);
+                    if (size.x <= 0 || size.y <= 0 || size.z <= 0 || std::max(size.x, std::max(size.y, size.z)) > Engine::VoxEncoder::MAX_SIZE) {
+                        return std::format("Invalid model size: `{}x{}x{}`", size.x, size.y, size.z);
+                    }
+                    frames.push_back({size, voxels.size(), 0});
+                    model_size = glm::max(model_size, glm::vec3(size));
+                } else if (chunk_name == "PACK") {
+                    // The frame count, the SIZE and XYZI pairs are counted instead
+                    r.Int(4);
+                } else if (chunk_name == "RGBA") {
+                    if (chunk_size != 1024) return std::format("Invalid RGBA chunk size: `{}`", chunk_size);
+                    r.Bytes(palette.data(), sizeof(palette));
+                } else if (chunk_name == "XYZI") {
+                    // The chunk states its size, so the voxels are read in one go
+                    int amount = r.Int(4);
+                    if (amount < 0 || (int64_t)amount * 4 > chunk_size - 4 || (int64_t)amount * 4 > r.Remaining()) {
+                        return std::format("Invalid voxel amount: `{}`", amount);
+                    }
+                    if (frames.empty() || frames.back().count != 0) return "XYZI chunk without a SIZE chunk before it";
+                    size_t first = voxels.size();
+                    voxels.resize(first + amount);
+                    r.Bytes(voxels.data() + first, amount * 4);
+                    frames.back().count = amount;
+                } else {
+                    this->logger->Warn("`{}`: Skipping unknown chunk: `{}` (`{}` + `{}`)", this->model_path, chunk_name, chunk_size, child_size);
+                }
+                // Past whatever part of the chunk was not read, the scene graph chunks and children are skipped as a whole
+                if (r.cursor > chunk_end) return std::format("Chunk `{}` is smaller than its contents", chunk_name);
+                r.Skip(chunk_end - r.cursor);
+            }
+            if (!r.Good()) return "File ends inside a chunk";
+            if (frames.empty()) return "No SIZE chunk";
+            return "";
+        };
+
+        void fillGrid(Engine::VoxelGrid& grid, const RawVoxel* voxels, size_t count) {
+            grid.size = glm::ivec3(model_size);
+            grid.voxels.assign((size_t)grid.size.x * grid.size.y * grid.size.z, 0);
+
+            for (const RawVoxel* voxel = voxels; voxel != voxels + count; voxel++) {
+                if ((*voxel)[0] >= grid.size.x || (*voxel)[1] >= grid.size.y || (*voxel)[2] >= grid.size.z) {
+                    logger->Warn("Voxel out of bounds: `{}`, `{}`, `{}`", (int)(*voxel)[0], (int)(*voxel)[1], (int)(*voxel)[2]);
+                    continue;
+                }
+                grid.voxels[grid.Index((*voxel)[0], (*voxel)[1], (*voxel)[2])] = (*voxel)[3];
+            }
+        };
+
+        // Frame 0 goes into the grid, later frames are diffed against the one before them
+        void buildGrid(const std::pmr::vector<RawVoxel>& voxels, const std::pmr::vector<RawFrame>& frames) {
+            TRACE_SCOPE("Build grid");
+            ALLOC_PHASE(GRID);
+            this->animation.Clear();
+            this->frame = 0;
+            this->frame_time = 0.0f;
+            this->voxel_amount = frames.empty() ? 0 : frames[0].count;
+            if (frames.size() <= 1) {
+                fillGrid(this->grid, voxels.data(), voxels.size());
+                return;
+            }
+
+            fillGrid(this->grid, voxels.data() + frames[0].first, frames[0].count);
+            this->animation.Begin(this->grid);
+            Engine::VoxelGrid previous;
+            for (size_t i = 1; i < frames.size(); i++) {
+                std::swap(previous, this->grid);
+                fillGrid(this->grid, voxels.data() + frames[i].first, frames[i].count);
+                this->animation.AddFrame(previous, this->grid);
+            }
+            this->animation.Seek(this->grid, frames.size() - 1, 0);
+        };
+
+        // A .vxc decodes frame by frame into a new grid, later frames into a second grid to diff against. Empty on
+        // success, otherwise the error and the model loaded before is untouched.
+        std::string readVxc() {
+            TRACE_SCOPE("Read VXC");
+            ALLOC_PHASE(PARSE);
+            std::ifstream file(this->model_path, std::ios::binary);
+            Engine::VxcDecoder decoder(file);
+            Engine::VoxelGrid grid;
+            Engine::VoxelAnimation animation;
+            size_t voxels = 0;
+            std::string error = file ? decoder.ReadHeader() : "cannot open the file";
+            if (error.empty()) error = decoder.ReadFrame(grid, &voxels);
+            if (error.empty() && decoder.FrameCount() > 1) {
+                animation.Begin(grid);
+                Engine::VoxelGrid previous;
+                for (int i = 1; i < decoder.FrameCount() && error.empty(); i++) {
+                    std::swap(previous, grid);
+                    error = decoder.ReadFrame(grid);
+                    if (error.empty()) animation.AddFrame(previous, grid);
+                }
+                if (error.empty()) animation.Seek(grid, decoder.FrameCount() - 1, 0);
+            }
+            if (!error.empty()) return error;
+            std::swap(this->grid, grid);
+            std::swap(this->animation, animation);
+            this->frame = 0;
+            this->frame_time = 0.0f;
+            this->model_size = glm::vec3(decoder.Size());
+            this->palette = decoder.Palette();
+            this->voxel_amount = voxels;
+            return "";
+        };
+
+        // Bit per side of the block at x, y, z that is not covered by its neighbour, in PushBlock's order
+        int exposedFaces(int x, int y, int z) {
+            const uint8_t* block = &this->grid.voxels[this->grid.Index(x, y, z)];
+            const size_t row = this->grid.size.x;
+            const size_t slice = row * this->grid.size.y;
+            int faces = 0;
+            if (!(y < this->grid.size.y - 1 && block[row] == 1)) faces |= 1 << 0;
+            if (!(y > 0 && block[-(ptrdiff_t)row] == 1)) faces |= 1 << 1;
+            if (!(x < this->grid.size.x - 1 && block[1] == 1)) faces |= 1 << 2;
+            if (!(x > 0 && block[-1] == 1)) faces |= 1 << 3;
+            if (!(z < this->grid.size.z - 1 && block[slice] == 1)) faces |= 1 << 4;
+            if (!(z > 0 && block[-(ptrdiff_t)slice] == 1)) faces |= 1 << 5;
+            return faces;
+        };
+
+        // Pushes the blocks in [from, to), counting their faces first sizes both buffers exactly so pushing never reallocates.
+        // Only reads the grid, so jobs can mesh separate regions at the same time.
+        void meshRegion(glm::ivec3 from, glm::ivec3 to, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices) {
+            size_t faces = 0;
+            for (int z = from.z; z < to.z; z++) {
+                for (int y = from.y; y < to.y; y++) {
+                    for (int x = from.x; x < to.x; x++) {
+                        if (this->grid.voxels[this->grid.Index(x, y, z)] != 0) faces += std::popcount((unsigned)exposedFaces(x, y, z));
+                    }
+                }
+            }
+            vertices.reserve(vertices.size() + faces * 4 * VERTEX_STRIDE);
+            indices.reserve(indices.size() + faces * 6);
+
+            for (int z = from.z; z < to.z; z++) {
+                for (int y = from.y; y < to.y; y++) {
+                    for (int x = from.x; x < to.x; x++) {
+                        uint8_t block = this->grid.voxels[this->grid.Index(x, y, z)];
+                        if (block != 0) PushBlock(vertices, indices, x, y, z, block);
+                    }
+                }
+            }
+        };
+
+        void optimizeMesh(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, std::pmr::memory_resource* scratch) {
+            TRACE_SCOPE("Optimize mesh");
+            Engine::MeshOptimizer::WeldVertices(vertices, indices, VERTEX_STRIDE, scratch);
+            Engine::MeshOptimizer::OptimizeVertexCache(indices, vertices.size() / VERTEX_STRIDE, scratch);
+            Engine::MeshOptimizer::OptimizeOverdraw(indices, vertices, VERTEX_STRIDE, FaceNormal, Engine::MeshOptimizer::OVERDRAW_THRESHOLD, scratch);
+            Engine::MeshOptimizer::OptimizeVertexFetch(vertices, indices, VERTEX_STRIDE, scratch);
+        };
+
+        // Replaces `vertices` and `indices` with the parts one after the other, each part's indices moved past the vertices before it
+        void joinParts(const MeshPart* parts, size_t count) {
+            size_t vertex_floats = 0, index_count = 0;
+            for (size_t i = 0; i < count; i++) {
+                vertex_floats += parts[i].vertices.size();
+                index_count += parts[i].indices.size();
+            }
+            vertices.clear();
+            indices.clear();
+            vertices.reserve(vertex_floats);
+            indices.reserve(index_count);
+            for (size_t i = 0; i < count; i++) {
+                GLuint base = vertices.size() / VERTEX_STRIDE;
+                vertices.insert(vertices.end(), parts[i].vertices.begin(), parts[i].vertices.end());
+                for (GLuint index : parts[i].indices) indices.push_back(base + index);
+            }
+        };
+
+        // Meshes the whole grid in slabs along z, one job each. meshRegion walks z slowest, so joining the slabs
+        // in order gives exactly the mesh a single meshRegion over the grid would.
+        void meshSlabs() {
+            const glm::ivec3 size = this->grid.size;
+            size_t slabs = std::min<size_t>(std::max(size.z, 0), this->jobs->ThreadCount() * 4);
+            if (slabs == 0) {
+                joinParts(nullptr, 0);
+                return;
+            }
+            int layers = (size.z + slabs - 1) / slabs;
+            slabs = (size.z + layers - 1) / layers;
+            if (this->mesh_parts.size() < slabs) this->mesh_parts.resize(slabs);
+            this->jobs->ParallelFor(slabs, 1, [&](size_t begin, size_t end) {
+                for (size_t slab = begin; slab < end; slab++) {
+                    MeshPart& part = this->mesh_parts[slab];
+                    part.vertices.clear();
+                    part.indices.clear();
+                    int z = slab * layers;
+                    meshRegion(glm::ivec3(0, 0, z), glm::ivec3(size.x, size.y, std::min(z + layers, size.z)), part.vertices, part.indices);
+                }
+            });
+            joinParts(this->mesh_parts.data(), slabs);
+        };
+
+        // Optimizer scratch of the calling thread, the default resource on threads outside the job system
+        std::pmr::memory_resource* threadArena() {
+            int index = this->jobs->ThreadIndex();
+            if (index < 0) return std::pmr::get_default_resource();
+            this->thread_arenas[index]->Reset();
+            return this->thread_arenas[index].get();
+        };
+
+        // After a load: the palettes go up again and every representation is rebuilt on first use
+        void rebuild() {
+            this->palettes.Upload(this->palette, this->variants);
+            this->mesh_built = false;
+            this->volume_built = false;
+            SetRenderMode(this->render_mode);
+        };
+
+        // Keeps one uploaded mesh per frame, released ones go back to the shared buffers
+        void resizeMeshes(size_t count) {
+            for (size_t i = count; i < this->meshes.size(); i++) this->buffers->Release(this->meshes[i]);
+            this->meshes.resize(count, 0);
+        };
+
+        // Meshes and uploads every frame of the animation up front, so playback never meshes. The grid is cut into
+        // ANIMATION_CHUNK^3 chunks and each frame only re-meshes the chunks its deltas touch, or whose faces they
+        // uncover, the other chunk meshes carry over from the frame before. A frame is uploaded as one mesh, so
+        // drawing it stays a single call.
+        void triangulateFrames() {
+            auto start = std::chrono::steady_clock::now();
+            const int frames = this->animation.FrameCount();
+            const int shown = this->frame;
+            const glm::ivec3 size = this->grid.size;
+            const glm::ivec3 chunks = (size + ANIMATION_CHUNK - 1) / ANIMATION_CHUNK;
+            std::vector<MeshPart> chunk_meshes((size_t)chunks.x * chunks.y * chunks.z);
+            std::vector<uint8_t> dirty(chunk_meshes.size(), 1);
+            std::vector<size_t> rebuild;
+            std::vector<GLfloat> shown_vertices;
+            std::vector<GLuint> shown_indices;
+            size_t rebuilt = 0;
+            resizeMeshes(frames);
+
+            this->animation.Seek(this->grid, shown, 0);
+            for (int frame = 0; frame < frames; frame++) {
+                if (frame > 0) {
+                    this->animation.Seek(this->grid, frame - 1, frame);
+                    // A changed voxel also changes which faces of its neighbours are exposed
+                    const glm::ivec3 neighbours[] = {{0, 0, 0}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+                    for (const Engine::VoxelDelta& delta : this->animation.Deltas(frame)) {
+                        glm::ivec3 voxel(delta.index % size.x, (delta.index / size.x) % size.y, delta.index / ((size_t)size.x * size.y));
+                        for (const glm::ivec3& offset : neighbours) {
+                            glm::ivec3 neighbour = voxel + offset;
+                            if (neighbour.x < 0 || neighbour.y < 0 || neighbour.z < 0 || neighbour.x >= size.x || neighbour.y >= size.y || neighbour.z >= size.z) {
+                                continue;
+                            }
+                            glm::ivec3 chunk = neighbour / ANIMATION_CHUNK;
+                            dirty[chunk.x + (size_t)chunks.x * (chunk.y + (size_t)chunks.y * chunk.z)] = 1;
+                        }
+                    }
+                }
+
+                {
+                    TRACE_SCOPE("Mesh chunks");
+                    rebuild.clear();
+                    for (size_t i = 0; i < chunk_meshes.size(); i++) {
+                        if (dirty[i]) rebuild.push_back(i);
+                        dirty[i] = 0;
+                    }
+                    // A job per chunk, they only read the grid and each writes its own mesh
+                    this->jobs->ParallelFor(rebuild.size(), 1, [&](size_t begin, size_t end) {
+                        for (size_t r = begin; r < end; r++) {
+                            size_t i = rebuild[r];
+                            glm::ivec3 chunk(i % chunks.x, (i / chunks.x) % chunks.y, i / ((size_t)chunks.x * chunks.y));
+                            glm::ivec3 from = chunk * ANIMATION_CHUNK;
+                            MeshPart& mesh = chunk_meshes[i];
+                            mesh.vertices.clear();
+                            mesh.indices.clear();
+                            meshRegion(from, glm::min(from + ANIMATION_CHUNK, size), mesh.vertices, mesh.indices);
+                            if (this->optimize_mesh && !mesh.indices.empty()) optimizeMesh(mesh.vertices, mesh.indices, threadArena());
+                        }
+                    });
+                    rebuilt += rebuild.size();
+                }
+
+                joinParts(chunk_meshes.data(), chunk_meshes.size());
+                {
+                    TRACE_SCOPE("Upload mesh");
+                    ALLOC_PHASE(UPLOAD);
+                    this->buffers->Store(this->meshes[frame], vertices.data(), vertices.size() / VERTEX_STRIDE, indices.data(), indices.size());
+                }
+                if (frame == shown) {
+                    shown_vertices = vertices;
+                    shown_indices = indices;
+                }
+            }
+            this->animation.Seek(this->grid, frames - 1, shown);
+            std::swap(this->vertices, shown_vertices);
+            std::swap(this->indices, shown_indices);
+
+            // Chunks are optimized one by one, so there is no whole-mesh figure from before optimizing
+            this->arena.Reset();
+            this->cache_after = Engine::MeshOptimizer::AnalyzeVertexCache(this->indices, this->vertices.size() / VERTEX_STRIDE,
+                Engine::MeshOptimizer::FIFO_CACHE_SIZE, &this->arena);
+            this->cache_before = this->cache_after;
+            this->mesh_built = true;
+
+            std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            this->logger->Info("Meshed {} frames in {:.2f} ms, {} of {} chunk meshes built", frames, elapsed.count(), rebuilt, frames * chunk_meshes.size());
+        };
 
        public:
+        // Floats per vertex: position (3), palette index (1), normal code (1). Colors are looked up in the
+        // bound palette texture, so recoloring never needs a new mesh.
+        static constexpr int VERTEX_STRIDE = 5;
+        // Edge of the chunks animation frames are meshed in, a frame only re-meshes the chunks its deltas touch
+        static constexpr int ANIMATION_CHUNK = 16;
+
+        // Outward direction of the face a vertex belongs to, from the normal code pushed by PushBlock
+        static glm::vec3 FaceNormal(const GLfloat* vertex) {
+            switch ((int)vertex[4]) {
+                case 1: return glm::vec3(0.0f, 1.0f, 0.0f);
+                case 2: return glm::vec3(0.0f, -1.0f, 0.0f);
+                case 3: return glm::vec3(-1.0f, 0.0f, 0.0f);
+                case 4: return glm::vec3(1.0f, 0.0f, 0.0f);
+                case 5: return glm::vec3(0.0f, 0.0f, -1.0f);
+                case 6: return glm::vec3(0.0f, 0.0f, 1.0f);
+            }
+            return glm::vec3(0.0f);
+        }
+
         std::string name;
         glm::vec3 model_size;
         glm::vec3 position;
         glm::vec3 position_offset;
         glm::vec3 rotation;  // In 90 degree increments
 
-        EntityBase(Utils::Logger& logger) : VAO(), VBO(), EBO() {
+        // Weld and reorder the mesh for the post-transform vertex cache before upload (and export)
+        bool optimize_mesh = true;
+        bool playing = false;
+        float frame_rate = 10.0f;  // Animation frames per second
+        Engine::CacheStats cache_before;
+        Engine::CacheStats cache_after;
+
+        EntityBase(Utils::Logger& logger, Engine::BufferArena& buffers, Engine::JobSystem& jobs) {
             this->logger = &logger;
-            for (int i = 0; i < 256; i++) {
-                this->pallet[i][0] = 0;
-                this->pallet[i][1] = 0;
-                this->pallet[i][2] = 0;
-                this->pallet[i][3] = 0;
-            }
+            this->buffers = &buffers;
+            this->jobs = &jobs;
+            for (int i = 0; i < jobs.ThreadCount(); i++) this->thread_arenas.push_back(std::make_unique<Utils::LoadArena>());
+            this->palette = {};
             vertices = std::vector<GLfloat>();
             indices = std::vector<GLuint>();
-            this->VAO.Bind();
-            this->VAO.LinkAttrib(VBO, 0, 3, GL_FLOAT, 7 * sizeof(GLfloat), (void*)0);
-            this->VAO.LinkAttrib(VBO, 1, 3, GL_FLOAT, 7 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
-            this->VAO.LinkAttrib(VBO, 2, 1, GL_FLOAT, 7 * sizeof(GLfloat), (void*)(6 * sizeof(GLfloat)));
-            this->VAO.Unbind();
         };
 
-        ~EntityBase(){};
+        ~EntityBase() { resizeMeshes(0); };
 
-        void Save() {
-            // Save path is data_path but with .yml instead of .vox
-            std::string save_path = this->model_path;
-            std::string suffix = ".vox";
-            if (save_path.size() >= suffix.size() && save_path.compare(save_path.size() - suffix.size(), suffix.size(), suffix) == 0) {
-                // Replace ".vox" with ".yml"
-                save_path.replace(save_path.size() - suffix.size(), suffix.size(), ".yml");
+        // Position, palette index and face normal, for the BufferArena the meshes are stored in
+        static std::vector<Engine::BufferArena::Attribute> VertexAttributes() {
+            return {{0, 3, GL_FLOAT, 0}, {1, 1, GL_FLOAT, 3 * sizeof(GLfloat)}, {2, 1, GL_FLOAT, 4 * sizeof(GLfloat)}};
+        };
+
+        // Loaded from or saved to a .yml of its own, only then may autosave write to SavePath
+        bool HasDataFile() { return !this->data_path.empty(); }
+        // Makes `yml_path` the file the entity is saved back to, once it has been written there
+        void SetDataPath(const std::string& yml_path) { this->data_path = yml_path; }
+
+        // Back to the .yml the entity came from, otherwise next to the model with .yml instead of .vox or .vxc
+        std::string SavePath() {
+            std::string save_path = this->data_path.empty() ? this->model_path : this->data_path;
+            for (std::string suffix : {".vox", ".vxc"}) {
+                if (save_path.size() >= suffix.size() && save_path.compare(save_path.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                    save_path.replace(save_path.size() - suffix.size(), suffix.size(), ".yml");
+                    break;
+                }
             }
+            return save_path;
+        }
 
+        // The entity settings as YAML, written to SavePath by the caller
+        std::string Serialize() {
             YAML::Node data;
             data["name"] = this->name;
             data["model"] = this->model_path;
@@ -122,10 +568,67 @@ namespace Entity {
             data["rotation"]["x"] = this->rotation.x;
             data["rotation"]["y"] = this->rotation.y;
             data["rotation"]["z"] = this->rotation.z;
-            std::ofstream file(save_path);
-            file << data;
-            file.close();
-            logger->Info(std::format("Saved entity `{}` to `{}`", this->name, save_path));
+            for (const Engine::PaletteVariant& variant : this->variants) {
+                YAML::Node node;
+                node["name"] = variant.name;
+                for (auto& [index, color] : variant.colors) node["colors"][index] = Engine::FormatColor(color);
+                data["variants"].push_back(node);
+            }
+            std::stringstream out;
+            out << data;
+            return out.str();
+        }
+
+        // Whether the settings changed since loading or the last completed write
+        bool Dirty() { return this->name != this->clean_name || this->position_offset != this->clean_offset || this->rotation != this->clean_rotation; }
+        // Whether they changed since the last MarkScheduled, so a write has to be scheduled for them
+        bool Unscheduled() {
+            return this->name != this->scheduled_name || this->position_offset != this->scheduled_offset || this->rotation != this->scheduled_rotation;
+        }
+
+        // Call when the current settings are handed to a write, and MarkWritten once that write completed
+        void MarkScheduled() {
+            this->scheduled_name = this->name;
+            this->scheduled_offset = this->position_offset;
+            this->scheduled_rotation = this->rotation;
+        }
+        void MarkWritten() {
+            this->clean_name = this->scheduled_name;
+            this->clean_offset = this->scheduled_offset;
+            this->clean_rotation = this->scheduled_rotation;
+        }
+
+        // The current settings are the ones in the file, after a load
+        void MarkClean() {
+            MarkScheduled();
+            MarkWritten();
+        }
+
+        // Restores an entity written from Serialize and loads its model, returns false and logs why if the file is unusable
+        bool Load(const std::string& yml_path) {
+            TRACE_SCOPE("Load entity");
+            Engine::EntityFile file;
+            std::string error = Engine::ReadEntityFile(yml_path, file);
+            if (!error.empty()) {
+                logger->Error("`{}`: {}", yml_path, error);
+                return false;
+            }
+            std::string model = Engine::ResolveModelPath(yml_path, file.model);
+            if (file.model.empty() || !std::filesystem::is_regular_file(model)) {
+                logger->Error("`{}`: model `{}` not found", yml_path, file.model);
+                return false;
+            }
+
+            if (!LoadModelForSetup(model)) return false;
+            this->data_path = yml_path;
+            this->name = file.name;
+            this->position_offset = file.position_offset;
+            // Out of range turns are wrapped, `--validate` reports them
+            for (int axis = 0; axis < 3; axis++) this->rotation[axis] = (((int)std::round(file.rotation[axis]) % 4) + 4) % 4;
+            SetVariants(std::move(file.variants));
+            MarkClean();
+            logger->Info("Loaded entity `{}` from `{}`", this->name, yml_path);
+            return true;
         }
 
         void RenderMenu() {
@@ -158,79 +661,34 @@ namespace Entity {
 
         void SetPosition(int x, int y, int z) { this->position = glm::vec3(x, y, z); };
 
-        glm::mat4 createRotationMatrix(float angleX, float angleY, float angleZ) {
-            glm::mat4 rotationX = glm::mat4(1.0f);
-            glm::mat4 rotationY = glm::mat4(1.0f);
-            glm::mat4 rotationZ = glm::mat4(1.0f);
-
-            if (angleX == 90.0f)
-                rotationX = glm::rotate(rotationX, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            else if (angleX == 180.0f)
-                rotationX = glm::rotate(rotationX, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            else if (angleX == 270.0f)
-                rotationX = glm::rotate(rotationX, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-
-            if (angleY == 90.0f)
-                rotationY = glm::rotate(rotationY, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            else if (angleY == 180.0f)
-                rotationY = glm::rotate(rotationY, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            else if (angleY == 270.0f)
-                rotationY = glm::rotate(rotationY, glm::radians(270.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-            if (angleZ == 90.0f)
-                rotationZ = glm::rotate(rotationZ, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            else if (angleZ == 180.0f)
-                rotationZ = glm::rotate(rotationZ, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            else if (angleZ == 270.0f)
-                rotationZ = glm::rotate(rotationZ, glm::radians(270.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-
-            return rotationZ * rotationY * rotationX;  // Order matters
-        }
-
-        glm::vec3 rotatePosition(const glm::vec3& position, float angleX, float angleY, float angleZ) {
-            glm::mat4 rotationMatrix = createRotationMatrix(angleX, angleY, angleZ);
-            glm::vec4 rotatedPosition = rotationMatrix * glm::vec4(position, 1.0f);
-            return glm::vec3(rotatedPosition);
-        }
-
-        glm::mat4 GetModel() {
-            glm::mat4 model = glm::mat4(1.0f);
-            glm::mat4 rotationMatrix = createRotationMatrix(this->rotation.x * 90.0f, this->rotation.y * 90.0f, this->rotation.z * 90.0f);
-            glm::vec3 pos_offset_rotated = rotatePosition(this->position_offset, this->rotation.x * 90.0f, this->rotation.y * 90.0f, this->rotation.z * 90.0f);
-            model = glm::translate(model, this->position + pos_offset_rotated);
-            model = model * rotationMatrix;
-            return model;
-        }
+        // Rotations are whole quarter turns, so the matrix comes from a table instead of glm::rotate
+        glm::mat4 GetModel() { return Engine::TransformSystem::Compose(this->position, this->position_offset, Engine::QuarterTurns::Code(this->rotation)); }
 
         // 1 = up, 2 = down, 3 = left, 4 = right, 5 = front, 6 = back
-        int PushVertex(int x, int y, int z, float r, float g, float b, int n) {
+        int PushVertex(std::vector<GLfloat>& vertices, int x, int y, int z, int index, int n) {
             vertices.push_back(x);
             vertices.push_back(y);
             vertices.push_back(z);
-            vertices.push_back(r);
-            vertices.push_back(g);
-            vertices.push_back(b);
+            vertices.push_back(index);
             vertices.push_back(n);
 
-            return vertices.size() / 7 - 1;
+            return vertices.size() / VERTEX_STRIDE - 1;
         };
 
         // 1 = up, 2 = down, 3 = left, 4 = right, 5 = front, 6 = back
-        void PushBlock(int rx, int ry, int rz, glm::vec3 color) {
-            float r = color.x / 0xFF;
-            float g = color.y / 0xFF;
-            float b = color.z / 0xFF;
+        void PushBlock(std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, int rx, int ry, int rz, int index) {
             int x = rx;
             int y = ry;
             int z = rz;
             int id_1, id_2, id_3, id_4;
+            int faces = exposedFaces(rx, ry, rz);
             // Up side
             // Check if there is a block above
-            if (!(ry < model_size.y - 1 && blocks[rx][ry + 1][rz] == 1)) {
-                id_1 = PushVertex(x, y + 1, z, r, g, b, 1);
-                id_2 = PushVertex(x + 1, y + 1, z, r, g, b, 1);
-                id_3 = PushVertex(x + 1, y + 1, z - 1, r, g, b, 1);
-                id_4 = PushVertex(x, y + 1, z - 1, r, g, b, 1);
+            if (faces & 1 << 0) {
+                id_1 = PushVertex(vertices, x, y + 1, z, index, 1);
+                id_2 = PushVertex(vertices, x + 1, y + 1, z, index, 1);
+                id_3 = PushVertex(vertices, x + 1, y + 1, z - 1, index, 1);
+                id_4 = PushVertex(vertices, x, y + 1, z - 1, index, 1);
 
                 indices.push_back(id_1);
                 indices.push_back(id_2);
@@ -241,11 +699,11 @@ namespace Entity {
             }
 
             // Down side
-            if (!(ry > 0 && blocks[rx][ry - 1][rz] == 1)) {
-                id_1 = PushVertex(x, y, z, r, g, b, 2);
-                id_2 = PushVertex(x + 1, y, z, r, g, b, 2);
-                id_3 = PushVertex(x + 1, y, z - 1, r, g, b, 2);
-                id_4 = PushVertex(x, y, z - 1, r, g, b, 2);
+            if (faces & 1 << 1) {
+                id_1 = PushVertex(vertices, x, y, z, index, 2);
+                id_2 = PushVertex(vertices, x + 1, y, z, index, 2);
+                id_3 = PushVertex(vertices, x + 1, y, z - 1, index, 2);
+                id_4 = PushVertex(vertices, x, y, z - 1, index, 2);
 
                 indices.push_back(id_1);
                 indices.push_back(id_2);
@@ -256,11 +714,11 @@ namespace Entity {
             }
 
             // Right side
-            if (!(rx < model_size.x - 1 && blocks[rx + 1][ry][rz] == 1)) {
-                id_1 = PushVertex(x + 1, y, z, r, g, b, 4);
-                id_2 = PushVertex(x + 1, y, z - 1, r, g, b, 4);
-                id_3 = PushVertex(x + 1, y + 1, z - 1, r, g, b, 4);
-                id_4 = PushVertex(x + 1, y + 1, z, r, g, b, 4);
+            if (faces & 1 << 2) {
+                id_1 = PushVertex(vertices, x + 1, y, z, index, 4);
+                id_2 = PushVertex(vertices, x + 1, y, z - 1, index, 4);
+                id_3 = PushVertex(vertices, x + 1, y + 1, z - 1, index, 4);
+                id_4 = PushVertex(vertices, x + 1, y + 1, z, index, 4);
 
                 indices.push_back(id_1);
                 indices.push_back(id_2);
@@ -271,11 +729,11 @@ namespace Entity {
             }
 
             // Left side
-            if (!(rx > 0 && blocks[rx - 1][ry][rz] == 1)) {
-                id_1 = PushVertex(x, y, z, r, g, b, 3);
-                id_2 = PushVertex(x, y, z - 1, r, g, b, 3);
-                id_3 = PushVertex(x, y + 1, z - 1, r, g, b, 3);
-                id_4 = PushVertex(x, y + 1, z, r, g, b, 3);
+            if (faces & 1 << 3) {
+                id_1 = PushVertex(vertices, x, y, z, index, 3);
+                id_2 = PushVertex(vertices, x, y, z - 1, index, 3);
+                id_3 = PushVertex(vertices, x, y + 1, z - 1, index, 3);
+                id_4 = PushVertex(vertices, x, y + 1, z, index, 3);
 
                 indices.push_back(id_1);
                 indices.push_back(id_2);
@@ -286,11 +744,11 @@ namespace Entity {
             }
 
             // Back side
-            if (!(rz < model_size.z - 1 && blocks[rx][ry][rz + 1] == 1)) {
-                id_1 = PushVertex(x, y, z, r, g, b, 6);
-                id_2 = PushVertex(x + 1, y, z, r, g, b, 6);
-                id_3 = PushVertex(x + 1, y + 1, z, r, g, b, 6);
-                id_4 = PushVertex(x, y + 1, z, r, g, b, 6);
+            if (faces & 1 << 4) {
+                id_1 = PushVertex(vertices, x, y, z, index, 6);
+                id_2 = PushVertex(vertices, x + 1, y, z, index, 6);
+                id_3 = PushVertex(vertices, x + 1, y + 1, z, index, 6);
+                id_4 = PushVertex(vertices, x, y + 1, z, index, 6);
 
                 indices.push_back(id_1);
                 indices.push_back(id_2);
@@ -301,11 +759,11 @@ namespace Entity {
             }
 
             // Front side
-            if (!(rz > 0 && blocks[rx][ry][rz - 1] == 1)) {
-                id_1 = PushVertex(x, y, z - 1, r, g, b, 5);
-                id_2 = PushVertex(x + 1, y, z - 1, r, g, b, 5);
-                id_3 = PushVertex(x + 1, y + 1, z - 1, r, g, b, 5);
-                id_4 = PushVertex(x, y + 1, z - 1, r, g, b, 5);
+            if (faces & 1 << 5) {
+                id_1 = PushVertex(vertices, x, y, z - 1, index, 5);
+                id_2 = PushVertex(vertices, x + 1, y, z - 1, index, 5);
+                id_3 = PushVertex(vertices, x + 1, y + 1, z - 1, index, 5);
+                id_4 = PushVertex(vertices, x, y + 1, z - 1, index, 5);
 
                 indices.push_back(id_1);
                 indices.push_back(id_2);
@@ -316,131 +774,294 @@ namespace Entity {
             }
         };
 
-        void LoadModelForSetup(std::string model_path) {
+        // Starts a new entity from the model at `model_path`. If the file cannot be read the error is logged, false is
+        // returned and the current model stays loaded.
+        bool LoadModelForSetup(std::string model_path) {
+            TRACE_SCOPE("Load model");
+            std::string previous_path = this->model_path;
             this->model_path = model_path;
+            if (!LoadModel()) {
+                this->model_path = previous_path;
+                return false;
+            }
+            this->data_path.clear();
             this->name = "Undefined";
             this->position_offset = glm::vec3(0);
             this->rotation = glm::vec3(0);
-            LoadModel();
-            Triangulate();
+            this->variants.clear();
+            this->variant = 0;
+            MarkClean();
+            rebuild();
+            return true;
         };
 
-        glm::vec3 GetPosition() { return this->position; };
+        // Reads the model file again and rebuilds what the current render mode needs, entity settings are kept.
+        // On a read error the model as it was stays loaded.
+        bool Reload() {
+            if (!LoadModel()) return false;
+            rebuild();
+            return true;
+        };
 
-        void LoadModel() {
-            Reader r(this->logger, this->model_path);
-            std::string magic = r.String(4);
-            if (magic != "VOX ") {
-                this->logger->Fatal(std::format("`{}`: Invalid magic number: `{}` for VOX file", this->model_path, magic));
+        const std::string& GetModelPath() { return this->model_path; };
+
+        // Memory held by the CPU side copies of the model
+        size_t CpuBytes() {
+            size_t bytes = this->vertices.capacity() * sizeof(GLfloat) + this->indices.capacity() * sizeof(GLuint);
+            for (const MeshPart& part : this->mesh_parts) bytes += part.vertices.capacity() * sizeof(GLfloat) + part.indices.capacity() * sizeof(GLuint);
+            for (const auto& arena : this->thread_arenas) bytes += arena->Capacity();
+            return bytes + this->grid.voxels.capacity() + this->animation.Bytes() + this->arena.Capacity();
+        };
+
+        // Reserved by the load arena, and the most a single load or triangulation has used of it
+        size_t ArenaBytes() { return this->arena.Capacity(); };
+        size_t ArenaHighWater() { return this->arena.HighWater(); };
+
+        // Memory uploaded to the GPU for whichever representations are built
+        size_t GpuBytes() {
+            size_t bytes = this->palettes.Count() * sizeof(Engine::PaletteColors);
+            if (this->mesh_built) {
+                for (Engine::BufferArena::Handle mesh : this->meshes) {
+                    const Engine::BufferArena::Range& range = this->buffers->Get(mesh);
+                    bytes += range.vertex_count * VERTEX_STRIDE * sizeof(GLfloat) + range.index_count * sizeof(GLuint);
+                }
+            }
+            if (this->volume_built) {
+                glm::ivec3 size = this->volume.size;
+                glm::ivec3 bricks = this->volume.bricks;
+                bytes += (size_t)size.x * size.y * size.z + (size_t)bricks.x * bricks.y * bricks.z;
             }
+            return bytes;
+        };
 
-            int version = r.Int(4);
-            if (version != 200) {
-                this->logger->Fatal(std::format("`{}`: Unsupported version: `{}`", this->model_path, version));
+        RenderMode GetRenderMode() { return this->render_mode; };
+
+        void SetRenderMode(RenderMode mode) {
+            this->render_mode = mode;
+            auto start = std::chrono::steady_clock::now();
+            if (mode == RenderMode::MESH && !this->mesh_built) {
+                Triangulate();
+            } else if (mode == RenderMode::RAYMARCH && !this->volume_built) {
+                UploadVolume();
+            } else {
+                return;
             }
+            std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            logger->Info("Prepared `{}` for {} rendering in {:.2f} ms", this->model_path, mode == RenderMode::MESH ? "mesh" : "raymarch",
+                elapsed.count());
+        };
 
-            std::string main_chunk_name = r.String(4);
-            if (main_chunk_name != "MAIN") {
-                this->logger->Fatal(std::format("`{}`: Invalid main chunk name: `{}`", this->model_path, main_chunk_name));
+        glm::vec3 GetPosition() { return this->position; };
+
+        // Reads the model file into the grid, or logs why it cannot and leaves everything as it was
+        bool LoadModel() {
+            this->arena.Reset();
+            if (std::filesystem::path(this->model_path).extension() == ".vxc") {
+                std::string error = readVxc();
+                if (!error.empty()) {
+                    logger->Error("`{}`: {}", this->model_path, error);
+                    return false;
+                }
+            } else {
+                std::pmr::vector<RawVoxel> voxels(&this->arena);
+                std::pmr::vector<RawFrame> frames(&this->arena);
+                Engine::PaletteColors palette = this->palette;
+                glm::vec3 model_size;
+                std::string error = readModel(voxels, frames, palette, model_size);
+                if (!error.empty()) {
+                    logger->Error("`{}`: {}", this->model_path, error);
+                    return false;
+                }
+                this->palette = palette;
+                this->model_size = model_size;
+                buildGrid(voxels, frames);
             }
-            int main_chunk_size = r.Int(4);
-            int remaining_file = r.Int(4);
-            if (main_chunk_size != 0) {
-                this->logger->Fatal(std::format("`{}`: Incorrect main chunk size: `{}`", this->model_path, main_chunk_size));
+            logger->Info("Loaded entity: `{}`", this->name);
+            return true;
+        };
+
+        void Triangulate() {
+            TRACE_SCOPE("Triangulate");
+            ALLOC_PHASE(MESH);
+            if (this->animation.FrameCount() > 1) {
+                triangulateFrames();
+                return;
+            }
+            this->arena.Reset();
+            vertices.clear();
+            indices.clear();
+            {
+                TRACE_SCOPE("Mesh");
+                meshSlabs();
             }
 
-            while (r.cursor < remaining_file + 5 * 4) {
-                std::string chunk_name = r.String(4);
-                int chunk_size = r.Int(4);
-                int child_size = r.Int(4);
-                if (chunk_name == "SIZE") {
-                    this->model_size = glm::vec3(r.Int(4), r.Int(4), r.Int(4));
-                } else if (chunk_name == "PACK") {
-                    int model_amount = r.Int(4);
-                    if (model_amount != 1) {
-                        logger->Warn(std::format("`{}`: Model amount is not 1: `{}`. Model loading may malfunction.", this->model_path, model_amount));
-                    }
-                } else if (chunk_name == "RGBA") {
-                    if (chunk_size != 1024) {
-                        logger->Fatal(std::format("`{}`: Invalid RGBA chunk size: `{}`", this->model_path, chunk_size));
-                    }
-                    for (int i = 0; i < 256; i++) {
-                        this->pallet[i][0] = r.UByte();
-                        this->pallet[i][1] = r.UByte();
-                        this->pallet[i][2] = r.UByte();
-                        this->pallet[i][3] = r.UByte();
-                    }
-                } else if (chunk_name == "XYZI") {
-                    this->voxel_amount = r.Int(4);
-                    for (int i = 0; i < voxel_amount; i++) {
-                        glm::vec4 voxel = glm::vec4(r.UByte(), r.UByte(), r.UByte(), r.UByte());
-                        this->voxels.push_back(voxel);
-                    }
-                } else {
-                    this->logger->Warn(std::format("`{}`: Skipping unknown chunk: `{}` (`{}` + `{}`)", this->model_path, chunk_name, chunk_size, child_size));
-                    r.cursor += chunk_size;
-                }
+            this->cache_before = Engine::MeshOptimizer::AnalyzeVertexCache(this->indices, this->vertices.size() / VERTEX_STRIDE,
+                Engine::MeshOptimizer::FIFO_CACHE_SIZE, &this->arena);
+            if (this->optimize_mesh) {
+                OptimizeMesh();
+                this->cache_after = Engine::MeshOptimizer::AnalyzeVertexCache(this->indices, this->vertices.size() / VERTEX_STRIDE,
+                    Engine::MeshOptimizer::FIFO_CACHE_SIZE, &this->arena);
+            } else {
+                this->cache_after = this->cache_before;
             }
 
-            blocks.resize(model_size.x);
-            for (int x = 0; x < model_size.x; x++) {
-                blocks[x].resize(model_size.y);
-                for (int y = 0; y < model_size.y; y++) {
-                    blocks[x][y].resize(model_size.z);
-                }
+            TRACE_SCOPE("Upload mesh");
+            ALLOC_PHASE(UPLOAD);
+            resizeMeshes(1);
+            this->buffers->Store(this->meshes[0], this->vertices.data(), this->vertices.size() / VERTEX_STRIDE, this->indices.data(), this->indices.size());
+            this->mesh_built = true;
+        };
+
+        // Uploads the palette indices as they are, no triangulation involved
+        void UploadVolume() {
+            TRACE_SCOPE("Upload volume");
+            ALLOC_PHASE(UPLOAD);
+            this->volume.Upload(this->grid.voxels, this->grid.size);
+            this->volume_built = true;
+        };
+
+        // The palette indices of the model at the current animation frame, x fastest
+        const Engine::VoxelGrid& Grid() { return this->grid; };
+
+        // 1 for a model that is not animated
+        int FrameCount() { return std::max(this->animation.FrameCount(), 1); };
+        int Frame() { return this->frame; };
+
+        // Every frame's mesh is uploaded by Triangulate, so in mesh mode this only changes which one is drawn.
+        // The grid is stepped through the deltas in between, and a built volume is uploaded again.
+        void SetFrame(int frame) {
+            frame = std::clamp(frame, 0, FrameCount() - 1);
+            if (frame == this->frame) return;
+            this->animation.Seek(this->grid, this->frame, frame);
+            this->frame = frame;
+            if (this->render_mode == RenderMode::RAYMARCH && this->volume_built) {
+                UploadVolume();
+            } else {
+                this->volume_built = false;
             }
+        };
 
-            for (int x = 0; x < model_size.x; x++) {
-                for (int y = 0; y < model_size.y; y++) {
-                    for (int z = 0; z < model_size.z; z++) {
-                        blocks[x][y][z] = 0;
-                    }
-                }
+        // Calls `body` with the grid at every animation frame in order, the current frame is restored afterwards
+        void ForEachFrame(const std::function<void(const Engine::VoxelGrid&)>& body) {
+            int shown = this->frame;
+            this->animation.Seek(this->grid, shown, 0);
+            for (int frame = 0; frame < FrameCount(); frame++) {
+                this->animation.Seek(this->grid, frame - 1, frame);
+                body(this->grid);
             }
+            this->animation.Seek(this->grid, FrameCount() - 1, shown);
+        };
 
-            for (int i = 0; i < voxels.size(); i++) {
-                if (voxels[i].x >= model_size.x || voxels[i].y >= model_size.y || voxels[i].z >= model_size.z) {
-                    logger->Warn(std::format("Voxel out of bounds: `{}`, `{}`, `{}`", voxels[i].x, voxels[i].y, voxels[i].z));
-                    continue;
-                }
-                blocks[voxels[i].x][voxels[i].y][voxels[i].z] = voxels[i].w;
+        // Writes the model with all its frames, as .vxc or as .vox by the extension of `path`. Returns an
+        // empty string on success, otherwise what went wrong.
+        std::string SaveModel(const std::string& path) {
+            TRACE_SCOPE("Save model");
+            glm::ivec3 size = this->grid.size;
+            std::string bytes;
+            if (std::filesystem::path(path).extension() == ".vxc") {
+                Engine::VxcEncoder encoder(size, this->palette, FrameCount());
+                ForEachFrame([&](const Engine::VoxelGrid& grid) { encoder.AddFrame(grid); });
+                bytes = encoder.Bytes();
+            } else {
+                int largest = std::max(size.x, std::max(size.y, size.z));
+                if (largest > Engine::VoxEncoder::MAX_SIZE) return std::format("{}x{}x{} does not fit in a .vox", size.x, size.y, size.z);
+                Engine::VoxEncoder encoder(FrameCount());
+                ForEachFrame([&](const Engine::VoxelGrid& grid) { encoder.AddFrame(grid); });
+                bytes = encoder.Finish(this->palette);
             }
+            return Utils::WriteFileAtomic(path, bytes);
+        };
 
-            logger->Info(std::format("Loaded entity: `{}`", this->name));
+        // Moves the animation on by `seconds` while playing, returns whether the frame changed
+        bool AdvanceAnimation(float seconds) {
+            if (!this->playing || FrameCount() <= 1 || this->frame_rate <= 0.0f) return false;
+            this->frame_time += seconds;
+            float frame_length = 1.0f / this->frame_rate;
+            if (this->frame_time < frame_length) return false;
+            int steps = (int)(this->frame_time / frame_length);
+            this->frame_time -= steps * frame_length;
+            SetFrame((this->frame + steps) % FrameCount());
+            return true;
         };
 
-        void Triangulate() {
-            vertices.clear();
-            indices.clear();
-            for (int x = 0; x < model_size.x; x++) {
-                for (int y = 0; y < model_size.y; y++) {
-                    for (int z = 0; z < model_size.z; z++) {
-                        if (blocks[x][y][z] != 0) {
-                            PushBlock(x, y, z, glm::vec3(pallet[blocks[x][y][z]][0], pallet[blocks[x][y][z]][1], pallet[blocks[x][y][z]][2]));
-                        }
+        // Rotates the voxels themselves by the entity's rotation, which becomes zero. The offset
+        // is adjusted so the entity stays exactly where it was previewed, see RotateGrid.
+        // Only meant for exports: the model file on disk keeps its original orientation.
+        void BakeTransform() {
+            TRACE_SCOPE("Bake transform");
+            uint8_t code = Engine::QuarterTurns::Code(this->rotation);
+            Engine::VoxelGrid baked;
+            glm::vec3 translation = Engine::RotateGrid(this->grid, code, baked, this->jobs);
+            if (this->animation.FrameCount() > 1) {
+                // Every frame is rotated and diffed again, they all share one size so the translation is the same
+                Engine::VoxelAnimation rotated;
+                Engine::VoxelGrid previous;
+                Engine::VoxelGrid current;
+                this->animation.Seek(this->grid, this->frame, 0);
+                for (int frame = 0; frame < this->animation.FrameCount(); frame++) {
+                    this->animation.Seek(this->grid, frame - 1, frame);
+                    Engine::RotateGrid(this->grid, code, current, this->jobs);
+                    if (frame == 0) {
+                        rotated.Begin(current);
+                    } else {
+                        rotated.AddFrame(previous, current);
                     }
+                    std::swap(previous, current);
                 }
+                this->animation.Seek(this->grid, this->animation.FrameCount() - 1, this->frame);
+                this->animation = std::move(rotated);
             }
+            glm::mat4 rotation = Engine::TransformSystem::Compose(glm::vec3(0.0f), glm::vec3(0.0f), code);
+            this->position_offset = glm::vec3(rotation * glm::vec4(this->position_offset, 0.0f)) - translation;
+            this->rotation = glm::vec3(0.0f);
 
-            GLfloat vertices_array[this->vertices.size()];
-            for (size_t i = 0; i < this->vertices.size(); i++) {
-                vertices_array[i] = this->vertices[i];
-            }
-            GLuint indices_array[this->indices.size()];
-            for (size_t i = 0; i < this->indices.size(); i++) {
-                indices_array[i] = this->indices[i];
-            }
-            this->indices_size = sizeof(indices_array);
-            VAO.Bind();
-            VBO.Update(vertices_array, sizeof(vertices_array));
-            EBO.Update(indices_array, sizeof(indices_array));
-            VAO.Unbind();
+            this->model_size = glm::vec3(baked.size);
+            std::swap(this->grid, baked);
+            this->mesh_built = false;
+            this->volume_built = false;
+            SetRenderMode(this->render_mode);
         };
 
+        // Every face pushes its own four vertices, so they are welded first to give the cache something to reuse
+        void OptimizeMesh() { optimizeMesh(this->vertices, this->indices, &this->arena); };
+
         void Render() {
-            VAO.Bind();
-            glDrawElements(GL_TRIANGLES, this->indices_size, GL_UNSIGNED_INT, 0);
-            VAO.Unbind();
+            const Engine::BufferArena::Range& range = MeshRange();
+            this->buffers->VAO.Bind();
+            glDrawElementsBaseVertex(GL_TRIANGLES, range.index_count, GL_UNSIGNED_INT, (const void*)range.IndexOffset(), range.base_vertex);
+            this->buffers->VAO.Unbind();
+        };
+
+        GLsizei IndexCount() { return MeshRange().index_count; };
+        // Where the current frame's mesh is in the shared buffers, it moves when they are compacted
+        const Engine::BufferArena::Range& MeshRange() { return this->buffers->Get(this->frame < (int)this->meshes.size() ? this->meshes[this->frame] : 0); };
+
+        // The model's palette as read from the VOX file, and its named variants
+        const Engine::PaletteColors& Palette() { return this->palette; };
+        const std::vector<Engine::PaletteVariant>& Variants() { return this->variants; };
+
+        // Replaces the variants and uploads their palettes, the mesh is left alone
+        void SetVariants(std::vector<Engine::PaletteVariant> variants) {
+            this->variants = std::move(variants);
+            this->palettes.Upload(this->palette, this->variants);
+            if (this->variant > (int)this->variants.size()) this->variant = 0;
         };
+
+        int Variant() { return this->variant; };
+        // "Model palette" for 0
+        std::string VariantName(int variant) { return variant > 0 && variant <= (int)this->variants.size() ? this->variants[variant - 1].name : "Model palette"; };
+        void SetVariant(int variant) { this->variant = variant >= 0 && variant <= (int)this->variants.size() ? variant : 0; };
+        void NextVariant() { this->variant = (this->variant + 1) % (this->variants.size() + 1); };
+
+        // Binds the selected palette to Engine::PaletteSet::TEXTURE_UNIT, for either render mode
+        void BindPalette() { this->palettes.Bind(this->variant); };
+
+        // The CPU copy of the mesh as last triangulated, of the frame shown at the time for an animation. VERTEX_STRIDE floats per vertex
+        const std::vector<GLfloat>& Vertices() { return this->vertices; };
+        const std::vector<GLuint>& Indices() { return this->indices; };
+
+        Engine::VAO& GetVAO() { return this->buffers->VAO; };
+
+        Engine::VoxelVolume& GetVolume() { return this->volume; };
     };
 }  // namespace Entity
@@ -2,13 +2,19 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cctype>
+#include <cstdint>
 #include <cstring>
 #include <filesystem>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 #ifndef IMGUI_VERSION
@@ -47,6 +53,8 @@ namespace ImGui
 
         FileBrowser &operator=(const FileBrowser &copyFrom);
 
+        ~FileBrowser();
+
         // set the window position (in pixels)
         // default is centered
         void SetWindowPos(int posX, int posY) noexcept;
@@ -116,6 +124,18 @@ namespace ImGui
         // this function will pre-fill the input dialog with a filename.
         void SetInputName(std::string_view input);
 
+        // show extra columns next to the name of every regular file.
+        // `draw` is called with the file's full path and the column index
+        // inside the table cell. `rowHeight` reserves room for images
+        void SetFileColumns(
+            std::vector<std::string> headers,
+            std::function<void(const std::filesystem::path &, int)> draw,
+            float rowHeight = 0.0f);
+
+        // a directory is being scanned in the background. the listing grows
+        // while this is true, so the host should keep drawing frames
+        bool IsScanning() const noexcept;
+
     private:
 
         static constexpr size_t INPUT_NAME_BUF_SIZE = 512;
@@ -141,9 +161,47 @@ namespace ImGui
             std::filesystem::path extension;
         };
 
+        // directory listings are produced by a worker thread. it hands records
+        // over in batches through `pending`, and stops early once `cancel` is
+        // set because the user navigated elsewhere. the worker owns a reference,
+        // so an abandoned scan can finish on its own
+        struct ScanState
+        {
+            std::filesystem::path           directory;
+            std::filesystem::file_time_type modifiedTime;
+            std::atomic<bool>               cancel = false;
+
+            std::mutex              mutex;
+            std::vector<FileRecord> pending;
+            bool                    done = false;
+            std::string             error;
+        };
+
+        struct DirectoryCache
+        {
+            std::filesystem::file_time_type modifiedTime;
+            std::vector<FileRecord>         records;
+            uint64_t                        lastUse; // directoryCacheClock_ when it was last stored or shown
+        };
+
+        static constexpr size_t SCAN_BATCH_SIZE = 256;
+        static constexpr size_t MAX_CACHED_DIRECTORIES = 64;
+
         static std::string ToLower(const std::string &s);
 
-        void UpdateFileRecords();
+        static bool IsRecordLess(const FileRecord &L, const FileRecord &R);
+
+        static void ScanDirectory(std::shared_ptr<ScanState> scan, ImGuiFileBrowserFlags flags);
+
+        // uses the cached listing when the directory's mtime is unchanged, unless `forceRescan`
+        void UpdateFileRecords(bool forceRescan = false);
+
+        void CancelScan();
+
+        // merges records delivered by the worker, called every frame
+        void PollScan();
+
+        void UpdateVisibleRecords();
 
         void SetCurrentDirectoryUncatched(const std::filesystem::path &pwd);
 
@@ -189,6 +247,16 @@ namespace ImGui
         unsigned int rangeSelectionStart_; // enable range selection when shift is pressed
 
         std::vector<FileRecord> fileRecords_;
+        std::vector<unsigned int> visibleRecords_; // indices into fileRecords_ that pass the filters
+        bool visibleRecordsDirty_;
+
+        std::vector<std::string> columnHeaders_;
+        std::function<void(const std::filesystem::path &, int)> columnDraw_;
+        float columnRowHeight_;
+
+        std::shared_ptr<ScanState> scan_;
+        std::map<std::filesystem::path, DirectoryCache> directoryCache_;
+        uint64_t directoryCacheClock_;
 
         // IMPROVE: truncate when selectedFilename_.length() > inputNameBuf_.size() - 1
         std::unique_ptr<InputNameBuffer> inputNameBuf_;
@@ -215,6 +283,9 @@ inline ImGui::FileBrowser::FileBrowser(ImGuiFileBrowserFlags flags, std::filesys
     , isOk_(false)
     , isPosSet_(false)
     , rangeSelectionStart_(0)
+    , visibleRecordsDirty_(true)
+    , columnRowHeight_(0.0f)
+    , directoryCacheClock_(0)
     , inputNameBuf_(std::make_unique<InputNameBuffer>())
 {
     if(flags_ & ImGuiFileBrowserFlags_CreateNewDir)
@@ -270,7 +341,15 @@ inline ImGui::FileBrowser &ImGui::FileBrowser::operator=(
     selectedFilenames_   = copyFrom.selectedFilenames_;
     rangeSelectionStart_ = copyFrom.rangeSelectionStart_;
 
+    CancelScan();
     fileRecords_ = copyFrom.fileRecords_;
+    visibleRecordsDirty_ = true;
+    directoryCache_ = copyFrom.directoryCache_;
+    directoryCacheClock_ = copyFrom.directoryCacheClock_;
+
+    columnHeaders_ = copyFrom.columnHeaders_;
+    columnDraw_ = copyFrom.columnDraw_;
+    columnRowHeight_ = copyFrom.columnRowHeight_;
 
     *inputNameBuf_ = *copyFrom.inputNameBuf_;
 
@@ -288,6 +367,11 @@ inline ImGui::FileBrowser &ImGui::FileBrowser::operator=(
     return *this;
 }
 
+inline ImGui::FileBrowser::~FileBrowser()
+{
+    CancelScan();
+}
+
 inline void ImGui::FileBrowser::SetWindowPos(int posX, int posY) noexcept
 {
     posX_ = posX;
@@ -381,6 +465,8 @@ inline void ImGui::FileBrowser::Display()
     isOpened_ = true;
     ScopeGuard endPopup([] { EndPopup(); });
 
+    PollScan();
+
     // display elements in pwd
 
 #ifdef _WIN32
@@ -467,7 +553,7 @@ inline void ImGui::FileBrowser::Display()
 
     if(SmallButton("*"))
     {
-        UpdateFileRecords();
+        UpdateFileRecords(true);
 
         std::set<std::filesystem::path> newSelectedFilenames;
         for(auto &name : selectedFilenames_)
@@ -512,7 +598,7 @@ inline void ImGui::FileBrowser::Display()
                 ScopeGuard closeNewDirPopup([] { CloseCurrentPopup(); });
                 if(create_directory(currentDirectory_ / newDirNameBuf_->data()))
                 {
-                    UpdateFileRecords();
+                    UpdateFileRecords(true);
                 }
                 else
                 {
@@ -536,116 +622,143 @@ inline void ImGui::FileBrowser::Display()
                    (flags_ & ImGuiFileBrowserFlags_NoModal) ? ImGuiWindowFlags_AlwaysHorizontalScrollbar : 0);
         ScopeGuard endChild([] { EndChild(); });
 
-        const bool shouldHideRegularFiles =
-            (flags_ & ImGuiFileBrowserFlags_HideRegularFiles) && (flags_ & ImGuiFileBrowserFlags_SelectDirectory);
+        UpdateVisibleRecords();
 
-        for(unsigned int rscIndex = 0; rscIndex < fileRecords_.size(); ++rscIndex)
+        const bool hasColumns = columnDraw_ && !columnHeaders_.empty();
+        const int columnCount = hasColumns ? static_cast<int>(columnHeaders_.size()) + 1 : 1;
+        // a clipped table submits no rows
+        const bool tableOpen = hasColumns && BeginTable("files", columnCount, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit);
+        ScopeGuard endTable([&] { if(tableOpen) EndTable(); });
+        if(tableOpen)
         {
-            const auto &rsc = fileRecords_[rscIndex];
-            if(!rsc.isDir && shouldHideRegularFiles)
-            {
-                continue;
-            }
-            if(!rsc.isDir && !IsExtensionMatched(rsc.extension))
-            {
-                continue;
-            }
-            if(!rsc.name.empty() && rsc.name.c_str()[0] == '$')
+            TableSetupColumn("name", ImGuiTableColumnFlags_WidthStretch);
+            for(auto &header : columnHeaders_)
             {
-                continue;
+                TableSetupColumn(header.c_str());
             }
+            TableHeadersRow();
+        }
 
-            const bool selected = selectedFilenames_.find(rsc.name) != selectedFilenames_.end();
-            if(Selectable(rsc.showName.c_str(), selected, ImGuiSelectableFlags_DontClosePopups))
+        // only rows inside the scrolled region are submitted
+        ImGuiListClipper clipper;
+        clipper.Begin(hasColumns && !tableOpen ? 0 : static_cast<int>(visibleRecords_.size()));
+        while(clipper.Step())
+        {
+            for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
             {
-                const bool wantDir = flags_ & ImGuiFileBrowserFlags_SelectDirectory;
-                const bool canSelect = rsc.name != ".." && rsc.isDir == wantDir;
-                const bool rangeSelect =
-                    canSelect && GetIO().KeyShift &&
-                    rangeSelectionStart_ < fileRecords_.size() &&
-                    (flags_ & ImGuiFileBrowserFlags_MultipleSelection) &&
-                    IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
-                const bool multiSelect =
-                    !rangeSelect && GetIO().KeyCtrl &&
-                    (flags_ & ImGuiFileBrowserFlags_MultipleSelection) &&
-                    IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
-
-                if(rangeSelect)
+                const unsigned int rscIndex = visibleRecords_[row];
+                const auto &rsc = fileRecords_[rscIndex];
+
+                if(hasColumns)
                 {
-                    const unsigned int first = (std::min)(rangeSelectionStart_, rscIndex);
-                    const unsigned int last = (std::max)(rangeSelectionStart_, rscIndex);
-                    selectedFilenames_.clear();
-                    for(unsigned int i = first; i <= last; ++i)
+                    TableNextRow(0, columnRowHeight_);
+                    TableSetColumnIndex(0);
+                }
+
+                const bool selected = selectedFilenames_.find(rsc.name) != selectedFilenames_.end();
+                const ImGuiSelectableFlags selectableFlags =
+                    ImGuiSelectableFlags_DontClosePopups | (hasColumns ? ImGuiSelectableFlags_SpanAllColumns : 0);
+                if(Selectable(rsc.showName.c_str(), selected, selectableFlags, ImVec2(0, hasColumns ? columnRowHeight_ : 0.0f)))
+                {
+                    const bool wantDir = flags_ & ImGuiFileBrowserFlags_SelectDirectory;
+                    const bool canSelect = rsc.name != ".." && rsc.isDir == wantDir;
+                    const bool rangeSelect =
+                        canSelect && GetIO().KeyShift &&
+                        rangeSelectionStart_ < fileRecords_.size() &&
+                        (flags_ & ImGuiFileBrowserFlags_MultipleSelection) &&
+                        IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
+                    const bool multiSelect =
+                        !rangeSelect && GetIO().KeyCtrl &&
+                        (flags_ & ImGuiFileBrowserFlags_MultipleSelection) &&
+                        IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
+
+                    if(rangeSelect)
+                    {
+                        const unsigned int first = (std::min)(rangeSelectionStart_, rscIndex);
+                        const unsigned int last = (std::max)(rangeSelectionStart_, rscIndex);
+                        selectedFilenames_.clear();
+                        for(unsigned int i = first; i <= last; ++i)
+                        {
+                            if(fileRecords_[i].isDir != wantDir)
+                            {
+                                continue;
+                            }
+                            if(!wantDir && !IsExtensionMatched(fileRecords_[i].extension))
+                            {
+                                continue;
+                            }
+                            selectedFilenames_.insert(fileRecords_[i].name);
+                        }
+                    }
+                    else if(selected)
                     {
-                        if(fileRecords_[i].isDir != wantDir)
+                        if(!multiSelect)
                         {
-                            continue;
+                            selectedFilenames_ = { rsc.name };
+                            rangeSelectionStart_ = rscIndex;
                         }
-                        if(!wantDir && !IsExtensionMatched(fileRecords_[i].extension))
+                        else
                         {
-                            continue;
+                            selectedFilenames_.erase(rsc.name);
                         }
-                        selectedFilenames_.insert(fileRecords_[i].name);
+                        (*inputNameBuf_)[0] = '\0';
                     }
-                }
-                else if(selected)
-                {
-                    if(!multiSelect)
+                    else if(canSelect)
                     {
-                        selectedFilenames_ = { rsc.name };
+                        if(multiSelect)
+                        {
+                            selectedFilenames_.insert(rsc.name);
+                        }
+                        else
+                        {
+                            selectedFilenames_ = { rsc.name };
+                        }
+                        if(!(flags_ & ImGuiFileBrowserFlags_SelectDirectory))
+                        {
+#ifdef _MSC_VER
+                            strcpy_s(
+                                inputNameBuf_->data(), inputNameBuf_->size(), u8StrToStr(rsc.name.u8string()).c_str());
+#else
+                            std::strncpy(
+                                inputNameBuf_->data(), u8StrToStr(rsc.name.u8string()).c_str(), inputNameBuf_->size() - 1);
+#endif
+                        }
                         rangeSelectionStart_ = rscIndex;
                     }
                     else
                     {
-                        selectedFilenames_.erase(rsc.name);
+                        if(!multiSelect)
+                        {
+                            selectedFilenames_.clear();
+                        }
                     }
-                    (*inputNameBuf_)[0] = '\0';
                 }
-                else if(canSelect)
+
+                if(IsItemClicked(0) && IsMouseDoubleClicked(0))
                 {
-                    if(multiSelect)
+                    if(rsc.isDir)
                     {
-                        selectedFilenames_.insert(rsc.name);
+                        shouldSetNewDir = true;
+                        newDir = (rsc.name != "..") ? (currentDirectory_ / rsc.name) : currentDirectory_.parent_path();
                     }
-                    else
+                    else if(!(flags_ & ImGuiFileBrowserFlags_SelectDirectory))
                     {
                         selectedFilenames_ = { rsc.name };
+                        isOk_ = true;
+                        CloseCurrentPopup();
                     }
-                    if(!(flags_ & ImGuiFileBrowserFlags_SelectDirectory))
-                    {
-#ifdef _MSC_VER
-                        strcpy_s(
-                            inputNameBuf_->data(), inputNameBuf_->size(), u8StrToStr(rsc.name.u8string()).c_str());
-#else
-                        std::strncpy(
-                            inputNameBuf_->data(), u8StrToStr(rsc.name.u8string()).c_str(), inputNameBuf_->size() - 1);
-#endif
-                    }
-                    rangeSelectionStart_ = rscIndex;
                 }
-                else
+
+                if(hasColumns && !rsc.isDir)
                 {
-                    if(!multiSelect)
+                    const auto path = currentDirectory_ / rsc.name;
+                    for(int column = 1; column < columnCount; ++column)
                     {
-                        selectedFilenames_.clear();
+                        TableSetColumnIndex(column);
+                        columnDraw_(path, column - 1);
                     }
                 }
             }
-
-            if(IsItemClicked(0) && IsMouseDoubleClicked(0))
-            {
-                if(rsc.isDir)
-                {
-                    shouldSetNewDir = true;
-                    newDir = (rsc.name != "..") ? (currentDirectory_ / rsc.name) : currentDirectory_.parent_path();
-                }
-                else if(!(flags_ & ImGuiFileBrowserFlags_SelectDirectory))
-                {
-                    selectedFilenames_ = { rsc.name };
-                    isOk_ = true;
-                    CloseCurrentPopup();
-                }
-            }
         }
     }
 
@@ -728,6 +841,12 @@ inline void ImGui::FileBrowser::Display()
         Text("%s", statusStr_.c_str());
     }
 
+    if(scan_ && !(flags_ & ImGuiFileBrowserFlags_NoStatusBar))
+    {
+        SameLine();
+        Text("scanning... %zu entries", fileRecords_.size() - 1);
+    }
+
     if(!typeFilters_.empty())
     {
         SameLine();
@@ -743,6 +862,7 @@ inline void ImGui::FileBrowser::Display()
                 if(Selectable(typeFilters_[i].c_str(), selected) && !selected)
                 {
                     typeFilterIndex_ = static_cast<unsigned int>(i);
+                    visibleRecordsDirty_ = true;
                 }
             }
         }
@@ -869,11 +989,13 @@ inline void ImGui::FileBrowser::SetTypeFilters(const std::vector<std::string> &_
 
     std::copy(typeFilters.begin(), typeFilters.end(), std::back_inserter(typeFilters_));
     typeFilterIndex_ = 0;
+    visibleRecordsDirty_ = true;
 }
 
 inline void ImGui::FileBrowser::SetCurrentTypeFilterIndex(int index)
 {
     typeFilterIndex_ = static_cast<unsigned int>(index);
+    visibleRecordsDirty_ = true;
 }
 
 inline void ImGui::FileBrowser::SetInputName(std::string_view input)
@@ -901,57 +1023,213 @@ inline std::string ImGui::FileBrowser::ToLower(const std::string &s)
     return ret;
 }
 
-inline void ImGui::FileBrowser::UpdateFileRecords()
+inline void ImGui::FileBrowser::SetFileColumns(
+    std::vector<std::string> headers,
+    std::function<void(const std::filesystem::path &, int)> draw,
+    float rowHeight)
 {
-    fileRecords_ = { FileRecord{ true, "..", "[D] ..", "" } };
+    columnHeaders_ = std::move(headers);
+    columnDraw_ = std::move(draw);
+    columnRowHeight_ = rowHeight;
+}
 
-    for(auto &p : std::filesystem::directory_iterator(currentDirectory_))
-    {
-        FileRecord rcd;
+inline bool ImGui::FileBrowser::IsScanning() const noexcept
+{
+    return scan_ != nullptr;
+}
+
+inline bool ImGui::FileBrowser::IsRecordLess(const FileRecord &L, const FileRecord &R)
+{
+    return (L.isDir ^ R.isDir) ? L.isDir : (L.name < R.name);
+}
 
-        try
+inline void ImGui::FileBrowser::ScanDirectory(std::shared_ptr<ScanState> scan, ImGuiFileBrowserFlags flags)
+{
+    std::vector<FileRecord> batch;
+    try
+    {
+        for(auto &p : std::filesystem::directory_iterator(scan->directory))
         {
-            if(p.is_regular_file())
+            if(scan->cancel)
             {
-                rcd.isDir = false;
+                return;
             }
-            else if(p.is_directory())
+
+            FileRecord rcd;
+
+            try
             {
-                rcd.isDir = true;
+                if(p.is_regular_file())
+                {
+                    rcd.isDir = false;
+                }
+                else if(p.is_directory())
+                {
+                    rcd.isDir = true;
+                }
+                else
+                {
+                    continue;
+                }
+
+                rcd.name = p.path().filename();
+                if(rcd.name.empty())
+                {
+                    continue;
+                }
+
+                rcd.extension = p.path().filename().extension();
+                rcd.showName = (rcd.isDir ? "[D] " : "[F] ") + u8StrToStr(p.path().filename().u8string());
             }
-            else
+            catch(...)
             {
+                if(!(flags & ImGuiFileBrowserFlags_SkipItemsCausingError))
+                {
+                    throw;
+                }
                 continue;
             }
 
-            rcd.name = p.path().filename();
-            if(rcd.name.empty())
+            batch.push_back(std::move(rcd));
+            if(batch.size() >= SCAN_BATCH_SIZE)
             {
-                continue;
+                std::lock_guard<std::mutex> lock(scan->mutex);
+                std::move(batch.begin(), batch.end(), std::back_inserter(scan->pending));
+                batch.clear();
             }
+        }
+    }
+    catch(const std::exception &err)
+    {
+        std::lock_guard<std::mutex> lock(scan->mutex);
+        scan->error = std::string("last error: ") + err.what();
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> lock(scan->mutex);
+        scan->error = "last error: unknown";
+    }
+
+    std::lock_guard<std::mutex> lock(scan->mutex);
+    std::move(batch.begin(), batch.end(), std::back_inserter(scan->pending));
+    scan->done = true;
+}
+
+inline void ImGui::FileBrowser::UpdateFileRecords(bool forceRescan)
+{
+    CancelScan();
+    fileRecords_ = { FileRecord{ true, "..", "[D] ..", "" } };
+    visibleRecordsDirty_ = true;
+
+    std::error_code ec;
+    const auto modifiedTime = std::filesystem::last_write_time(currentDirectory_, ec);
+
+    const auto cached = directoryCache_.find(currentDirectory_);
+    if(!forceRescan && !ec && cached != directoryCache_.end() && cached->second.modifiedTime == modifiedTime)
+    {
+        cached->second.lastUse = ++directoryCacheClock_;
+        fileRecords_.insert(fileRecords_.end(), cached->second.records.begin(), cached->second.records.end());
+        ClearRangeSelectionState();
+        return;
+    }
+    if(cached != directoryCache_.end())
+    {
+        directoryCache_.erase(cached);
+    }
 
-            rcd.extension = p.path().filename().extension();
-            rcd.showName = (rcd.isDir ? "[D] " : "[F] ") + u8StrToStr(p.path().filename().u8string());
+    scan_ = std::make_shared<ScanState>();
+    scan_->directory = currentDirectory_;
+    // without an mtime the listing cannot be validated later, so it will not be cached
+    scan_->modifiedTime = ec ? std::filesystem::file_time_type::min() : modifiedTime;
+    std::thread(ScanDirectory, scan_, flags_).detach();
+    ClearRangeSelectionState();
+}
+
+inline void ImGui::FileBrowser::CancelScan()
+{
+    if(scan_)
+    {
+        scan_->cancel = true;
+        scan_.reset();
+    }
+}
+
+inline void ImGui::FileBrowser::PollScan()
+{
+    if(!scan_)
+    {
+        return;
+    }
+
+    std::vector<FileRecord> arrived;
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(scan_->mutex);
+        arrived.swap(scan_->pending);
+        done = scan_->done;
+        if(!scan_->error.empty())
+        {
+            statusStr_ = scan_->error;
         }
-        catch(...)
+    }
+
+    if(!arrived.empty())
+    {
+        // keep the listing sorted while it streams in. ".." stays in front
+        std::sort(arrived.begin(), arrived.end(), IsRecordLess);
+        const size_t middle = fileRecords_.size();
+        std::move(arrived.begin(), arrived.end(), std::back_inserter(fileRecords_));
+        std::inplace_merge(fileRecords_.begin() + 1, fileRecords_.begin() + middle, fileRecords_.end(), IsRecordLess);
+        visibleRecordsDirty_ = true;
+    }
+
+    if(done)
+    {
+        if(scan_->error.empty() && scan_->modifiedTime != std::filesystem::file_time_type::min())
         {
-            if(!(flags_ & ImGuiFileBrowserFlags_SkipItemsCausingError))
+            if(directoryCache_.size() >= MAX_CACHED_DIRECTORIES && !directoryCache_.count(scan_->directory))
             {
-                throw;
+                // evict the least recently used listing
+                directoryCache_.erase(std::min_element(directoryCache_.begin(), directoryCache_.end(),
+                    [](const auto &L, const auto &R) { return L.second.lastUse < R.second.lastUse; }));
             }
-            continue;
+            directoryCache_[scan_->directory] = DirectoryCache{
+                scan_->modifiedTime, { fileRecords_.begin() + 1, fileRecords_.end() }, ++directoryCacheClock_ };
         }
+        scan_.reset();
+        ClearRangeSelectionState();
+    }
+}
 
-        fileRecords_.push_back(rcd);
+inline void ImGui::FileBrowser::UpdateVisibleRecords()
+{
+    if(!visibleRecordsDirty_)
+    {
+        return;
     }
+    visibleRecordsDirty_ = false;
 
-    std::sort(
-        fileRecords_.begin(), fileRecords_.end(), [](const FileRecord &L, const FileRecord &R)
-        {
-            return (L.isDir ^ R.isDir) ? L.isDir : (L.name < R.name);
-        });
+    const bool shouldHideRegularFiles =
+        (flags_ & ImGuiFileBrowserFlags_HideRegularFiles) && (flags_ & ImGuiFileBrowserFlags_SelectDirectory);
 
-    ClearRangeSelectionState();
+    visibleRecords_.clear();
+    for(unsigned int rscIndex = 0; rscIndex < fileRecords_.size(); ++rscIndex)
+    {
+        const auto &rsc = fileRecords_[rscIndex];
+        if(!rsc.isDir && shouldHideRegularFiles)
+        {
+            continue;
+        }
+        if(!rsc.isDir && !IsExtensionMatched(rsc.extension))
+        {
+            continue;
+        }
+        if(!rsc.name.empty() && rsc.name.c_str()[0] == '$')
+        {
+            continue;
+        }
+        visibleRecords_.push_back(rscIndex);
+    }
 }
 
 inline void ImGui::FileBrowser::SetCurrentDirectoryUncatched(const std::filesystem::path &pwd)
@@ -10,19 +10,61 @@
 // clang-format on
 #include <yaml-cpp/yaml.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <unordered_set>
+#ifdef _WIN32
+// Keep min/max usable and ERROR free for LogLevel
+#define NOMINMAX
+#define NOGDI
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+#endif
 
 #include "cmake_defines.hh"
 #include "engine/EBO.hh"
+#include "engine/asset_index.hh"
+#include "engine/autosave.hh"
+#include "engine/buffer_arena.hh"
 #include "engine/VAO.hh"
 #include "engine/VBO.hh"
 #include "engine/camera.hh"
+#include "engine/crowd.hh"
+#include "engine/entity_file.hh"
+#include "engine/entity_pack.hh"
+#include "engine/job_system.hh"
 #include "engine/line.hh"
+#include "engine/palette.hh"
+#include "engine/profiler.hh"
+#include "engine/redraw.hh"
+#include "engine/render_queue.hh"
 #include "engine/shader.hh"
+#include "engine/transform_system.hh"
+#include "engine/vox_metadata.hh"
+#include "engine/voxel_codec.hh"
+#include "engine/voxel_volume.hh"
 #include "entity.hh"
 #include "imfilebrowser.h"
+#include "utils/alloc_tracker.hh"
+#include "utils/bench.hh"
 #include "utils/logger.hh"
+#include "utils/trace.hh"
 
 int screen_width = 800;
 int screen_height = 600;
@@ -38,6 +80,104 @@ GLfloat lightVertices[] = {
 
 GLuint lightIndices[] = {0, 1, 2, 0, 2, 3, 0, 4, 7, 0, 7, 3, 3, 7, 6, 3, 6, 2, 2, 6, 5, 2, 5, 1, 1, 5, 4, 1, 4, 0, 4, 5, 6, 4, 6, 7};
 
+// Peak and current resident set size in bytes, 0 if the platform call fails
+size_t peakResidentBytes() {
+#ifndef _WIN32
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024;
+#endif
+#else
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#endif
+}
+
+size_t currentResidentBytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    return info.resident_size;
+#else
+    // statm counts pages, which are 16 or 64 KiB on some arm64 kernels
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    long page_size = sysconf(_SC_PAGESIZE);
+    return page_size > 0 ? resident * page_size : 0;
+#endif
+}
+
+bool hasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        if (std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), name) == 0) return true;
+    }
+    return false;
+}
+
+// `bench mesh` and `bench load` with a .json path: the timings, the allocations made during the runs per phase and the model's buffers
+void writeBenchJson(Utils::Logger& logger, const std::string& path, const std::string& bench, Entity::EntityBase& entity, Utils::BenchResult& result,
+    const Utils::AllocReport& allocations) {
+    std::ofstream file(path);
+    file << "{\"bench\":" << std::quoted(bench) << ",\"model\":" << std::quoted(entity.GetModelPath()) << ",\"triangles\":" << entity.IndexCount() / 3
+         << ",\"cpu_bytes\":" << entity.CpuBytes() << ",\"gpu_bytes\":" << entity.GpuBytes() << ",\"timing\":" << result.ToJson() << ",\"allocations\":";
+    Utils::WriteAllocJson(allocations, file);
+    file << "}\n";
+    if (!file) {
+        logger.Error("Failed to write `{}`", path);
+    } else {
+        logger.Info("Wrote `{}`", path);
+    }
+}
+
+void renderMemoryPanel(Entity::EntityBase* entity, size_t crowd_instances, const Engine::BufferArena::Stats& buffers) {
+    ImGui::Text("Resident: %.1f MiB (peak %.1f MiB)", currentResidentBytes() / 1048576.0, peakResidentBytes() / 1048576.0);
+    ImGui::Text("Mesh buffers: %zu meshes, %.2f of %.2f MiB vertices, %.2f of %.2f MiB indices", buffers.meshes, buffers.vertex_bytes / 1048576.0,
+        buffers.vertex_capacity / 1048576.0, buffers.index_bytes / 1048576.0, buffers.index_capacity / 1048576.0);
+    ImGui::Text("Mesh buffer free ranges: %zu, %.2f MiB compacted", buffers.free_ranges, buffers.compacted_bytes / 1048576.0);
+    if (entity) {
+        ImGui::Text("Model: %.2f MiB on the CPU, %.2f MiB uploaded", entity->CpuBytes() / 1048576.0, entity->GpuBytes() / 1048576.0);
+        ImGui::Text("Load arena: %.2f MiB reserved, %.2f MiB used at most", entity->ArenaBytes() / 1048576.0, entity->ArenaHighWater() / 1048576.0);
+        if (crowd_instances > 0) ImGui::Text("Crowd instances: %.2f MiB uploaded", crowd_instances * sizeof(glm::mat4) / 1048576.0);
+    }
+    ImGui::Separator();
+    if (!Utils::ALLOC_TRACKING) {
+        ImGui::TextDisabled("Configure with -DVOX_ALLOC_TRACKING=ON to count allocations per phase");
+        return;
+    }
+    Utils::AllocReport report = Utils::AllocSnapshot();
+    if (ImGui::BeginTable("Allocations", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+        for (const char* header : {"Phase", "Allocations", "Allocated", "Live", "Peak"}) ImGui::TableSetupColumn(header);
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < report.size(); i++) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(Utils::AllocPhaseName((Utils::AllocPhase)i));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)report[i].allocations);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f MiB", report[i].bytes / 1048576.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f MiB", report[i].live / 1048576.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f MiB", report[i].peak / 1048576.0);
+        }
+        ImGui::EndTable();
+    }
+    if (ImGui::Button("Reset counts")) Utils::AllocReset();
+}
+
 std::string getFileNameWithoutExtension(const std::string& filePath) {
     size_t lastSlashPos = filePath.find_last_of("/\\");
     size_t lastDotPos = filePath.find_last_of('.');
@@ -57,8 +197,106 @@ std::string getFileNameWithoutExtension(const std::string& filePath) {
     return fileNameWithoutExtension;
 }
 
-int main() {
+// Headless `--validate <dir> [--report <file>] [--threads <n>]`, exits with 1 if any entity failed and 2 on usage errors
+int validateEntities(Utils::Logger& logger, int argc, char** argv) {
+    std::string report_path;
+    int threads = 0;
+    for (int i = 3; i < argc; i += 2) {
+        if (i + 1 < argc && std::strcmp(argv[i], "--report") == 0) {
+            report_path = argv[i + 1];
+        } else if (i + 1 < argc && std::strcmp(argv[i], "--threads") == 0) {
+            threads = std::atoi(argv[i + 1]);
+        } else {
+            logger.Error("Unknown or incomplete option `{}`, usage: --validate <dir> [--report <file>] [--threads <n>]", argv[i]);
+            return 2;
+        }
+    }
+
+    // Keep stdout pure JSON unless the report goes to a file
+    if (report_path.empty()) logger.SetLevel(Utils::LogLevel::ERROR);
+    Engine::JobSystem jobs(threads);
+    Engine::ValidationReport report = Engine::ValidateEntities(argv[2], jobs);
+    if (report_path.empty()) {
+        Engine::WriteValidationReport(report, std::cout);
+    } else {
+        std::ofstream file(report_path);
+        Engine::WriteValidationReport(report, file);
+        if (!file) logger.Error("Failed to write report: `{}`", report_path);
+    }
+    if (!report.error.empty()) {
+        logger.Error("Cannot walk `{}`: {}", report.root, report.error);
+        return 2;
+    }
+    logger.Info("Validated {} entities in {:.1f} ms on {} threads, {} failed", report.files.size(), report.milliseconds, report.threads, report.failed);
+    return report.failed > 0 ? 1 : 0;
+}
+
+// Packs every entity in `report` that passed validation, needs a GL context for the scratch entity that triangulates them.
+// With `bake` the rotation and offset go into the mesh, and each baked mesh is checked against the preview transform.
+void buildEntityPack(Utils::Logger& logger, Engine::BufferArena& buffers, Engine::JobSystem& jobs, const Engine::ValidationReport& report,
+    const std::string& pack_path, bool bake) {
+    auto start = std::chrono::steady_clock::now();
+    if (!report.error.empty()) {
+        logger.Error("Cannot walk `{}`: {}", report.root, report.error);
+        return;
+    }
+
+    Entity::EntityBase scratch(logger, buffers, jobs);
+    scratch.SetPosition(glm::vec3(0.0f));
+    std::vector<Engine::PackInput> entities;
+    std::unordered_set<std::string> names;
+    for (const Engine::EntityCheck& check : report.files) {
+        if (!check.errors.empty()) {
+            logger.Warn("Not packing `{}`: {}", check.path, check.errors.front());
+            continue;
+        }
+        if (!scratch.Load(check.path)) continue;
+        if (!names.insert(scratch.name).second) {
+            logger.Warn("Not packing `{}`: another entity is already called `{}`", check.path, scratch.name);
+            continue;
+        }
+        if (bake) {
+            std::vector<GLfloat> preview = scratch.Vertices();
+            glm::mat4 preview_model = scratch.GetModel();
+            scratch.BakeTransform();
+            if (!Engine::SameSurface(preview, preview_model, scratch.Vertices(), scratch.GetModel(), Entity::EntityBase::VERTEX_STRIDE, Entity::EntityBase::FaceNormal)) {
+                logger.Error("Not packing `{}`: the baked mesh does not match the preview", check.path);
+                names.erase(scratch.name);
+                continue;
+            }
+        }
+        Engine::PackInput& input = entities.emplace_back();
+        input.name = scratch.name;
+        input.position_offset = scratch.position_offset;
+        input.rotation = scratch.rotation;
+        input.model_size = glm::ivec3(scratch.model_size);
+        input.palette = scratch.Palette();
+        input.variants = scratch.Variants();
+        input.vertices.assign(scratch.Vertices().begin(), scratch.Vertices().end());
+        input.indices.assign(scratch.Indices().begin(), scratch.Indices().end());
+        if (bake) {
+            // What is left of the offset after baking is not a whole voxel, it moves the vertices instead
+            for (size_t i = 0; i < input.vertices.size(); i += Entity::EntityBase::VERTEX_STRIDE) {
+                for (int axis = 0; axis < 3; axis++) input.vertices[i + axis] += input.position_offset[axis];
+            }
+            input.position_offset = glm::vec3(0.0f);
+        }
+    }
+
+    std::string error = Engine::WriteEntityPack(pack_path, entities, Entity::EntityBase::VERTEX_STRIDE);
+    if (!error.empty()) {
+        logger.Error("Failed to write pack: {}", error);
+        return;
+    }
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    logger.Info("Packed {} of {} entities{} into `{}` ({:.2f} MiB) in {:.1f} ms, validated in {:.1f} ms", entities.size(), report.files.size(),
+        bake ? ", baked," : "", pack_path, std::filesystem::file_size(pack_path) / 1048576.0, elapsed.count(), report.milliseconds);
+}
+
+int main(int argc, char** argv) {
+    Utils::TraceThreadName("Main");
     Utils::Logger logger;
+    if (argc >= 3 && std::strcmp(argv[1], "--validate") == 0) return validateEntities(logger, argc, argv);
     int logger_window_size = 150;
     logger.SetLoggerWindowSize(logger_window_size);
     logger.Info(PROJECT_NAME ": " PROJECT_VERSION);
@@ -78,8 +316,16 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
+    // Declared before every GL object, so it is destroyed after them and their destructors still have a context
+    struct GlfwSession {
+        ~GlfwSession() { glfwTerminate(); }
+    } glfw_session;
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSwapInterval(1);
+    Engine::Redraw redraw;
+    redraw.InstallCallbacks(window);
+    // Log lines from other threads should show up even while the main loop is idle
+    logger.SetWakeCallback(glfwPostEmptyEvent);
     logger.Info("Window created successfully");
 
     // Initialize GLAD
@@ -127,11 +373,32 @@ int main() {
     entityShader.Activate();
     logger.Info("Entity shader initialized successfully");
 
+    // Every entity mesh is a range in these buffers and draws with their VAO
+    Engine::BufferArena mesh_buffers(Entity::EntityBase::VERTEX_STRIDE * sizeof(GLfloat), Entity::EntityBase::VertexAttributes());
+    // GPU bytes moved per frame while closing the holes released meshes leave
+    const size_t mesh_compact_budget = 4 << 20;
+
+    // Loading, meshing and baking split their work into jobs, which hand GL work back to the main loop
+    Engine::JobSystem jobs;
+    jobs.SetWakeCallback(glfwPostEmptyEvent);
+
     // Create entities
-    Entity::EntityBase entity(logger);
+    Entity::EntityBase entity(logger, mesh_buffers, jobs);
     entity.SetPosition(glm::vec3(0.0f, 0.0f, 0.0f));
     bool entity_initialized = false;
 
+    // Raymarch render mode
+    Engine::Shader raymarchShader(logger, "data/shaders/raymarch.vert", "data/shaders/raymarch.frag");
+    logger.Info("Raymarch shader initialized successfully");
+
+    // Crowd preview
+    Engine::Shader crowdShader(logger, "data/shaders/crowd.vert", "data/shaders/entity.frag");
+    Engine::Crowd crowd;
+    mesh_buffers.Link(crowd.VAO);
+    bool show_crowd = false;
+    bool vsync = true;
+    logger.Info("Crowd preview initialized successfully");
+
     // Position offset cube
     Engine::VAO cube_VAO;
     cube_VAO.Bind();
@@ -151,132 +418,685 @@ int main() {
 
     ImGui::FileBrowser openFileDialog;
     openFileDialog.SetTitle("Select a voxel model file");
-    openFileDialog.SetTypeFilters({".vox"});
+    openFileDialog.SetTypeFilters({".vox", ".vxc", ".yml"});
+
+    // Dimensions, counts and a preview per file in the browser, without loading the models
+    Engine::VoxMetadataCache vox_metadata(logger, "vox_metadata.idx");
+    vox_metadata.SetWakeCallback(glfwPostEmptyEvent);
+    openFileDialog.SetFileColumns(
+        {"Preview", "Size", "Voxels", "Colors"},
+        [&](const std::filesystem::path& path, int column) {
+            if (path.extension() != ".vox") return;
+            using State = Engine::VoxMetadataCache::State;
+            Engine::VoxMetadataCache::Entry entry = vox_metadata.Get(path);
+            const Engine::VoxMetadata& metadata = entry.metadata;
+            if (entry.state == State::FAILED) {
+                if (column == 1) ImGui::TextDisabled("unreadable");
+                return;
+            }
+            switch (column) {
+                case 0:
+                    if (GLuint thumbnail = vox_metadata.Thumbnail(path)) {
+                        ImGui::Image((ImTextureID)(intptr_t)thumbnail, ImVec2(Engine::VoxMetadata::THUMBNAIL_SIZE, Engine::VoxMetadata::THUMBNAIL_SIZE));
+                    }
+                    break;
+                case 1:
+                    if (entry.state == State::QUEUED) {
+                        ImGui::TextDisabled("...");
+                    } else {
+                        ImGui::Text("%d x %d x %d", metadata.size.x, metadata.size.y, metadata.size.z);
+                    }
+                    break;
+                case 2:
+                    if (entry.state != State::QUEUED) ImGui::Text("%d", metadata.voxel_count);
+                    break;
+                case 3:
+                    if (entry.state == State::COMPLETE) ImGui::Text("%d", metadata.palette_used);
+                    break;
+            }
+        },
+        Engine::VoxMetadata::THUMBNAIL_SIZE);
+
+    Engine::AssetIndex asset_index(logger, "asset_index.idx");
+    asset_index.SetWakeCallback(glfwPostEmptyEvent);
+    bool show_asset_search = false;
+    bool show_memory = false;
+    static char asset_query[256] = "";
+
+    // Entity edits are written a moment after they stop, off the main thread
+    Engine::Autosave autosave(logger);
+    autosave.SetWakeCallback(glfwPostEmptyEvent);
+    bool autosave_enabled = true;
+
+    Engine::RenderQueue queue;
+
+    Engine::Profiler profiler(logger);
+    int profile_input = profiler.Register("Input", false);
+    int profile_camera = profiler.Register("Camera", false);
+    int profile_scene = profiler.Register("Scene draw", true);
+    int profile_imgui_build = profiler.Register("ImGui build", false);
+    int profile_imgui_render = profiler.Register("ImGui render", true);
+    int profile_swap = profiler.Register("Swap", false);
+
+    // Console commands
+    auto parseRuns = [](const std::vector<std::string>& args, size_t index) { return args.size() > index ? std::max(1, std::atoi(args[index].c_str())) : 10; };
+    auto jsonPath = [](const std::vector<std::string>& args, size_t index) { return args.size() > index && args[index].ends_with(".json") ? args[index] : ""; };
+    logger.RegisterCommand("bench mesh", "[n] [file.json]", "Triangulate the current model n times (default 10)", [&](const std::vector<std::string>& args) {
+        if (!entity_initialized) {
+            logger.Warn("No model loaded");
+            return;
+        }
+        Utils::AllocReset();
+        Utils::BenchResult result = Utils::Bench(parseRuns(args, 0), [&] { entity.Triangulate(); });
+        Utils::AllocReport allocations = Utils::AllocSnapshot();
+        logger.Info("bench mesh `{}` ({} triangles, optimize {}): {}", entity.GetModelPath(), entity.IndexCount() / 3, entity.optimize_mesh ? "on" : "off",
+            result.ToString());
+        if (std::string json = jsonPath(args, 1); !json.empty()) writeBenchJson(logger, json, "mesh", entity, result, allocations);
+        redraw.Request();
+    });
+    logger.RegisterCommand("bench load", "<path> [n] [file.json]", "Load a model n times (default 10), it stays loaded", [&](const std::vector<std::string>& args) {
+        if (args.empty() || !std::filesystem::is_regular_file(args[0])) {
+            logger.Warn("bench load: expected the path of an existing file");
+            return;
+        }
+        // A file the loader rejects is reported once instead of timed, the loaded model stays
+        if (!entity.LoadModelForSetup(args[0])) {
+            logger.Warn("bench load: `{}` is not a model that can be loaded", args[0]);
+            return;
+        }
+        Utils::AllocReset();
+        Utils::BenchResult result = Utils::Bench(parseRuns(args, 1), [&] { entity.LoadModelForSetup(args[0]); });
+        Utils::AllocReport allocations = Utils::AllocSnapshot();
+        entity_initialized = true;
+        logger.Info("bench load `{}`: {}", args[0], result.ToString());
+        if (std::string json = jsonPath(args, 2); !json.empty()) writeBenchJson(logger, json, "load", entity, result, allocations);
+        redraw.Request();
+    });
+    logger.RegisterCommand("bench transforms", "[count]", "Update count world matrices (default 20000), all of them and 1% of them",
+        [&](const std::vector<std::string>& args) {
+            int count = args.empty() ? 20000 : std::max(1, std::atoi(args[0].c_str()));
+            Engine::TransformSystem transforms;
+            transforms.Reserve(count);
+            for (int i = 0; i < count; i++) transforms.Add(glm::vec3(i % 100, 0, i / 100), glm::vec3(0.5f, 0.0f, 0.5f), i % Engine::QuarterTurns::CODES);
+            Utils::BenchResult full = Utils::Bench(10, [&] {
+                for (int i = 0; i < count; i++) transforms.SetRotation(i, (i + 1) % Engine::QuarterTurns::CODES);
+                transforms.Update();
+            });
+            int step = 100;
+            Utils::BenchResult partial = Utils::Bench(10, [&] {
+                for (int i = 0; i < count; i += step) transforms.SetPosition(i, glm::vec3(i % 100, 1, i / 100));
+                transforms.Update();
+            });
+            logger.Info("bench transforms {} all: {}", count, full.ToString());
+            logger.Info("bench transforms {} 1%: {}", count, partial.ToString());
+        });
+    logger.RegisterCommand("bench vxc", "[n]", "Encode the current model as .vox and .vxc, then decode the .vxc n times (default 10)",
+        [&](const std::vector<std::string>& args) {
+            if (!entity_initialized) {
+                logger.Warn("No model loaded");
+                return;
+            }
+            const Engine::VoxelGrid& grid = entity.Grid();
+            Engine::VoxEncoder vox(entity.FrameCount());
+            Engine::VxcEncoder vxc(grid.size, entity.Palette(), entity.FrameCount());
+            entity.ForEachFrame([&](const Engine::VoxelGrid& frame) { vox.AddFrame(frame); });
+            Utils::BenchResult encode = Utils::Bench(1, [&] { entity.ForEachFrame([&](const Engine::VoxelGrid& frame) { vxc.AddFrame(frame); }); });
+            size_t vox_bytes = vox.Finish(entity.Palette()).size();
+            size_t vxc_bytes = vxc.Bytes().size();
+
+            std::istringstream in(vxc.Bytes());
+            Engine::VoxelGrid decoded;
+            std::string error;
+            Utils::BenchResult decode = Utils::Bench(parseRuns(args, 0), [&] {
+                in.clear();
+                in.seekg(0);
+                Engine::VxcDecoder decoder(in);
+                error = decoder.ReadHeader();
+                for (int i = 0; i < decoder.FrameCount() && error.empty(); i++) error = decoder.ReadFrame(decoded);
+            });
+            if (!error.empty()) {
+                logger.Error("bench vxc: decoding failed: {}", error);
+                return;
+            }
+            double grid_bytes = (double)grid.voxels.size() * entity.FrameCount();
+            logger.Info("bench vxc `{}` ({} frames): {:.1f} KiB as .vox, {:.1f} KiB as .vxc, {:.1f}x smaller, encoded in {:.2f} ms", entity.GetModelPath(),
+                entity.FrameCount(), vox_bytes / 1024.0, vxc_bytes / 1024.0, (double)vox_bytes / std::max<size_t>(vxc_bytes, 1), encode.median_ms);
+            logger.Info("bench vxc decode: {}, {:.2f} GB/s of grid", decode.ToString(), grid_bytes / (decode.median_ms * 1e6));
+        });
+    logger.RegisterCommand("bench jobs", "[n]", "Time empty jobs for the cost per job, then one workload on 1 up to every thread, n runs each (default 10)",
+        [&](const std::vector<std::string>& args) {
+            int runs = parseRuns(args, 0);
+            // Rounds stay well under the deque capacity, past it Run executes jobs right away
+            const int rounds = 100, round_jobs = 1000;
+            Utils::BenchResult overhead = Utils::Bench(runs, [&] {
+                for (int round = 0; round < rounds; round++) {
+                    Engine::JobSystem::Counter counter;
+                    for (int i = 0; i < round_jobs; i++) jobs.Run([] {}, &counter);
+                    jobs.Wait(counter);
+                }
+            });
+            logger.Info("bench jobs overhead on {} threads: {:.0f} ns per empty job, {}", jobs.ThreadCount(), overhead.median_ms * 1e6 / (rounds * round_jobs),
+                overhead.ToString());
+
+            // The same integer workload in equal pieces, on a system of each size so idle threads cannot help
+            const size_t pieces = 1024;
+            std::vector<uint64_t> results(pieces);
+            auto work = [&](size_t begin, size_t end) {
+                for (size_t piece = begin; piece < end; piece++) {
+                    uint64_t x = piece + 1;
+                    for (int i = 0; i < 20000; i++) {
+                        x ^= x << 13;
+                        x ^= x >> 7;
+                        x ^= x << 17;
+                    }
+                    results[piece] = x;
+                }
+            };
+            double single_ms = 0.0;
+            for (int threads = 1;; threads = std::min(threads * 2, jobs.ThreadCount())) {
+                Engine::JobSystem local(threads);
+                Utils::BenchResult result = Utils::Bench(runs, [&] { local.ParallelFor(pieces, 1, work); });
+                if (threads == 1) single_ms = result.median_ms;
+                double speedup = single_ms / result.median_ms;
+                logger.Info("bench jobs scaling {} threads: {:.2f}x ({:.0f}% efficiency), {}", threads, speedup, 100.0 * speedup / threads, result.ToString());
+                if (threads >= jobs.ThreadCount()) break;
+            }
+        });
+    logger.RegisterCommand("model save", "<file.vox|file.vxc>", "Write the current model with all its frames, the format follows the extension",
+        [&](const std::vector<std::string>& args) {
+            if (!entity_initialized) {
+                logger.Warn("No model loaded");
+                return;
+            }
+            if (args.empty()) {
+                logger.Warn("model save: expected the path of a .vox or .vxc file");
+                return;
+            }
+            std::string error = entity.SaveModel(args[0]);
+            if (!error.empty()) {
+                logger.Error("model save: `{}`: {}", args[0], error);
+                return;
+            }
+            logger.Info("Wrote `{}`, {} frames", args[0], entity.FrameCount());
+        });
+    logger.RegisterCommand("stats mem", "", "Process and model memory usage", [&](const std::vector<std::string>&) {
+        logger.Info("Resident memory: {:.1f} MiB (peak {:.1f} MiB)", currentResidentBytes() / 1048576.0, peakResidentBytes() / 1048576.0);
+        if (entity_initialized) {
+            logger.Info("Model `{}`: {:.2f} MiB on the CPU, {:.2f} MiB uploaded", entity.GetModelPath(), entity.CpuBytes() / 1048576.0,
+                entity.GpuBytes() / 1048576.0);
+        }
+    });
+    logger.RegisterCommand("stats gpu", "", "GL driver, GPU memory and draw statistics", [&](const std::vector<std::string>&) {
+        logger.Info("GL {} on {} ({}), GLSL {}", reinterpret_cast<const char*>(glGetString(GL_VERSION)), reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+            reinterpret_cast<const char*>(glGetString(GL_VENDOR)), reinterpret_cast<const char*>(glGetString(GL_SHADING_LANGUAGE_VERSION)));
+        if (hasGLExtension("GL_NVX_gpu_memory_info")) {
+            GLint total_kb = 0, available_kb = 0;
+            glGetIntegerv(0x9048, &total_kb);      // GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX
+            glGetIntegerv(0x9049, &available_kb);  // GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+            logger.Info("GPU memory: {} MiB free of {} MiB", available_kb / 1024, total_kb / 1024);
+        } else if (hasGLExtension("GL_ATI_meminfo")) {
+            GLint free_kb[4] = {0, 0, 0, 0};
+            glGetIntegerv(0x87FB, free_kb);  // GL_VBO_FREE_MEMORY_ATI
+            logger.Info("GPU memory: {} MiB free for buffers", free_kb[0] / 1024);
+        } else {
+            logger.Info("GPU memory: not reported by this driver");
+        }
+        if (entity_initialized) logger.Info("Model uploads: {:.2f} MiB", entity.GpuBytes() / 1048576.0);
+        logger.Info("Last frame: {} draw calls, {} state changes for {} queued items", queue.stats.draw_calls, queue.stats.StateChanges(), queue.stats.items);
+    });
+    logger.RegisterCommand("reload", "", "Read the current model from disk again", [&](const std::vector<std::string>&) {
+        if (!entity_initialized) {
+            logger.Warn("No model loaded");
+            return;
+        }
+        if (entity.Reload()) redraw.Request();
+    });
+    logger.RegisterCommand("variant", "[name]", "Preview a palette variant of the entity, the next one without a name", [&](const std::vector<std::string>& args) {
+        if (args.empty()) {
+            entity.NextVariant();
+        } else {
+            auto& variants = entity.Variants();
+            auto found = std::find_if(variants.begin(), variants.end(), [&](const Engine::PaletteVariant& variant) { return variant.name == args[0]; });
+            if (found == variants.end()) {
+                logger.Warn("variant: the entity has no variant called `{}`", args[0]);
+                return;
+            }
+            entity.SetVariant(found - variants.begin() + 1);
+        }
+        logger.Info("Palette: {}", entity.VariantName(entity.Variant()));
+        redraw.Request();
+    });
+    logger.RegisterCommand("pack build", "<dir> <file> [bake]",
+        "Write every valid entity under dir, with its mesh, to a pack file. bake applies rotations and offsets to the meshes",
+        [&](const std::vector<std::string>& args) {
+            if (args.size() < 2 || !std::filesystem::is_directory(args[0]) || (args.size() > 2 && args[2] != "bake")) {
+                logger.Warn("pack build: expected an existing directory, the pack file to write and optionally `bake`");
+                return;
+            }
+            // Validation reads every model header, so it runs on the jobs and the main loop only does the GL part
+            logger.Info("Validating `{}` for the pack", args[0]);
+            std::string root = args[0], pack_path = args[1];
+            bool bake = args.size() > 2;
+            jobs.Run([&logger, &mesh_buffers, &jobs, root, pack_path, bake] {
+                auto report = std::make_shared<Engine::ValidationReport>(Engine::ValidateEntities(root, jobs));
+                jobs.RunOnMainThread([&logger, &mesh_buffers, &jobs, report, pack_path, bake] { buildEntityPack(logger, mesh_buffers, jobs, *report, pack_path, bake); });
+            });
+        });
+    logger.RegisterCommand("pack verify", "<file>", "Map a pack file and check its structure and checksum", [&](const std::vector<std::string>& args) {
+        if (args.empty()) {
+            logger.Warn("pack verify: expected the path of a pack file");
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        Engine::EntityPack pack;
+        std::string error = pack.Open(args[0]);
+        std::chrono::duration<float, std::milli> opened = std::chrono::steady_clock::now() - start;
+        if (error.empty()) error = pack.Verify();
+        std::chrono::duration<float, std::milli> verified = std::chrono::steady_clock::now() - start;
+        if (!error.empty()) {
+            logger.Error("pack verify: {}", error);
+            return;
+        }
+        size_t triangles = 0, palettes = 0;
+        for (const Engine::PackEntity& packed : pack.Entities()) {
+            triangles += packed.index_count / 3;
+            palettes += packed.palette_count;
+        }
+        logger.Info("pack verify `{}`: {} entities, {} triangles, {} palettes, {:.2f} MiB, opened in {:.3f} ms, verified in {:.1f} ms", args[0], pack.Count(),
+            triangles, palettes, pack.Bytes() / 1048576.0, opened.count(), verified.count());
+    });
+    logger.RegisterCommand("index add", "<dir>", "Index every .vox under dir for the asset search", [&](const std::vector<std::string>& args) {
+        if (args.empty() || !std::filesystem::is_directory(args[0])) {
+            logger.Warn("index add: expected the path of an existing directory");
+            return;
+        }
+        asset_index.AddRoot(args[0]);
+    });
+    logger.RegisterCommand("index remove", "<dir>", "Stop indexing dir", [&](const std::vector<std::string>& args) {
+        if (args.empty() || !asset_index.RemoveRoot(args[0])) logger.Warn("index remove: not an asset root");
+    });
+    logger.RegisterCommand("index list", "", "Asset roots and the number of indexed models", [&](const std::vector<std::string>&) {
+        for (auto& root : asset_index.Roots()) logger.Info("Asset root: `{}`", root);
+        logger.Info("{} models indexed{}", asset_index.Snapshot()->records.size(), asset_index.Crawling() ? ", crawling" : "");
+    });
+    logger.RegisterCommand("index rescan", "", "Crawl the asset roots now instead of at the next poll", [&](const std::vector<std::string>&) { asset_index.Rescan(); });
 
     glEnable(GL_DEPTH_TEST);
 
     static char entity_name[128] = "";
+    size_t log_generation = logger.Generation();
+    size_t metadata_generation = vox_metadata.Generation();
+    size_t asset_generation = asset_index.Generation();
+    size_t autosave_generation = autosave.Generation();
+    // Of the last write scheduled for the entity, its settings count as saved once the write completed
+    uint64_t save_ticket = 0;
+    auto scheduleSave = [&](bool immediately) {
+        save_ticket = autosave.Schedule(entity.SavePath(), entity.Serialize(), immediately);
+        entity.MarkScheduled();
+    };
+
+    // A .vox starts a new entity, a .yml restores a saved one with its model
+    auto openModel = [&](const std::string& path) {
+        logger.Info("Loading file: {}", path);
+        // Edits still waiting for the debounce belong to the entity being replaced
+        if (entity_initialized && autosave_enabled && entity.HasDataFile() && entity.Unscheduled()) scheduleSave(true);
+        save_ticket = 0;
+        bool saved_entity = std::filesystem::path(path).extension() == ".yml";
+        if (saved_entity) {
+            if (!entity.Load(path)) return;
+        } else if (!entity.LoadModelForSetup(path)) {
+            return;
+        }
+        entity_initialized = true;
+        redraw.Request();
+        std::string entity_name_str = saved_entity ? entity.name : getFileNameWithoutExtension(path);
+        std::snprintf(entity_name, sizeof(entity_name), "%s", entity_name_str.c_str());
+    };
 
     // Main loop
     logger.Info("Entering main loop");
     while (!glfwWindowShouldClose(window)) {
-        processInput(window);
+        redraw.WaitEvents();
+        ImGuiIO& io = ImGui::GetIO();
+        // Keep the text cursor blinking while a text field is focused, and the graph moving while profiling
+        if (redraw.TimedOut() && io.WantTextInput) redraw.Request(1);
+        if (profiler.enabled) redraw.Request(1);
+        if (logger.Generation() != log_generation) redraw.Request();
+        if (openFileDialog.IsScanning()) redraw.Request(1);
+        if (vox_metadata.Generation() != metadata_generation) redraw.Request();
+        if (asset_index.Generation() != asset_generation) redraw.Request();
+        if (autosave.Generation() != autosave_generation) redraw.Request();
+        if (save_ticket != 0 && autosave.GetStatus().written >= save_ticket) {
+            entity.MarkWritten();
+            save_ticket = 0;
+        }
+        if (jobs.RunMainThreadJobs() > 0) redraw.Request();
+        if (entity_initialized && entity.playing) redraw.Request(1);
+        if (!redraw.ShouldDraw()) continue;
 
-        // Clear the screen
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        TRACE_SCOPE("Frame");
+        profiler.BeginFrame();
+        glm::vec3 camera_position = camera.Position;
+        glm::vec3 camera_orientation = camera.Orientation;
+        std::string entity_name_before = entity.name;
+        glm::vec3 entity_offset_before = entity.position_offset;
+        glm::vec3 entity_rotation_before = entity.rotation;
+        log_generation = logger.Generation();
+        metadata_generation = vox_metadata.Generation();
+        asset_generation = asset_index.Generation();
+        autosave_generation = autosave.Generation();
 
-        ImGuiIO& io = ImGui::GetIO();
-        camera.Inputs(window, !io.WantCaptureMouse, !io.WantCaptureKeyboard);
-        camera.UpdateMatrix(45, 0.01f, 250);
-        screen_width = io.DisplaySize.x;
-        screen_height = io.DisplaySize.y;
-        glViewport(0, 0, screen_width * 2, screen_height * 2);
-        camera.UpdateAspect(screen_width, screen_height);
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        // Render the light cube
-        lightShader.Activate();
-        camera.Matrix(lightShader, "camMatrix");
-        lightVAO.Bind();
-        glDrawElements(GL_TRIANGLES, sizeof(lightIndices) / sizeof(uint), GL_UNSIGNED_INT, 0);
-
-        // Render Entities
-        if (entity_initialized) {
-            entityShader.Activate();
-            camera.Matrix(entityShader, "camMatrix");
-            glUniform3f(glGetUniformLocation(entityShader.id, "camPos"), camera.Position.x, camera.Position.y, camera.Position.z);
-            glUniform4f(glGetUniformLocation(entityShader.id, "lightColor"), lightColor.x, lightColor.y, lightColor.z, lightColor.w);
-            glUniform3f(glGetUniformLocation(entityShader.id, "lightPos"), -lightPos.x, lightPos.y, -lightPos.z);
-            glm::mat4 entityModel = entity.GetModel();
-            glUniformMatrix4fv(glGetUniformLocation(entityShader.id, "model"), 1, GL_FALSE, glm::value_ptr(entityModel));
-            entity.Render();
+        {
+            Engine::Profiler::Scope scope(profiler, profile_input);
+            processInput(window);
+            camera.Inputs(window, !io.WantCaptureMouse, !io.WantCaptureKeyboard);
         }
+        if (camera.Position != camera_position || camera.Orientation != camera_orientation) redraw.Request();
 
-        // Render zero cube
-        cube_shader.Activate();
-        cube_VAO.Bind();
-        camera.Matrix(cube_shader, "camMatrix");
-        glUniform3f(glGetUniformLocation(cube_shader.id, "pos"), 0.0f, 0.0f, 0.0f);
-        glDrawElements(GL_TRIANGLES, sizeof(cube_indices) / sizeof(int), GL_UNSIGNED_INT, 0);
-
-        // ImGUI
-        logger.Render();
-        ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 0.25f;
-        ImGui::GetStyle().Colors[ImGuiCol_TitleBg].w = 0.25f;
-        ImGui::GetStyle().Colors[ImGuiCol_TitleBgActive].w = 0.25f;
-        ImGui::SetNextWindowPos(ImVec2(1, 30));
-        ImGui::Begin("Entity");
-        if (entity_initialized) {
-            ImGui::Text("Camera");
-            ImGui::Text("Position: %.2f %.2f %.2f", camera.Position.x, camera.Position.y, camera.Position.z);
-            ImGui::Text("Orientation: %.2f %.2f %.2f", camera.Orientation.x, camera.Orientation.y, camera.Orientation.z);
-            ImGui::Separator();
+        {
+            Engine::Profiler::Scope scope(profiler, profile_camera);
+            camera.UpdateMatrix(45, 0.01f, 250);
+            screen_width = io.DisplaySize.x;
+            screen_height = io.DisplaySize.y;
+            glViewport(0, 0, screen_width * 2, screen_height * 2);
+            camera.UpdateAspect(screen_width, screen_height);
+        }
 
-            ImGui::Text("Entity settings");
+        // Playback only picks another of the uploaded frame meshes, nothing is meshed here
+        if (entity_initialized) entity.AdvanceAnimation(io.DeltaTime);
+        // Before the scene is queued, compaction moves the ranges the draws read
+        if (!mesh_buffers.Compact(mesh_compact_budget)) redraw.Request(1);
 
-            if (ImGui::InputTextWithHint(" ", "Entity internal name", entity_name, IM_ARRAYSIZE(entity_name))) {
-                entity.name = entity_name;
-                entity_name[0] = '\0';
+        {
+            Engine::Profiler::Scope scope(profiler, profile_scene);
+            // Clear the screen
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // Queue the scene, the render queue sorts it by program and VAO and issues the draws
+            queue.Submit(lightShader, lightVAO, sizeof(lightIndices) / sizeof(GLuint));
+            queue.Uniform(lightShader.Uniform("camMatrix"), camera.cameraMatrix);
+
+            bool raymarch = entity.GetRenderMode() == Entity::RenderMode::RAYMARCH;
+            if (entity_initialized && raymarch) {
+                Engine::VoxelVolume& volume = entity.GetVolume();
+                glm::mat4 model = entity.GetModel();
+                volume.Bind();
+                entity.BindPalette();
+                queue.Submit(raymarchShader, volume.VAO, volume.IndexCount());
+                queue.Uniform(raymarchShader.Uniform("volume"), Engine::VoxelVolume::VOLUME_UNIT);
+                queue.Uniform(raymarchShader.Uniform("occupancy"), Engine::VoxelVolume::OCCUPANCY_UNIT);
+                queue.Uniform(raymarchShader.Uniform("palette"), Engine::PaletteSet::TEXTURE_UNIT);
+                queue.Uniform(raymarchShader.Uniform("size"), glm::vec3(volume.size));
+                queue.Uniform(raymarchShader.Uniform("maxSteps"), volume.MaxSteps());
+                queue.Uniform(raymarchShader.Uniform("camMatrix"), camera.cameraMatrix);
+                queue.Uniform(raymarchShader.Uniform("camPos"), camera.Position);
+                queue.Uniform(raymarchShader.Uniform("lightColor"), lightColor);
+                queue.Uniform(raymarchShader.Uniform("lightPos"), glm::vec3(-lightPos.x, lightPos.y, -lightPos.z));
+                queue.Uniform(raymarchShader.Uniform("model"), model);
+                queue.Uniform(raymarchShader.Uniform("invModel"), glm::inverse(model));
+            } else if (entity_initialized) {
+                Engine::Shader& shader = show_crowd ? crowdShader : entityShader;
+                entity.BindPalette();
+                const Engine::BufferArena::Range& mesh = entity.MeshRange();
+                if (show_crowd) {
+                    crowd.Update(entity.model_size);
+                    queue.Submit(crowdShader, crowd.VAO, mesh.index_count, mesh.IndexOffset(), mesh.base_vertex, crowd.InstanceCount());
+                } else {
+                    queue.Submit(entityShader, entity.GetVAO(), mesh.index_count, mesh.IndexOffset(), mesh.base_vertex);
+                }
+                queue.Uniform(shader.Uniform("camMatrix"), camera.cameraMatrix);
+                queue.Uniform(shader.Uniform("camPos"), camera.Position);
+                queue.Uniform(shader.Uniform("lightColor"), lightColor);
+                queue.Uniform(shader.Uniform("lightPos"), glm::vec3(-lightPos.x, lightPos.y, -lightPos.z));
+                queue.Uniform(shader.Uniform("model"), entity.GetModel());
+                queue.Uniform(shader.Uniform("palette"), Engine::PaletteSet::TEXTURE_UNIT);
+            }
+
+            queue.Submit(cube_shader, cube_VAO, sizeof(cube_indices) / sizeof(GLuint));
+            queue.Uniform(cube_shader.Uniform("camMatrix"), camera.cameraMatrix);
+            queue.Uniform(cube_shader.Uniform("pos"), glm::vec3(0.0f, 0.0f, 0.0f));
+            queue.Flush();
+        }
+
+        {
+            Engine::Profiler::Scope scope(profiler, profile_imgui_build);
+            ALLOC_PHASE(UI);
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+
+            // ImGUI
+            logger.Render();
+            ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 0.25f;
+            ImGui::GetStyle().Colors[ImGuiCol_TitleBg].w = 0.25f;
+            ImGui::GetStyle().Colors[ImGuiCol_TitleBgActive].w = 0.25f;
+            ImGui::SetNextWindowPos(ImVec2(1, 48));
+            ImGui::Begin("Entity");
+            if (entity_initialized) {
+                ImGui::Text("Camera");
+                ImGui::Text("Position: %.2f %.2f %.2f", camera.Position.x, camera.Position.y, camera.Position.z);
+                ImGui::Text("Orientation: %.2f %.2f %.2f", camera.Orientation.x, camera.Orientation.y, camera.Orientation.z);
+                ImGui::Separator();
+
+                ImGui::Text("Entity settings");
+
+                if (ImGui::InputTextWithHint(" ", "Entity internal name", entity_name, IM_ARRAYSIZE(entity_name))) {
+                    entity.name = entity_name;
+                    entity_name[0] = '\0';
+                }
+
+                float pos_offset[3] = {entity.position_offset.x, entity.position_offset.y, entity.position_offset.z};
+                int biggest_model_size = fmax(entity.model_size.x, fmax(entity.model_size.y, entity.model_size.z));
+                ImGui::SliderFloat3("Position offset", pos_offset, -biggest_model_size, biggest_model_size, "%.2f", 1.0f);
+                entity.position_offset = glm::vec3(pos_offset[0], pos_offset[1], pos_offset[2]);
+
+                int rot[3] = {static_cast<int>(entity.rotation.x), static_cast<int>(entity.rotation.y), static_cast<int>(entity.rotation.z)};
+                ImGui::SliderInt3("Rotation", rot, 0, 3);
+                entity.rotation = glm::vec3(rot[0], rot[1], rot[2]);
+                ImGui::Separator();
+
+                if (ImGui::Button("Save entity properties")) {
+                    std::string save_path = entity.SavePath();
+                    if (!entity.HasDataFile() && std::filesystem::exists(save_path)) {
+                        // Most likely another entity of the same model, open it to edit that one
+                        logger.Warn("Not saving over `{}`, which this entity was not loaded from", save_path);
+                    } else {
+                        entity.SetDataPath(save_path);
+                        scheduleSave(true);
+                    }
+                }
+                ImGui::SameLine();
+                ImGui::Checkbox("Autosave", &autosave_enabled);
+                Engine::Autosave::Status save_status = autosave.GetStatus();
+                if (!save_status.error.empty()) {
+                    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Save failed: %s", save_status.error.c_str());
+                } else if (save_status.pending) {
+                    ImGui::TextDisabled("Saving...");
+                } else if (entity.Dirty()) {
+                    ImGui::TextDisabled("Unsaved changes");
+                } else if (save_status.saved != 0 && save_status.path == entity.SavePath()) {
+                    char saved_at[16];
+                    std::tm saved_tm = Utils::LocalTime(save_status.saved);
+                    std::strftime(saved_at, sizeof(saved_at), "%H:%M:%S", &saved_tm);
+                    ImGui::TextDisabled("Saved at %s", saved_at);
+                }
+                ImGui::Separator();
+
+                int render_mode = static_cast<int>(entity.GetRenderMode());
+                if (ImGui::Combo("Render mode", &render_mode, "Mesh\0Raymarch\0")) {
+                    entity.SetRenderMode(static_cast<Entity::RenderMode>(render_mode));
+                    redraw.Request();
+                }
+                if (!entity.Variants().empty()) {
+                    // Only the bound palette texture changes, the mesh and the volume stay as they are
+                    if (ImGui::BeginCombo("Palette", entity.VariantName(entity.Variant()).c_str())) {
+                        for (int i = 0; i <= (int)entity.Variants().size(); i++) {
+                            if (ImGui::Selectable(entity.VariantName(i).c_str(), i == entity.Variant())) {
+                                entity.SetVariant(i);
+                                redraw.Request();
+                            }
+                        }
+                        ImGui::EndCombo();
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Next")) {
+                        entity.NextVariant();
+                        redraw.Request();
+                    }
+                }
+                if (entity.FrameCount() > 1) {
+                    ImGui::Text("Animation: %d frames", entity.FrameCount());
+                    if (ImGui::Button(entity.playing ? "Pause" : "Play")) {
+                        entity.playing = !entity.playing;
+                        redraw.Request();
+                    }
+                    ImGui::SameLine();
+                    int frame = entity.Frame();
+                    if (ImGui::SliderInt("Frame", &frame, 0, entity.FrameCount() - 1)) {
+                        entity.SetFrame(frame);
+                        redraw.Request();
+                    }
+                    ImGui::SliderFloat("Frame rate", &entity.frame_rate, 1.0f, 60.0f, "%.0f fps");
+                }
+                if (entity.GetRenderMode() == Entity::RenderMode::MESH) {
+                    if (ImGui::Checkbox("Optimize mesh", &entity.optimize_mesh)) entity.Triangulate();
+                    ImGui::Text("ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", entity.cache_before.acmr, entity.cache_after.acmr, entity.cache_before.atvr,
+                        entity.cache_after.atvr);
+                    ImGui::Text("Vertices %zu -> %zu, triangles %zu", entity.cache_before.vertices, entity.cache_after.vertices, entity.cache_after.triangles);
+                    ImGui::Checkbox("Crowd preview", &show_crowd);
+                }
             }
 
-            float pos_offset[3] = {entity.position_offset.x, entity.position_offset.y, entity.position_offset.z};
-            int biggest_model_size = fmax(entity.model_size.x, fmax(entity.model_size.y, entity.model_size.z));
-            ImGui::SliderFloat3("Position offset", pos_offset, -biggest_model_size, biggest_model_size, "%.2f", 1.0f);
-            entity.position_offset = glm::vec3(pos_offset[0], pos_offset[1], pos_offset[2]);
+            if (ImGui::Button("Open file")) openFileDialog.Open();
+            ImGui::SameLine();
+            if (ImGui::Button("Search assets")) show_asset_search = true;
+            ImGui::SameLine();
+            ImGui::Checkbox("Profiler", &profiler.enabled);
+            ImGui::SameLine();
+            ImGui::Checkbox("Memory", &show_memory);
+            ImGui::SameLine();
+            ImGui::Checkbox("Idle when static", &redraw.on_demand);
+            ImGui::End();
 
-            int rot[3] = {static_cast<int>(entity.rotation.x), static_cast<int>(entity.rotation.y), static_cast<int>(entity.rotation.z)};
-            ImGui::SliderInt3("Rotation", rot, 0, 3);
-            entity.rotation = glm::vec3(rot[0], rot[1], rot[2]);
-            ImGui::Separator();
+            if (entity_initialized && show_crowd && entity.GetRenderMode() == Entity::RenderMode::MESH) {
+                ImGui::Begin("Crowd", &show_crowd);
+                crowd.RenderMenu(entity.IndexCount());
+                // VSync caps the readout at the display refresh rate, turn it off to see the real cost
+                if (ImGui::Checkbox("VSync", &vsync)) glfwSwapInterval(vsync ? 1 : 0);
+                ImGui::End();
+            }
+
+            if (profiler.enabled) {
+                ImGui::Begin("Profiler", &profiler.enabled);
+                profiler.RenderMenu();
+                if (ImGui::Checkbox("VSync", &vsync)) glfwSwapInterval(vsync ? 1 : 0);
+                ImGui::End();
+            }
+
+            if (show_memory) {
+                ImGui::Begin("Memory", &show_memory);
+                renderMemoryPanel(entity_initialized ? &entity : nullptr, show_crowd ? crowd.InstanceCount() : 0, mesh_buffers.GetStats());
+                ImGui::End();
+            }
+
+            ImGui::SetNextWindowPos(ImVec2(1, 1));
+            ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 0.0f;
+            ImGui::GetStyle().Colors[ImGuiCol_Border].w = 0.0f;
+            ImGui::Begin("Info", nullptr,
+                ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings |
+                    ImGuiWindowFlags_NoInputs);
+            ImGui::Text(PROJECT_NAME ": " PROJECT_VERSION);
+            ImGui::Text("Draw calls: %d, state changes: %d (%d uniform uploads skipped)", queue.stats.draw_calls, queue.stats.StateChanges(),
+                queue.stats.uniform_skips);
+            ImGui::End();
+            ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 1.0f;
+            ImGui::GetStyle().Colors[ImGuiCol_Border].w = 1.0f;
+            ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 1.0f;
+            ImGui::GetStyle().Colors[ImGuiCol_TitleBg].w = 1.0f;
+            ImGui::GetStyle().Colors[ImGuiCol_TitleBgActive].w = 1.0f;
+
+            if (show_asset_search) {
+                ImGui::Begin("Asset search", &show_asset_search);
+                if (ImGui::IsWindowAppearing()) ImGui::SetKeyboardFocusHere();
+                bool submitted = ImGui::InputText("##query", asset_query, sizeof(asset_query), ImGuiInputTextFlags_EnterReturnsTrue);
+                Engine::AssetIndex::SearchResult result = asset_index.Search(asset_query, 500);
+                ImGui::Text("%zu of %zu models, %.3f ms%s", result.total, result.snapshot->records.size(), result.milliseconds,
+                    asset_index.Crawling() ? ", indexing..." : "");
+                if (asset_index.Roots().empty()) ImGui::TextDisabled("No asset roots, add one with `index add <dir>` in the log console");
 
-            if (ImGui::Button("Save entity properties")) {
-                entity.Save();
+                // Enter opens the best match, a double click any of them. Models with a saved entity open as that entity.
+                auto entityPath = [&](const Engine::AssetRecord& record) {
+                    std::filesystem::path path(result.snapshot->Path(record));
+                    if (record.flags & Engine::AssetRecord::HAS_YAML) path.replace_extension(".yml");
+                    return path.string();
+                };
+                std::string open_path;
+                if (submitted && !result.matches.empty()) open_path = entityPath(result.snapshot->records[result.matches[0].record]);
+                ImGui::BeginChild("results");
+                ImGuiListClipper clipper;
+                clipper.Begin(result.matches.size());
+                while (clipper.Step()) {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                        const Engine::AssetRecord& record = result.snapshot->records[result.matches[row].record];
+                        std::string name(result.snapshot->Name(record));
+                        ImGui::PushID(row);
+                        if (ImGui::Selectable(name.c_str(), row == 0, ImGuiSelectableFlags_AllowDoubleClick) && ImGui::IsMouseDoubleClicked(0)) {
+                            open_path = entityPath(record);
+                        }
+                        ImGui::PopID();
+                        ImGui::SameLine();
+                        std::string path(result.snapshot->Path(record));
+                        if (record.flags & Engine::AssetRecord::UNREADABLE) {
+                            ImGui::TextDisabled("unreadable  %s", path.c_str());
+                        } else {
+                            ImGui::TextDisabled("%ux%ux%u  %s", record.size[0], record.size[1], record.size[2], path.c_str());
+                        }
+                    }
+                }
+                ImGui::EndChild();
+                ImGui::End();
+                if (!open_path.empty()) openModel(open_path);
             }
+
+            openFileDialog.Display();
+            if (openFileDialog.HasSelected()) {
+                openModel(openFileDialog.GetSelected().string());
+                openFileDialog.ClearSelected();
+            }
+        }
+
+        {
+            Engine::Profiler::Scope scope(profiler, profile_imgui_render);
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         }
 
-        if (ImGui::Button("Open file")) openFileDialog.Open();
-        ImGui::End();
-
-        ImGui::SetNextWindowPos(ImVec2(1, 1));
-        ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 0.0f;
-        ImGui::GetStyle().Colors[ImGuiCol_Border].w = 0.0f;
-        ImGui::Begin("Info", nullptr,
-            ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings |
-                ImGuiWindowFlags_NoInputs);
-        ImGui::Text(PROJECT_NAME ": " PROJECT_VERSION);
-        ImGui::End();
-        ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 1.0f;
-        ImGui::GetStyle().Colors[ImGuiCol_Border].w = 1.0f;
-        ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 1.0f;
-        ImGui::GetStyle().Colors[ImGuiCol_TitleBg].w = 1.0f;
-        ImGui::GetStyle().Colors[ImGuiCol_TitleBgActive].w = 1.0f;
-
-        openFileDialog.Display();
-        if (openFileDialog.HasSelected()) {
-            logger.Info(std::format("Loading file: {}", openFileDialog.GetSelected().string()));
-            entity.LoadModelForSetup(openFileDialog.GetSelected().string());
-            entity_initialized = true;
-            std::string entity_name_str = getFileNameWithoutExtension(openFileDialog.GetSelected().string());
-            std::copy(entity_name_str.begin(), entity_name_str.end(), entity_name);
-            openFileDialog.ClearSelected();
+        {
+            Engine::Profiler::Scope scope(profiler, profile_swap);
+            // Swap buffers, events are polled or waited for at the top of the loop
+            glfwSwapBuffers(window);
         }
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        profiler.EndFrame();
+
+        // Every change pushes the write back by the debounce, so a slider drag ends in a single write. Only entities with a .yml
+        // of their own are saved, a bare model's sibling .yml may be another entity.
+        if (entity_initialized && autosave_enabled && entity.HasDataFile() && entity.Unscheduled()) scheduleSave(false);
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (entity.name != entity_name_before || entity.position_offset != entity_offset_before || entity.rotation != entity_rotation_before ||
+            logger.Generation() != log_generation) {
+            redraw.Request();
+        }
+        redraw.FrameDrawn();
     }
 
-    lightVAO.Delete();
-    lightVBO.Delete();
-    lightEBO.Delete();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
-    glfwTerminate();
+    logger.SetWakeCallback(nullptr);
+    vox_metadata.SetWakeCallback(nullptr);
+    asset_index.SetWakeCallback(nullptr);
+    autosave.SetWakeCallback(nullptr);
+    jobs.SetWakeCallback(nullptr);
     return 0;
 }
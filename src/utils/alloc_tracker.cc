@@ -0,0 +1,149 @@
+#include "alloc_tracker.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <format>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace Utils {
+    namespace {
+        const char* PHASE_NAMES[] = {"other", "parse", "grid", "mesh", "upload", "ui"};
+        static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == (size_t)AllocPhase::COUNT);
+
+        thread_local AllocPhase current_phase = AllocPhase::OTHER;
+
+#ifdef VOX_ALLOC_TRACKING
+        struct Counters {
+            std::atomic<uint64_t> allocations = 0;
+            std::atomic<uint64_t> frees = 0;
+            std::atomic<uint64_t> bytes = 0;
+            std::atomic<int64_t> live = 0;
+            std::atomic<int64_t> peak = 0;
+        };
+
+        // Plain static storage, operator new can run before any constructor does
+        Counters counters[(size_t)AllocPhase::COUNT];
+
+        // Sits right in front of every block handed out
+        struct alignas(16) Header {
+            uint64_t size;
+            uint32_t offset;  // From the start of the malloc'ed block to the user pointer
+            AllocPhase phase;
+        };
+
+        void* allocate(size_t size, size_t alignment) {
+            size_t offset = alignment > sizeof(Header) ? alignment : sizeof(Header);
+#ifdef _WIN32
+            void* raw = _aligned_malloc(offset + size, offset);
+#else
+            void* raw = alignment > alignof(std::max_align_t) ? std::aligned_alloc(alignment, (offset + size + alignment - 1) / alignment * alignment)
+                                                              : std::malloc(offset + size);
+#endif
+            if (!raw) return nullptr;
+            char* user = static_cast<char*>(raw) + offset;
+            Header* header = reinterpret_cast<Header*>(user) - 1;
+            header->size = size;
+            header->offset = offset;
+            header->phase = current_phase;
+
+            Counters& phase = counters[(size_t)header->phase];
+            phase.allocations.fetch_add(1, std::memory_order_relaxed);
+            phase.bytes.fetch_add(size, std::memory_order_relaxed);
+            int64_t live = phase.live.fetch_add(size, std::memory_order_relaxed) + size;
+            int64_t peak = phase.peak.load(std::memory_order_relaxed);
+            while (live > peak && !phase.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+            }
+            return user;
+        }
+
+        void release(void* pointer) {
+            if (!pointer) return;
+            Header* header = static_cast<Header*>(pointer) - 1;
+            Counters& phase = counters[(size_t)header->phase];
+            phase.frees.fetch_add(1, std::memory_order_relaxed);
+            phase.live.fetch_sub(header->size, std::memory_order_relaxed);
+#ifdef _WIN32
+            _aligned_free(static_cast<char*>(pointer) - header->offset);
+#else
+            std::free(static_cast<char*>(pointer) - header->offset);
+#endif
+        }
+
+        void* allocateOrThrow(size_t size, size_t alignment) {
+            void* pointer = allocate(size, alignment);
+            if (!pointer) throw std::bad_alloc();
+            return pointer;
+        }
+#endif
+    }  // namespace
+
+    const char* AllocPhaseName(AllocPhase phase) { return PHASE_NAMES[(size_t)phase]; }
+
+    AllocReport AllocSnapshot() {
+        AllocReport report{};
+#ifdef VOX_ALLOC_TRACKING
+        for (size_t i = 0; i < report.size(); i++) {
+            report[i].allocations = counters[i].allocations.load(std::memory_order_relaxed);
+            report[i].frees = counters[i].frees.load(std::memory_order_relaxed);
+            report[i].bytes = counters[i].bytes.load(std::memory_order_relaxed);
+            report[i].live = counters[i].live.load(std::memory_order_relaxed);
+            report[i].peak = counters[i].peak.load(std::memory_order_relaxed);
+        }
+#endif
+        return report;
+    }
+
+    void AllocReset() {
+#ifdef VOX_ALLOC_TRACKING
+        for (Counters& phase : counters) {
+            phase.allocations.store(0, std::memory_order_relaxed);
+            phase.frees.store(0, std::memory_order_relaxed);
+            phase.bytes.store(0, std::memory_order_relaxed);
+            phase.peak.store(phase.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+#endif
+    }
+
+    void WriteAllocJson(const AllocReport& report, std::ostream& out) {
+        out << "{\"enabled\":" << (ALLOC_TRACKING ? "true" : "false") << ",\"phases\":{";
+        for (size_t i = 0; i < report.size(); i++) {
+            const AllocStats& stats = report[i];
+            out << std::format("{}\"{}\":{{\"allocations\":{},\"frees\":{},\"bytes\":{},\"live\":{},\"peak\":{}}}", i > 0 ? "," : "", PHASE_NAMES[i],
+                stats.allocations, stats.frees, stats.bytes, stats.live, stats.peak);
+        }
+        out << "}}";
+    }
+
+    AllocPhase CurrentAllocPhase() { return current_phase; }
+
+    AllocPhaseScope::AllocPhaseScope(AllocPhase phase) {
+        this->previous = current_phase;
+        current_phase = phase;
+    }
+
+    AllocPhaseScope::~AllocPhaseScope() { current_phase = this->previous; }
+}  // namespace Utils
+
+#ifdef VOX_ALLOC_TRACKING
+// Replacing these is enough for every new and delete expression and the standard containers
+void* operator new(size_t size) { return Utils::allocateOrThrow(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return Utils::allocateOrThrow(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment) { return Utils::allocateOrThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return Utils::allocateOrThrow(size, (size_t)alignment); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Utils::allocate(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Utils::allocate(size, alignof(std::max_align_t)); }
+void operator delete(void* pointer) noexcept { Utils::release(pointer); }
+void operator delete[](void* pointer) noexcept { Utils::release(pointer); }
+void operator delete(void* pointer, size_t) noexcept { Utils::release(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { Utils::release(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { Utils::release(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { Utils::release(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { Utils::release(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { Utils::release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { Utils::release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { Utils::release(pointer); }
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+#include "cmake_defines.hh"
+
+// Attributes heap allocations made by the calling thread until the end of the enclosing scope to `phase`, a
+// Utils::AllocPhase enumerator. Compiles to nothing unless the build has VOX_ALLOC_TRACKING.
+#ifdef VOX_ALLOC_TRACKING
+#define ALLOC_PHASE_CONCAT_INNER(a, b) a##b
+#define ALLOC_PHASE_CONCAT(a, b) ALLOC_PHASE_CONCAT_INNER(a, b)
+#define ALLOC_PHASE(phase) Utils::AllocPhaseScope ALLOC_PHASE_CONCAT(alloc_phase_, __LINE__)(Utils::AllocPhase::phase)
+#else
+#define ALLOC_PHASE(phase)
+#endif
+
+namespace Utils {
+    // Opt-in allocation accounting: with VOX_ALLOC_TRACKING the global operator
+    // new and delete are replaced, and every allocation is counted against the
+    // phase its thread was in when it was made, including when it is freed.
+    // Counters are relaxed atomics, a few nanoseconds per allocation.
+#ifdef VOX_ALLOC_TRACKING
+    constexpr bool ALLOC_TRACKING = true;
+#else
+    constexpr bool ALLOC_TRACKING = false;
+#endif
+
+    enum class AllocPhase : uint8_t { OTHER, PARSE, GRID, MESH, UPLOAD, UI, COUNT };
+    const char* AllocPhaseName(AllocPhase phase);
+    // Of the calling thread, e.g. to carry it over to work handed to another thread
+    AllocPhase CurrentAllocPhase();
+
+    struct AllocStats {
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+        uint64_t bytes = 0;  // Allocated in total
+        int64_t live = 0;    // Allocated and not freed yet
+        int64_t peak = 0;    // Highest `live` since the last reset
+    };
+
+    using AllocReport = std::array<AllocStats, (size_t)AllocPhase::COUNT>;
+
+    // All zeros without VOX_ALLOC_TRACKING
+    AllocReport AllocSnapshot();
+    // Zeroes the counts and sets every peak to what is live now
+    void AllocReset();
+    // {"enabled":..,"phases":{"parse":{..},..}}
+    void WriteAllocJson(const AllocReport& report, std::ostream& out);
+
+    class AllocPhaseScope {
+       private:
+        AllocPhase previous;
+
+       public:
+        AllocPhaseScope(AllocPhase phase);
+        ~AllocPhaseScope();
+    };
+}  // namespace Utils
@@ -0,0 +1,62 @@
+#include "atomic_file.hh"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Utils {
+    namespace {
+        // Pushes what the OS buffered for `file` to the device
+        bool syncFile(std::FILE* file) {
+#ifdef _WIN32
+            return _commit(_fileno(file)) == 0;
+#else
+            return fsync(fileno(file)) == 0;
+#endif
+        }
+    }  // namespace
+
+    std::string WriteFileAtomic(const std::string& path, std::string_view bytes) {
+        std::string temporary = path + ".tmp";
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file) return std::format("cannot create `{}`: {}", temporary, std::strerror(errno));
+
+        int error = 0;
+        if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size() || std::fflush(file) != 0) {
+            error = errno;
+        } else if (!syncFile(file)) {
+            error = errno;
+        }
+        if (std::fclose(file) != 0 && error == 0) error = errno;
+        if (error != 0) {
+            std::remove(temporary.c_str());
+            return std::format("cannot write `{}`: {}", temporary, std::strerror(error));
+        }
+
+        std::error_code rename_error;
+        std::filesystem::rename(temporary, path, rename_error);
+        if (rename_error) {
+            std::remove(temporary.c_str());
+            return std::format("cannot replace `{}`: {}", path, rename_error.message());
+        }
+
+#ifndef _WIN32
+        // The rename itself only survives a power loss once the directory entry is on disk too
+        std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        int directory_fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+        if (directory_fd >= 0) {
+            fsync(directory_fd);
+            close(directory_fd);
+        }
+#endif
+        return "";
+    }
+}  // namespace Utils
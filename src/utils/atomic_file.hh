@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Utils {
+    // Replaces the file at `path` with `bytes` so that readers, and a crash at
+    // any point, only ever see the old or the new contents: the bytes go to a
+    // temporary file next to it, which is flushed to disk and renamed over
+    // `path`. Returns an empty string on success, otherwise what went wrong.
+    std::string WriteFileAtomic(const std::string& path, std::string_view bytes);
+}  // namespace Utils
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <string>
+#include <vector>
+
+namespace Utils {
+    struct BenchResult {
+        int runs = 0;
+        double min_ms = 0.0;
+        double median_ms = 0.0;
+        double max_ms = 0.0;
+
+        std::string ToString() { return std::format("{} runs, min {:.3f} ms, median {:.3f} ms, max {:.3f} ms", runs, min_ms, median_ms, max_ms); };
+        std::string ToJson() { return std::format("{{\"runs\":{},\"min_ms\":{:.4f},\"median_ms\":{:.4f},\"max_ms\":{:.4f}}}", runs, min_ms, median_ms, max_ms); };
+    };
+
+    // Times `runs` calls of `body` with the steady clock
+    template <typename F>
+    BenchResult Bench(int runs, F&& body) {
+        std::vector<double> samples;
+        samples.reserve(runs);
+        for (int i = 0; i < runs; i++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            samples.push_back(elapsed.count());
+        }
+
+        BenchResult result;
+        if (samples.empty()) return result;
+        std::sort(samples.begin(), samples.end());
+        result.runs = runs;
+        result.min_ms = samples.front();
+        result.max_ms = samples.back();
+        size_t middle = samples.size() / 2;
+        result.median_ms = samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2.0;
+        return result;
+    };
+}  // namespace Utils
@@ -0,0 +1,57 @@
+#include "load_arena.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace Utils {
+    LoadArena::LoadArena(size_t initial_size) { this->addChunk(initial_size); }
+
+    LoadArena::~LoadArena() { this->releaseChunks(); }
+
+    void LoadArena::addChunk(size_t size) {
+        std::byte* data = static_cast<std::byte*>(::operator new(size, std::align_val_t(CHUNK_ALIGNMENT)));
+        this->chunks.push_back({data, size});
+        this->used = 0;
+    }
+
+    void LoadArena::releaseChunks() {
+        for (Chunk& chunk : this->chunks) ::operator delete(chunk.data, chunk.size, std::align_val_t(CHUNK_ALIGNMENT));
+        this->chunks.clear();
+    }
+
+    void* LoadArena::do_allocate(size_t bytes, size_t alignment) {
+        Chunk* chunk = &this->chunks.back();
+        uintptr_t begin = reinterpret_cast<uintptr_t>(chunk->data);
+        uintptr_t aligned = (begin + this->used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (aligned + bytes > begin + chunk->size) {
+            // Doubling keeps the number of chunks logarithmic in the size of the load
+            this->addChunk(std::max(chunk->size * 2, bytes + alignment));
+            chunk = &this->chunks.back();
+            begin = reinterpret_cast<uintptr_t>(chunk->data);
+            aligned = (begin + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        }
+        size_t end = aligned + bytes - begin;
+        this->allocated += end - this->used;
+        this->used = end;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void LoadArena::Reset() {
+        this->high_water = this->HighWater();
+        this->allocated = 0;
+        this->used = 0;
+        if (this->chunks.size() > 1) {
+            // A quarter on top of the high water mark covers alignment padding that lands differently in one chunk
+            size_t size = this->high_water + this->high_water / 4;
+            this->releaseChunks();
+            this->addChunk(size);
+        }
+    }
+
+    size_t LoadArena::Capacity() const {
+        size_t capacity = 0;
+        for (const Chunk& chunk : this->chunks) capacity += chunk.size;
+        return capacity;
+    }
+}  // namespace Utils
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace Utils {
+    // Monotonic memory for data that only lives while one model is loaded or
+    // meshed: allocation bumps a pointer, deallocation does nothing, and Reset
+    // hands everything back at once. Containers take it as std::pmr allocators.
+    // Reset merges the chunks into one sized from the most any load has used,
+    // so after the first few loads the arena stops asking the heap for anything
+    // and its footprint stays at the largest load seen.
+    class LoadArena : public std::pmr::memory_resource {
+       private:
+        struct Chunk {
+            std::byte* data;
+            size_t size;
+        };
+
+        std::vector<Chunk> chunks;  // The last one is being filled
+        size_t used = 0;            // Of the last chunk
+        size_t allocated = 0;       // Since the last reset, including alignment padding
+        size_t high_water = 0;
+
+        void addChunk(size_t size);
+        void releaseChunks();
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void*, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+       public:
+        static constexpr size_t CHUNK_ALIGNMENT = 64;
+
+        explicit LoadArena(size_t initial_size = 64 << 10);
+        ~LoadArena();
+        LoadArena(const LoadArena&) = delete;
+        LoadArena& operator=(const LoadArena&) = delete;
+
+        // Invalidates everything allocated so far
+        void Reset();
+
+        // Bytes reserved from the heap
+        size_t Capacity() const;
+        // Most bytes handed out between two resets
+        size_t HighWater() const { return this->high_water > this->allocated ? this->high_water : this->allocated; };
+    };
+}  // namespace Utils
@@ -3,15 +3,26 @@
 #include <imgui.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <ctime>
+#include <deque>
 #include <format>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "ring_buffer.hh"
+#include "trace.hh"
+
 #define ASCII_COLOR_RESET "\033[0m"
 #define ASCII_COLOR_BOLD "\033[1m"
 #define ASCII_COLOR_GRAY "\033[90m"
@@ -23,32 +34,137 @@
 namespace Utils {
     enum class LogLevel { INFO, WARNING, ERROR, FATAL, BLANK };
 
+    // std::localtime shares one static tm between threads, the log sink and the UI both format times
+    inline std::tm LocalTime(std::time_t t) {
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        return tm;
+    }
+
+    // Intrusive multi-producer single-consumer queue (Dmitry Vyukov's design).
+    // Push is wait-free for any number of threads, Pop may only be called by
+    // one consumer and can briefly return nullptr while a push is half done.
+    template <typename T>
+    class MPSCQueue {
+       public:
+        struct Node {
+            std::atomic<Node*> next{nullptr};
+            T value;
+        };
+
+       private:
+        std::atomic<Node*> head;  // Producers swap themselves in here
+        Node* tail;               // Only touched by the consumer
+        Node stub;
+
+       public:
+        MPSCQueue() {
+            this->head.store(&this->stub);
+            this->tail = &this->stub;
+        };
+
+        void Push(Node* node) {
+            node->next.store(nullptr, std::memory_order_relaxed);
+            Node* previous = this->head.exchange(node, std::memory_order_acq_rel);
+            previous->next.store(node, std::memory_order_release);
+        };
+
+        // Returns the oldest node, or nullptr. The caller owns the node.
+        Node* Pop() {
+            Node* tail = this->tail;
+            Node* next = tail->next.load(std::memory_order_acquire);
+            if (tail == &this->stub) {
+                if (!next) return nullptr;
+                this->tail = next;
+                tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next) {
+                this->tail = next;
+                return tail;
+            }
+            if (tail != this->head.load(std::memory_order_acquire)) return nullptr;
+            // `tail` is the last node, put the stub behind it so it can be handed out
+            Push(&this->stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next) {
+                this->tail = next;
+                return tail;
+            }
+            return nullptr;
+        };
+    };
+
+    // Log calls from any thread only build a record and push it onto a lock-free
+    // queue. A sink thread formats the timestamp (cached per second), writes the
+    // console output in one buffered write per batch and appends the record to
+    // the list shown in the log window.
     class Logger {
        private:
-        std::vector<std::pair<std::string, Utils::LogLevel>> messages;
+        struct Record {
+            std::string message;
+            LogLevel level;
+            std::time_t time;
+            bool stop = false;  // Pushed by the destructor to end the sink thread
+        };
+        using Node = MPSCQueue<Record>::Node;
+
+        // One log window row, multi-line messages take one row per line so the clipper can assume equal heights
+        struct Message {
+            std::string text;
+            LogLevel level;
+            uint32_t repeat = 1;     // Identical consecutive messages are collapsed into one row
+            bool continuation;       // Second and later lines of a message
+            bool continued = false;  // First line of a message that has more lines
+        };
+
+        RingBuffer<Message> messages{HISTORY};
+        size_t level_counts[5] = {0, 0, 0, 0, 0};
+        std::mutex messages_mutex;  // Between the sink thread appending and the UI reading
+
+        // Sequence numbers of the rows that pass the filter, extended with new rows every frame
+        std::deque<uint64_t> filtered;
+        uint64_t filtered_end = 0;
+        bool filter_dirty = true;
+        bool show_level[5] = {true, true, true, true, true};
+        ImGuiTextFilter text_filter;
         int* logger_window_size;
         bool scrolled = false;
+        std::atomic<size_t> generation = 0;  // Number of messages that reached the log window
+
+        MPSCQueue<Record> queue;
+        std::atomic<uint32_t> pending = 0;  // Pushed but not yet popped, the sink sleeps on this
+        std::atomic<uint64_t> pushed = 0;
+        std::atomic<uint64_t> written = 0;
+        std::atomic<LogLevel> min_level = LogLevel::INFO;
+        std::thread sink;
 
-        std::string getTimestapm() {
-            auto t = std::time(nullptr);
-            auto tm = *std::localtime(&t);
+        std::atomic<void (*)()> on_message = nullptr;
 
-            std::ostringstream oss;
-            oss << std::put_time(&tm, "%d-%m-%Y %H:%M:%S");
-            return oss.str();
+        struct Command {
+            std::string usage;
+            std::string help;
+            std::function<void(const std::vector<std::string>& args)> handler;
         };
+        std::map<std::string, Command> commands;  // Sorted for `help`
 
-        std::vector<std::string> splitStringByNewline(const std::string str) {
-            std::vector<std::string> result;
-            std::istringstream stream(str);
-            std::string line;
+        std::time_t cached_time = -1;
+        std::string cached_timestamp;
 
-            while (std::getline(stream, line)) {
-                result.push_back(line);
+        const std::string& getTimestapm(std::time_t t) {
+            if (t != this->cached_time) {
+                std::tm tm = LocalTime(t);
+                std::ostringstream oss;
+                oss << std::put_time(&tm, "%d-%m-%Y %H:%M:%S");
+                this->cached_time = t;
+                this->cached_timestamp = oss.str();
             }
-
-            return result;
-        }
+            return this->cached_timestamp;
+        };
 
         void blank(const std::string& message) { Log(message, LogLevel::BLANK); };
 
@@ -67,27 +183,64 @@ namespace Utils {
             }
         }
 
-        void setLogLevelColor(LogLevel level) {
-            ImGuiStyle* style = &ImGui::GetStyle();
+        ImVec4 getLogLevelColor(LogLevel level) {
             switch (level) {
                 case LogLevel::INFO:
-                    style->Colors[ImGuiCol_Text] = ImVec4(0.75f, 0.75f, 0.75f, 1.0f);
-                    break;
+                    return ImVec4(0.75f, 0.75f, 0.75f, 1.0f);
                 case LogLevel::WARNING:
-                    style->Colors[ImGuiCol_Text] = ImVec4(1.0f, 0.85f, 0.0f, 1.0f);
-                    break;
+                    return ImVec4(1.0f, 0.85f, 0.0f, 1.0f);
                 case LogLevel::ERROR:
-                    style->Colors[ImGuiCol_Text] = ImVec4(1.0f, 0.0f, 0.0f, 1.0f);
-                    break;
+                    return ImVec4(1.0f, 0.0f, 0.0f, 1.0f);
                 case LogLevel::FATAL:
-                    style->Colors[ImGuiCol_Text] = ImVec4(0.8f, 0.2f, 0.2f, 1.0f);
-                    break;
+                    return ImVec4(0.8f, 0.2f, 0.2f, 1.0f);
                 case LogLevel::BLANK:
                     break;
             }
+            return ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
         }
 
-        void resetLogLevelColor() { ImGui::GetStyle().Colors[ImGuiCol_Text] = ImVec4(1.0f, 1.0f, 1.0f, 1.0f); }
+        // Called with `messages_mutex` held
+        void appendMessage(std::string&& text, LogLevel level) {
+            this->level_counts[static_cast<int>(level)]++;
+            if (text.find('\n') == std::string::npos) {
+                if (!this->messages.Empty()) {
+                    Message& last = this->messages.Back();
+                    if (last.level == level && !last.continuation && !last.continued && last.text == text) {
+                        last.repeat++;
+                        return;
+                    }
+                }
+                this->messages.Push(Message{std::move(text), level, 1, false, false});
+                return;
+            }
+
+            size_t start = 0;
+            while (start < text.size()) {
+                size_t end = text.find('\n', start);
+                if (end == std::string::npos) end = text.size();
+                this->messages.Push(Message{text.substr(start, end - start), level, 1, start != 0, end + 1 < text.size()});
+                start = end + 1;
+            }
+        };
+
+        bool passesFilter(const Message& message) {
+            return this->show_level[static_cast<int>(message.level)] && this->text_filter.PassFilter(message.text.c_str());
+        };
+
+        // Only rows pushed since the last frame are tested, unless the filter itself changed. Called with `messages_mutex` held
+        void updateFilter() {
+            uint64_t first = this->messages.FirstSequence();
+            if (this->filter_dirty) {
+                this->filtered.clear();
+                this->filtered_end = first;
+                this->filter_dirty = false;
+            }
+            while (!this->filtered.empty() && this->filtered.front() < first) this->filtered.pop_front();
+            for (uint64_t sequence = std::max(this->filtered_end, first); sequence < this->messages.EndSequence(); sequence++) {
+                if (passesFilter(this->messages.AtSequence(sequence))) this->filtered.push_back(sequence);
+            }
+            this->filtered_end = this->messages.EndSequence();
+        };
 
         bool startsWith(const std::string& str, const std::string prefix) { return str.rfind(prefix, 0) == 0; }
 
@@ -98,13 +251,7 @@ namespace Utils {
             return iss >> f && !(iss >> c);
         }
 
-       public:
-        Logger(){};
-
-        void SetLoggerWindowSize(int& logger_window_size) { this->logger_window_size = &logger_window_size; };
-
-        void Log(const std::string& message, Utils::LogLevel level) {
-            messages.push_back(std::make_pair(message, level));
+        void writeRecord(std::string& out, const Record& record) {
             // Replace all ~ in message with ASCII_COLOR_BOLD_GREEN and ASCII_COLOR_RESET alternately
             // std::string color_message = "";
             // std::string color = ASCII_COLOR_BOLD_GREEN;
@@ -116,23 +263,178 @@ namespace Utils {
             //         color_message += message[i];
             //     }
             // }
-            std::string color = ASCII_COLOR_GRAY;
-            if (level == LogLevel::WARNING) color = ASCII_COLOR_BOLD_YELLOW;
-            if (level == LogLevel::ERROR) color = ASCII_COLOR_BOLD_RED;
-            if (level == LogLevel::FATAL) color = ASCII_COLOR_DARK_RED;
-            std::string timestamp = this->getTimestapm();
-            std::string contex = std::format("{}{}{} {}{}{}", color, "[", timestamp, getLogLevel(level), "]: ", ASCII_COLOR_RESET);
-            int contex_len = 4 + timestamp.length();
-            std::vector<std::string> lines = splitStringByNewline(message);
-            std::cout << contex << ASCII_COLOR_RESET;
-            int i = 0;
-            for (auto& line : lines) {
-                if (i != 0) {
-                    std::cout << std::string(contex_len, ' ');
+            const char* color = ASCII_COLOR_GRAY;
+            if (record.level == LogLevel::WARNING) color = ASCII_COLOR_BOLD_YELLOW;
+            if (record.level == LogLevel::ERROR) color = ASCII_COLOR_BOLD_RED;
+            if (record.level == LogLevel::FATAL) color = ASCII_COLOR_DARK_RED;
+            const std::string& timestamp = this->getTimestapm(record.time);
+            std::format_to(std::back_inserter(out), "{}[{} {}]: {}{}", color, timestamp, getLogLevel(record.level), ASCII_COLOR_RESET, ASCII_COLOR_RESET);
+            size_t contex_len = 4 + timestamp.length();
+
+            // Continuation lines are indented under the message
+            size_t start = 0;
+            while (true) {
+                size_t end = record.message.find('\n', start);
+                if (start != 0) out.append(contex_len, ' ');
+                out.append(record.message, start, end == std::string::npos ? std::string::npos : end - start);
+                out += '\n';
+                if (end == std::string::npos || end + 1 == record.message.size()) break;
+                start = end + 1;
+            }
+        };
+
+        void registerBuiltinCommands() {
+            RegisterCommand("help", "", "Display this help message", [this](const std::vector<std::string>&) {
+                this->blank("Available commands:");
+                for (auto& [name, command] : this->commands) {
+                    std::string usage = command.usage.empty() ? name : name + " " + command.usage;
+                    this->blank(std::format("  - {}: {}", usage, command.help));
+                }
+            });
+            RegisterCommand("clear", "", "Clear the log", [this](const std::vector<std::string>&) {
+                std::lock_guard<std::mutex> lock(this->messages_mutex);
+                this->messages.Clear();
+                std::fill(std::begin(this->level_counts), std::end(this->level_counts), 0);
+            });
+            RegisterCommand("trace start", "", "Record trace spans", [this](const std::vector<std::string>&) {
+                TraceStart();
+                this->Info("Recording trace spans");
+            });
+            RegisterCommand("trace stop", "", "Stop recording and write the spans to trace_<time>.json", [this](const std::vector<std::string>&) {
+                TraceStop();
+                auto now = std::chrono::system_clock::now().time_since_epoch();
+                std::string path = std::format("trace_{}.json", std::chrono::duration_cast<std::chrono::seconds>(now).count());
+                int64_t count = TraceDump(path);
+                if (count < 0) {
+                    this->Error("Failed to write trace to `{}`", path);
+                } else {
+                    this->Info("Dumped {} trace spans to `{}`", count, path);
                 }
-                std::cout << line << std::endl;
-                i++;
+            });
+        };
+
+        void push(Node* node) {
+            this->queue.Push(node);
+            if (this->pending.fetch_add(1, std::memory_order_acq_rel) == 0) this->pending.notify_one();
+        };
+
+        void sinkLoop() {
+            TraceThreadName("Log sink");
+            std::string out;
+            std::vector<Node*> batch;
+            bool stop = false;
+            while (!stop) {
+                uint32_t available = this->pending.load(std::memory_order_acquire);
+                if (available == 0) {
+                    this->pending.wait(0);
+                    continue;
+                }
+
+                // A producer may have bumped `pending` before linking its node, Pop catches up shortly
+                batch.clear();
+                while (batch.size() < available) {
+                    Node* node = this->queue.Pop();
+                    if (node) {
+                        batch.push_back(node);
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+                this->pending.fetch_sub(available, std::memory_order_acq_rel);
+
+                out.clear();
+                for (Node* node : batch) {
+                    if (node->value.stop) {
+                        stop = true;
+                    } else {
+                        writeRecord(out, node->value);
+                    }
+                }
+                std::cout.write(out.data(), out.size());
+                std::cout.flush();
+
+                {
+                    std::lock_guard<std::mutex> lock(this->messages_mutex);
+                    for (Node* node : batch) {
+                        if (!node->value.stop) appendMessage(std::move(node->value.message), node->value.level);
+                        delete node;
+                    }
+                }
+                size_t count = batch.size() - (stop ? 1 : 0);
+                this->generation.fetch_add(count);
+                this->written.fetch_add(count, std::memory_order_release);
+                this->written.notify_all();
+                void (*wake)() = this->on_message.load();
+                if (wake && count > 0) wake();
+            }
+        };
+
+       public:
+        static constexpr size_t HISTORY = 4096;  // Rows kept for the log window
+
+        Logger() {
+            this->sink = std::thread(&Logger::sinkLoop, this);
+            registerBuiltinCommands();
+        };
+
+        ~Logger() {
+            Node* node = new Node();
+            node->value.stop = true;
+            push(node);
+            this->sink.join();
+        };
+
+        void SetLoggerWindowSize(int& logger_window_size) { this->logger_window_size = &logger_window_size; };
+
+        size_t Generation() { return this->generation.load(); };
+
+        // Called on the sink thread after new messages reached the log window, e.g. to wake an idle main loop
+        void SetWakeCallback(void (*callback)()) { this->on_message.store(callback); };
+
+        void SetLevel(LogLevel level) { this->min_level.store(level); };
+        bool Enabled(LogLevel level) { return level >= this->min_level.load(std::memory_order_relaxed); };
+
+        // Commands may have several words ("stats mem"), the handler receives the arguments after them.
+        // Handlers run on the thread that renders the log window.
+        void RegisterCommand(const std::string& name, const std::string& usage, const std::string& help,
+            std::function<void(const std::vector<std::string>& args)> handler) {
+            this->commands[name] = Command{usage, help, std::move(handler)};
+        };
+
+        // Runs the registered command with the longest name matching the leading words of `line`
+        bool Execute(const std::string& line) {
+            std::vector<std::string> words;
+            std::istringstream stream(line);
+            std::string word;
+            while (stream >> word) words.push_back(word);
+
+            for (size_t length = words.size(); length > 0; length--) {
+                std::string name = words[0];
+                for (size_t i = 1; i < length; i++) name += " " + words[i];
+                auto it = this->commands.find(name);
+                if (it == this->commands.end()) continue;
+                it->second.handler(std::vector<std::string>(words.begin() + length, words.end()));
+                return true;
             }
+            if (!words.empty()) this->Warn("Unknown command `{}`, 'help' lists the available ones", words[0]);
+            return false;
+        };
+
+        // Blocks until everything logged so far has been written out
+        void Flush() {
+            uint64_t target = this->pushed.load();
+            uint64_t current;
+            while ((current = this->written.load(std::memory_order_acquire)) < target) this->written.wait(current);
+        };
+
+        void Log(const std::string& message, Utils::LogLevel level) {
+            if (!Enabled(level)) return;
+            Node* node = new Node();
+            node->value.message = message;
+            node->value.level = level;
+            node->value.time = std::time(nullptr);
+            this->pushed.fetch_add(1, std::memory_order_relaxed);
+            push(node);
         };
 
         void Info(const std::string& message) { Log(message, LogLevel::INFO); };
@@ -140,9 +442,28 @@ namespace Utils {
         void Error(const std::string& message) { Log(message, LogLevel::ERROR); };
         void Fatal(const std::string& message) {
             Log(message, LogLevel::FATAL);
+            Flush();
             exit(1);
         };
 
+        // Formatting overloads, the message is only built when the level is enabled
+        template <typename... Args>
+        void Info(std::format_string<Args...> format, Args&&... args) {
+            if (Enabled(LogLevel::INFO)) Log(std::format(format, std::forward<Args>(args)...), LogLevel::INFO);
+        };
+        template <typename... Args>
+        void Warn(std::format_string<Args...> format, Args&&... args) {
+            if (Enabled(LogLevel::WARNING)) Log(std::format(format, std::forward<Args>(args)...), LogLevel::WARNING);
+        };
+        template <typename... Args>
+        void Error(std::format_string<Args...> format, Args&&... args) {
+            if (Enabled(LogLevel::ERROR)) Log(std::format(format, std::forward<Args>(args)...), LogLevel::ERROR);
+        };
+        template <typename... Args>
+        void Fatal(std::format_string<Args...> format, Args&&... args) {
+            Fatal(std::format(format, std::forward<Args>(args)...));
+        };
+
         void Render() {
             float display_height = ImGui::GetIO().DisplaySize.y;
             ImGui::SetNextWindowPos(ImVec2(0, (float)(display_height - *this->logger_window_size)));
@@ -152,57 +473,37 @@ namespace Utils {
             ImGui::GetStyle().Colors[ImGuiCol_TitleBgActive].w = 0.75f;
             ImGui::Begin("Log", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings);
 
-            for (auto& message : messages) {
-                this->setLogLevelColor(message.second);
-                if (message.second == LogLevel::BLANK) {
-                    ImGui::Text("%s%s", this->getLogLevel(message.second), message.first.c_str());
-                } else {
-                    ImGui::Text("%s: %s", this->getLogLevel(message.second), message.first.c_str());
-                }
-                this->resetLogLevelColor();
+            std::unique_lock<std::mutex> lock(this->messages_mutex);
+            for (int level = 0; level < 4; level++) {
+                std::string label = std::format("{} {}##level", getLogLevel(static_cast<LogLevel>(level)), this->level_counts[level]);
+                ImGui::PushStyleColor(ImGuiCol_Text, getLogLevelColor(static_cast<LogLevel>(level)));
+                if (ImGui::Checkbox(label.c_str(), &this->show_level[level])) this->filter_dirty = true;
+                ImGui::PopStyleColor();
+                ImGui::SameLine();
             }
+            if (this->text_filter.Draw("Filter", 200.0f)) this->filter_dirty = true;
+            updateFilter();
 
-            static char str0[128] = "";
-            if (ImGui::InputTextWithHint(" ", "Enter a command here; 'help' for help", str0, IM_ARRAYSIZE(str0), ImGuiInputTextFlags_EnterReturnsTrue)) {
-                std::string message = str0;
-                str0[0] = '\0';
-                if (message == "help") {
-                    this->blank("Available commands:");
-                    this->blank("  - help: Display this help message");
-                    this->blank("  - clear: Clear the log");
-                    // this->blank("  - tp <X> <Y> <Z>: Teleport player to the specified coordinates");
-                } else if (message == "clear") {
-                    messages.clear();
-                }
-                // else if (startsWith(message, "tp")) {
-                //     std::vector<std::string> args;
-                //     std::istringstream stream(message);
-                //     std::string arg;
-                //     while (stream >> arg) {
-                //         args.push_back(arg);
-                //     }
-                //     if (args.size() != 4) {
-                //         this->Warning("Invalid number of arguments");
-                //     } else {
-                //         bool success = true;
-                //         for (auto& arg : args) {
-                //             if (arg == "tp") {
-                //                 continue;
-                //             }
-                //             if (!isFloat(arg)) {
-                //                 this->Warning("Invalid argument: " + arg);
-                //                 success = false;
-                //             }
-                //         }
-                //         if (success) {
-                //             this->Info("Teleporting player to " + args[1] + ", " + args[2] + ", " + args[3]);
-                //         }
-                //     }
-                // }
-                else {
-                    this->Warn("Unknown command");
+            ImGui::BeginChild("messages", ImVec2(0.0f, -ImGui::GetFrameHeightWithSpacing()));
+            ImGuiListClipper clipper;
+            clipper.Begin(this->filtered.size());
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                    Message& message = this->messages.AtSequence(this->filtered[row]);
+                    ImGui::PushStyleColor(ImGuiCol_Text, getLogLevelColor(message.level));
+                    // Continuation lines start at the left edge, like the multi-line Text they replace
+                    bool bare = message.level == LogLevel::BLANK || message.continuation;
+                    const char* prefix = bare ? "" : getLogLevel(message.level);
+                    const char* separator = bare ? "" : ": ";
+                    if (message.repeat > 1) {
+                        ImGui::Text("%s%s%s  \xc3\x97%u", prefix, separator, message.text.c_str(), message.repeat);
+                    } else {
+                        ImGui::Text("%s%s%s", prefix, separator, message.text.c_str());
+                    }
+                    ImGui::PopStyleColor();
                 }
             }
+            clipper.End();
 
             if (ImGui::GetScrollY() < ImGui::GetScrollMaxY()) {
                 this->scrolled = true;
@@ -213,6 +514,18 @@ namespace Utils {
                 // Scroll to the bottom
                 ImGui::SetScrollHereY(1.0f);
             }
+            ImGui::EndChild();
+            lock.unlock();
+
+            static char str0[128] = "";
+            if (ImGui::InputTextWithHint(" ", "Enter a command here; 'help' for help", str0, IM_ARRAYSIZE(str0), ImGuiInputTextFlags_EnterReturnsTrue)) {
+                std::string message = str0;
+                str0[0] = '\0';
+                if (!message.empty()) {
+                    this->blank("> " + message);
+                    Execute(message);
+                }
+            }
 
             ImGui::End();
             ImGui::GetStyle().Colors[ImGuiCol_WindowBg].w = 1.0f;
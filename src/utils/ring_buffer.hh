@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Utils {
+    // Fixed-capacity FIFO that overwrites its oldest element when full.
+    // Elements are addressed either by position (0 is the oldest) or by their
+    // sequence number, which counts every push ever made and therefore stays
+    // valid until the element is evicted.
+    template <typename T>
+    class RingBuffer {
+       private:
+        std::vector<T> storage;
+        size_t head = 0;  // Position of the oldest element in `storage`
+        size_t size = 0;
+        uint64_t pushed = 0;
+
+       public:
+        RingBuffer(size_t capacity) { this->storage.resize(capacity); };
+
+        void Push(T value) {
+            size_t capacity = this->storage.size();
+            if (this->size < capacity) {
+                this->storage[(this->head + this->size) % capacity] = std::move(value);
+                this->size++;
+            } else {
+                this->storage[this->head] = std::move(value);
+                this->head = (this->head + 1) % capacity;
+            }
+            this->pushed++;
+        };
+
+        void Clear() {
+            this->head = 0;
+            this->size = 0;
+        };
+
+        T& operator[](size_t index) { return this->storage[(this->head + index) % this->storage.size()]; };
+        T& Back() { return (*this)[this->size - 1]; };
+
+        // Sequence numbers of the oldest element and one past the newest
+        uint64_t FirstSequence() { return this->pushed - this->size; };
+        uint64_t EndSequence() { return this->pushed; };
+        T& AtSequence(uint64_t sequence) { return (*this)[sequence - FirstSequence()]; };
+
+        size_t Size() { return this->size; };
+        size_t Capacity() { return this->storage.size(); };
+        bool Empty() { return this->size == 0; };
+    };
+}  // namespace Utils
@@ -0,0 +1,143 @@
+#include "trace.hh"
+
+#include <chrono>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Utils {
+    std::atomic<bool> trace_enabled = false;
+
+    namespace {
+        // Per-thread cap so a forgotten recording cannot eat all memory, later spans are dropped
+        constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+        struct TraceEvent {
+            const char* name;
+            uint64_t start;
+            uint64_t end;
+        };
+
+        struct ThreadBuffer {
+            uint32_t id;
+            std::string name;
+            std::mutex mutex;  // Only contended while a dump collects the events
+            std::vector<TraceEvent> events;
+        };
+
+        struct Registry {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;  // Kept after their thread exits so its spans still get dumped
+            std::deque<std::string> interned;                    // Deque elements never move
+            std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        };
+
+        Registry& registry() {
+            static Registry registry;
+            return registry;
+        }
+
+        ThreadBuffer& threadBuffer() {
+            thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+                Registry& r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                auto buffer = std::make_shared<ThreadBuffer>();
+                buffer->id = r.buffers.size() + 1;
+                buffer->name = std::format("Thread {}", buffer->id);
+                r.buffers.push_back(buffer);
+                return buffer;
+            }();
+            return *buffer;
+        }
+
+        void writeEscaped(std::ofstream& file, const std::string& text) {
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    file << '\\' << c;
+                } else if ((unsigned char)c < 0x20) {
+                    file << ' ';
+                } else {
+                    file << c;
+                }
+            }
+        }
+    }  // namespace
+
+    uint64_t TraceNow() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().epoch).count();
+    }
+
+    void TraceRecord(const char* name, uint64_t start, uint64_t end) {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.events.size() < MAX_EVENTS_PER_THREAD) buffer.events.push_back(TraceEvent{name, start, end});
+    }
+
+    const char* TraceIntern(const std::string& name) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& interned : r.interned) {
+            if (interned == name) return interned.c_str();
+        }
+        r.interned.push_back(name);
+        return r.interned.back().c_str();
+    }
+
+    void TraceThreadName(const std::string& name) {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        buffer.name = name;
+    }
+
+    void TraceStart() { trace_enabled.store(true); }
+
+    void TraceStop() { trace_enabled.store(false); }
+
+    int64_t TraceDump(const std::string& path) {
+        std::ofstream file(path);
+        if (!file) return -1;
+
+        Registry& r = registry();
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            buffers = r.buffers;
+        }
+
+        int64_t count = 0;
+        bool first = true;
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (auto& buffer : buffers) {
+            std::vector<TraceEvent> events;
+            std::string name;
+            {
+                std::lock_guard<std::mutex> lock(buffer->mutex);
+                events.swap(buffer->events);
+            }
+            {
+                std::lock_guard<std::mutex> lock(r.mutex);
+                name = buffer->name;
+            }
+
+            file << (first ? "\n{" : ",\n{");
+            first = false;
+            file << "\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":\"";
+            writeEscaped(file, name);
+            file << "\"}}";
+            for (auto& event : events) {
+                // Complete events, timestamps in microseconds
+                file << std::format(",\n{{\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"name\":\"", buffer->id, event.start / 1000.0,
+                    (event.end - event.start) / 1000.0);
+                writeEscaped(file, event.name);
+                file << "\"}";
+            }
+            count += events.size();
+        }
+        file << "\n]}\n";
+        file.close();
+        return file ? count : -1;
+    }
+}  // namespace Utils
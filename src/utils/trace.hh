@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// Records a span named `name` (a string literal or Utils::TraceIntern result) until the end of the enclosing scope
+#define TRACE_SCOPE(name) Utils::TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+namespace Utils {
+    // Span tracer that writes chrome://tracing / Perfetto JSON. Every thread
+    // records into its own buffer, so spans never contend with each other.
+    // While recording is off a span costs one relaxed load and one branch.
+    extern std::atomic<bool> trace_enabled;
+
+    uint64_t TraceNow();
+    void TraceRecord(const char* name, uint64_t start, uint64_t end);
+
+    // Returns a copy of `name` that lives as long as the program, for span names that are not literals
+    const char* TraceIntern(const std::string& name);
+    // Names the calling thread in the dump
+    void TraceThreadName(const std::string& name);
+
+    void TraceStart();
+    void TraceStop();
+    // Writes all recorded spans and clears them, returns the number of spans or -1 if the file could not be written
+    int64_t TraceDump(const std::string& path);
+
+    class TraceScope {
+       private:
+        const char* name;
+        uint64_t start;
+        bool active;
+
+       public:
+        TraceScope(const char* name) {
+            this->active = trace_enabled.load(std::memory_order_relaxed);
+            if (this->active) {
+                this->name = name;
+                this->start = TraceNow();
+            }
+        };
+
+        ~TraceScope() {
+            if (this->active) TraceRecord(this->name, this->start, TraceNow());
+        };
+    };
+}  // namespace Utils